@@ -1,4 +1,4 @@
-
+#pragma once
 
 /**
  * This tries to solve the issue that a normal map with std::string as key
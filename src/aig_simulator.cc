@@ -0,0 +1,97 @@
+#include "aig_simulator.h"
+
+namespace gate_sim {
+
+AigSimulator::AigSimulator(const Circuit &circuit)
+    : m_graph(AndInverterGraph::FromCircuit(circuit, m_net_literals))
+{
+    m_values = Vector<uint64_t>(m_graph.variable_amount(), 0);
+    m_next_latch_values = Vector<uint64_t>(m_graph.latch_amount());
+    this->simulate();
+}
+
+void AigSimulator::set_net_lanes(NetId net, uint64_t lanes)
+{
+    AigLiteral literal = m_net_literals[net];
+    /* Constants never change. */
+    if (aig_variable(literal) == 0) {
+        return;
+    }
+    m_values[aig_variable(literal)] = lanes ^
+                                      (0 - (uint64_t)aig_is_negated(literal));
+}
+
+uint64_t AigSimulator::get_net_lanes(NetId net) const
+{
+    return this->literal_value(m_net_literals[net]);
+}
+
+void AigSimulator::read_state(MutableArrayRef<uint64_t> r_words) const
+{
+    assert(r_words.size() == this->state_word_amount());
+    r_words.copy_from(m_values.begin());
+}
+
+void AigSimulator::write_state(ArrayRef<uint64_t> words)
+{
+    assert(words.size() == this->state_word_amount());
+    std::copy_n(words.begin(), words.size(), m_values.begin());
+}
+
+void AigSimulator::evaluate_ands()
+{
+    const AigLiteral *inputs = m_graph.and_inputs().begin();
+    const AigLiteral *inputs_end = m_graph.and_inputs().end();
+    uint64_t *values = m_values.begin();
+    uint64_t *output = values + m_graph.first_and_variable();
+    for (; inputs != inputs_end; inputs += 2) {
+        AigLiteral input1 = inputs[0];
+        AigLiteral input2 = inputs[1];
+        /* Turn the negation bit into a mask that inverts all lanes. */
+        uint64_t value1 = values[input1 >> 1] ^ (0 - (uint64_t)(input1 & 1));
+        uint64_t value2 = values[input2 >> 1] ^ (0 - (uint64_t)(input2 & 1));
+        *output++ = value1 & value2;
+    }
+}
+
+void AigSimulator::simulate()
+{
+    this->evaluate_ands();
+    m_has_oscillation = false;
+    ArrayRef<AigLiteral> feedback_inputs = m_graph.feedback_inputs();
+    if (feedback_inputs.size() == 0) {
+        return;
+    }
+    uint32_t first_variable = m_graph.first_feedback_variable();
+    for (uint32_t iteration = 0; iteration < MAX_LOOP_ITERATIONS;
+         iteration++) {
+        bool is_stable = true;
+        for (size_t i : feedback_inputs.index_range()) {
+            uint64_t value = this->literal_value(feedback_inputs[i]);
+            uint64_t &old_value = m_values[first_variable + i];
+            if (value != old_value) {
+                old_value = value;
+                is_stable = false;
+            }
+        }
+        if (is_stable) {
+            return;
+        }
+        this->evaluate_ands();
+    }
+    m_has_oscillation = true;
+}
+
+void AigSimulator::clock()
+{
+    /* Read all inputs first, because they can depend on other latches. */
+    ArrayRef<AigLiteral> latch_inputs = m_graph.latch_inputs();
+    for (size_t i : latch_inputs.index_range()) {
+        m_next_latch_values[i] = this->literal_value(latch_inputs[i]);
+    }
+    std::copy_n(m_next_latch_values.begin(),
+                m_next_latch_values.size(),
+                m_values.begin() + m_graph.first_latch_variable());
+}
+
+}  // namespace gate_sim
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "and_inverter_graph.h"
+#include "simulator.h"
+
+namespace gate_sim {
+
+/**
+ * Simulates a circuit after converting it into an and-inverter graph. All
+ * combinational logic is evaluated by the same operation on every node, so
+ * there is no dispatch on the gate type. Every node only reads the two
+ * literals of its inputs from one flat array and writes one word per
+ * variable, which keeps both the program and the values as dense as possible.
+ *
+ * Nets that are equal or the negation of each other share a variable, which
+ * often makes the graph smaller than the circuit. Combinational loops are
+ * evaluated repeatedly until their feedback variables settle, at most
+ * MAX_LOOP_ITERATIONS times.
+ */
+class AigSimulator : public Simulator {
+  private:
+    /* Literal of every net of the circuit. Declared before the graph,
+     * because both are created together. */
+    Vector<AigLiteral> m_net_literals;
+    AndInverterGraph m_graph;
+    /* One word per variable. The first one is the constant zero. */
+    Vector<uint64_t> m_values;
+    Vector<uint64_t> m_next_latch_values;
+    bool m_has_oscillation = false;
+
+  public:
+    AigSimulator(const Circuit &circuit);
+
+    void set_net_lanes(NetId net, uint64_t lanes) override;
+    uint64_t get_net_lanes(NetId net) const override;
+
+    void simulate() override;
+
+    void clock() override;
+
+    bool has_oscillation() const override
+    {
+        return m_has_oscillation;
+    }
+
+    /**
+     * The values of all variables.
+     */
+    size_t state_word_amount() const override
+    {
+        return m_values.size();
+    }
+
+    void read_state(MutableArrayRef<uint64_t> r_words) const override;
+    void write_state(ArrayRef<uint64_t> words) override;
+
+    /**
+     * The values of all variables. Nets with a negated literal share the
+     * word of their variable, so it contains their inverted values.
+     */
+    ArrayRef<uint64_t> value_words() const override
+    {
+        return m_values;
+    }
+
+    size_t net_value_word_index(NetId net) const override
+    {
+        return aig_variable(m_net_literals[net]);
+    }
+
+    uint32_t net_value_word_amount() const override
+    {
+        return 1;
+    }
+
+    bool net_value_is_inverted(NetId net) const override
+    {
+        return aig_is_negated(m_net_literals[net]);
+    }
+
+    const AndInverterGraph &graph() const
+    {
+        return m_graph;
+    }
+
+  private:
+    uint64_t literal_value(AigLiteral literal) const
+    {
+        return m_values[aig_variable(literal)] ^
+               (0 - (uint64_t)aig_is_negated(literal));
+    }
+
+    void evaluate_ands();
+};
+
+}  // namespace gate_sim
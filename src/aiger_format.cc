@@ -0,0 +1,255 @@
+#include <algorithm>
+
+#include "aiger_format.h"
+
+namespace gate_sim {
+
+static bool read_char(ArrayRef<uint8_t> data, size_t &r_position, char c)
+{
+    if (r_position < data.size() && data[r_position] == (uint8_t)c) {
+        r_position++;
+        return true;
+    }
+    return false;
+}
+
+static bool read_unsigned(ArrayRef<uint8_t> data,
+                          size_t &r_position,
+                          uint32_t &r_value)
+{
+    uint64_t value = 0;
+    size_t start = r_position;
+    while (r_position < data.size() && data[r_position] >= '0' &&
+           data[r_position] <= '9') {
+        value = value * 10 + (data[r_position] - '0');
+        if (value > UINT32_MAX) {
+            return false;
+        }
+        r_position++;
+    }
+    r_value = (uint32_t)value;
+    return r_position > start;
+}
+
+/**
+ * Read an unsigned integer that is stored in 7 bit groups, starting with the
+ * lowest. The highest bit of every byte tells whether more bytes follow.
+ */
+static bool read_varint(ArrayRef<uint8_t> data,
+                        size_t &r_position,
+                        uint32_t &r_value)
+{
+    uint32_t value = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+        if (r_position >= data.size()) {
+            return false;
+        }
+        uint8_t byte = data[r_position++];
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            r_value = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void write_varint(std::string &r_text, uint32_t value)
+{
+    while (value >= 0x80) {
+        r_text.push_back((char)(0x80 | (value & 0x7f)));
+        value >>= 7;
+    }
+    r_text.push_back((char)value);
+}
+
+std::optional<AndInverterGraph> parse_aiger(ArrayRef<uint8_t> data,
+                                            std::string &r_error)
+{
+    auto error = [&](const std::string &message) {
+        r_error = message;
+        return std::nullopt;
+    };
+
+    size_t position = 0;
+    if (!read_char(data, position, 'a') || !read_char(data, position, 'i') ||
+        !read_char(data, position, 'g') || !read_char(data, position, ' ')) {
+        if (data.size() >= 3 && data[1] == 'a' && data[2] == 'g') {
+            return error("only the binary AIGER format is supported");
+        }
+        return error("not an AIGER file");
+    }
+    /* The amounts of variables, inputs, latches, outputs and and nodes,
+     * optionally followed by the amounts of bad state, invariant constraint,
+     * justice and fairness properties. */
+    uint32_t amounts[9] = {0};
+    size_t amount_count = 0;
+    while (true) {
+        if (amount_count == 9 ||
+            !read_unsigned(data, position, amounts[amount_count])) {
+            return error("invalid header");
+        }
+        amount_count++;
+        if (read_char(data, position, '\n')) {
+            break;
+        }
+        if (!read_char(data, position, ' ')) {
+            return error("invalid header");
+        }
+    }
+    if (amount_count < 5) {
+        return error("invalid header");
+    }
+    uint32_t max_variable = amounts[0];
+    uint32_t input_amount = amounts[1];
+    uint32_t latch_amount = amounts[2];
+    uint32_t output_amount = amounts[3];
+    uint32_t and_amount = amounts[4];
+    uint32_t property_amount = amounts[5] + amounts[6];
+    if ((uint64_t)input_amount + latch_amount + and_amount != max_variable) {
+        return error("invalid header");
+    }
+    /* Literals have to fit into 32 bits. */
+    if (max_variable >= (uint32_t)1 << 31) {
+        return error("too many variables");
+    }
+    if (amounts[7] != 0 || amounts[8] != 0) {
+        return error("justice and fairness properties are not supported");
+    }
+
+    AndInverterGraph graph(input_amount, latch_amount);
+    uint32_t max_literal = aig_literal(max_variable, true);
+    for (uint32_t i = 0; i < latch_amount; i++) {
+        uint32_t input;
+        if (!read_unsigned(data, position, input) || input > max_literal) {
+            return error("invalid latch " + std::to_string(i));
+        }
+        graph.set_latch_input(i, input);
+        if (read_char(data, position, ' ')) {
+            uint32_t initial_value;
+            AigLiteral latch = aig_literal(graph.first_latch_variable() + i);
+            if (!read_unsigned(data, position, initial_value)) {
+                return error("invalid latch " + std::to_string(i));
+            }
+            /* The latch itself means that the initial value is unknown. */
+            if (initial_value != 0 && initial_value != latch) {
+                return error("latch " + std::to_string(i) +
+                             " does not start at zero");
+            }
+        }
+        if (!read_char(data, position, '\n')) {
+            return error("invalid latch " + std::to_string(i));
+        }
+    }
+    for (uint32_t i = 0; i < output_amount + property_amount; i++) {
+        uint32_t output;
+        if (!read_unsigned(data, position, output) || output > max_literal ||
+            !read_char(data, position, '\n')) {
+            return error("invalid output " + std::to_string(i));
+        }
+        graph.add_output(output);
+    }
+
+    /* Every node stores the distance from its own literal to the larger
+     * input and from there to the smaller input. */
+    for (uint32_t i = 0; i < and_amount; i++) {
+        AigLiteral output = aig_literal(graph.variable_amount());
+        uint32_t delta1;
+        uint32_t delta2;
+        if (!read_varint(data, position, delta1) ||
+            !read_varint(data, position, delta2) || delta1 == 0 ||
+            delta1 > output || delta2 > output - delta1) {
+            return error("invalid and node " + std::to_string(i));
+        }
+        AigLiteral input1 = output - delta1;
+        graph.add_and(input1, input1 - delta2);
+    }
+
+    /* Optional symbol table, which ends at the start of the comments. */
+    while (position < data.size()) {
+        char type = (char)data[position];
+        if (type == 'c' && (position + 1 == data.size() ||
+                            data[position + 1] == '\n')) {
+            break;
+        }
+        position++;
+        uint32_t index;
+        if (!read_unsigned(data, position, index) ||
+            !read_char(data, position, ' ')) {
+            return error("invalid symbol table");
+        }
+        size_t name_start = position;
+        while (position < data.size() && data[position] != '\n') {
+            position++;
+        }
+        std::string name((const char *)data.begin() + name_start,
+                         position - name_start);
+        position++;
+        if (type == 'i' && index < input_amount) {
+            graph.set_input_name(index, std::move(name));
+        }
+        else if (type == 'l' && index < latch_amount) {
+            graph.set_latch_name(index, std::move(name));
+        }
+        else if (type == 'o' && index < output_amount) {
+            graph.set_output_name(index, std::move(name));
+        }
+        else if (type == 'b' && index < amounts[5]) {
+            graph.set_output_name(output_amount + index, std::move(name));
+        }
+        else if (type == 'c' && index < amounts[6]) {
+            graph.set_output_name(output_amount + amounts[5] + index,
+                                  std::move(name));
+        }
+        else {
+            return error("invalid symbol table");
+        }
+    }
+    return graph;
+}
+
+std::string write_aiger(const AndInverterGraph &graph)
+{
+    assert(graph.feedback_amount() == 0);
+    std::string text = "aig " +
+                       std::to_string(graph.variable_amount() - 1) + " " +
+                       std::to_string(graph.input_amount()) + " " +
+                       std::to_string(graph.latch_amount()) + " " +
+                       std::to_string(graph.outputs().size()) + " " +
+                       std::to_string(graph.and_amount()) + "\n";
+    for (AigLiteral literal : graph.latch_inputs()) {
+        text += std::to_string(literal) + "\n";
+    }
+    for (AigLiteral literal : graph.outputs()) {
+        text += std::to_string(literal) + "\n";
+    }
+
+    ArrayRef<AigLiteral> and_inputs = graph.and_inputs();
+    for (uint32_t i = 0; i < graph.and_amount(); i++) {
+        AigLiteral output = aig_literal(graph.first_and_variable() + i);
+        AigLiteral input1 = std::max(and_inputs[i * 2], and_inputs[i * 2 + 1]);
+        AigLiteral input2 = std::min(and_inputs[i * 2], and_inputs[i * 2 + 1]);
+        assert(input1 < output);
+        write_varint(text, output - input1);
+        write_varint(text, input1 - input2);
+    }
+
+    auto write_symbol = [&](char type, size_t index, const std::string &name) {
+        if (!name.empty()) {
+            text += type + std::to_string(index) + " " + name + "\n";
+        }
+    };
+    for (uint32_t i = 0; i < graph.input_amount(); i++) {
+        write_symbol('i', i, graph.input_name(i));
+    }
+    for (uint32_t i = 0; i < graph.latch_amount(); i++) {
+        write_symbol('l', i, graph.latch_name(i));
+    }
+    for (size_t i : graph.outputs().index_range()) {
+        write_symbol('o', i, graph.output_name((uint32_t)i));
+    }
+    text += "c\nwritten by gate_sim\n";
+    return text;
+}
+
+}  // namespace gate_sim
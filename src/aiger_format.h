@@ -0,0 +1,33 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include "and_inverter_graph.h"
+
+namespace gate_sim {
+
+using bas::uint8_t;
+
+/**
+ * Parse an and-inverter graph from the binary AIGER format, including the
+ * names in the symbol table. The delta encoded and nodes are decoded directly
+ * into the literal array of the graph.
+ *
+ * Bad state properties and invariant constraints become outputs after the
+ * regular outputs, so that they can be observed. Justice and fairness
+ * properties are not supported. Latches have to start at zero, like all
+ * flip-flops, or be uninitialized.
+ *
+ * Returns nothing and sets the error message when the data is invalid.
+ */
+std::optional<AndInverterGraph> parse_aiger(ArrayRef<uint8_t> data,
+                                            std::string &r_error);
+
+/**
+ * Encode a graph in the binary AIGER format. The graph must not have
+ * feedback variables.
+ */
+std::string write_aiger(const AndInverterGraph &graph);
+
+}  // namespace gate_sim
@@ -0,0 +1,275 @@
+#include "bas/map.h"
+
+#include "and_inverter_graph.h"
+#include "combinational_loops.h"
+#include "netlist.h"
+
+namespace gate_sim {
+
+using bas::Map;
+
+/* Used for nets and variables that have not been converted yet. */
+static constexpr AigLiteral NO_LITERAL = (AigLiteral)-1;
+static constexpr NetId NO_NET = (NetId)-1;
+
+AndInverterGraph::AndInverterGraph(uint32_t input_amount,
+                                   uint32_t latch_amount,
+                                   uint32_t feedback_amount)
+    : m_input_amount(input_amount),
+      m_latch_inputs(latch_amount, AIG_FALSE),
+      m_feedback_inputs(feedback_amount, AIG_FALSE),
+      m_input_names(input_amount),
+      m_latch_names(latch_amount)
+{
+}
+
+/**
+ * Combine all values with a binary operation in a balanced tree, so that the
+ * depth only grows logarithmically. The values are overwritten.
+ */
+template<typename FuncT>
+static AigLiteral reduce_balanced(MutableArrayRef<AigLiteral> values,
+                                  const FuncT &func)
+{
+    assert(values.size() > 0);
+    size_t amount = values.size();
+    while (amount > 1) {
+        size_t new_amount = 0;
+        for (size_t i = 0; i + 1 < amount; i += 2) {
+            values[new_amount++] = func(values[i], values[i + 1]);
+        }
+        if (amount % 2 == 1) {
+            values[new_amount++] = values[amount - 1];
+        }
+        amount = new_amount;
+    }
+    return values[0];
+}
+
+AndInverterGraph AndInverterGraph::FromCircuit(
+    const Circuit &circuit, Vector<AigLiteral> &r_net_literals)
+{
+    Netlist netlist = Netlist::FromCircuit(circuit);
+    CombinationalLoops loops = CombinationalLoops::FromNetlist(netlist);
+
+    Vector<NetId> input_nets = circuit.input_nets();
+    for (NetId net : circuit.nets()) {
+        if (circuit.net_driver(net) == NO_GATE) {
+            input_nets.append(net);
+        }
+    }
+    Vector<GateId> flip_flops = circuit.flip_flops();
+    Vector<GateId> feedback_gates;
+    for (GateId gate : circuit.gates()) {
+        if (loops.loop_of_gate(gate) != NO_LOOP) {
+            feedback_gates.append(gate);
+        }
+    }
+
+    AndInverterGraph graph((uint32_t)input_nets.size(),
+                           (uint32_t)flip_flops.size(),
+                           (uint32_t)feedback_gates.size());
+    r_net_literals = Vector<AigLiteral>(circuit.net_amount(), NO_LITERAL);
+    for (uint32_t i : input_nets.index_range()) {
+        r_net_literals[input_nets[i]] = aig_literal(1 + i);
+        graph.set_input_name(i, circuit.net_name(input_nets[i]));
+    }
+    for (uint32_t i : flip_flops.index_range()) {
+        NetId net = circuit.gate_output(flip_flops[i]);
+        r_net_literals[net] = aig_literal(graph.first_latch_variable() + i);
+        graph.set_latch_name(i, circuit.net_name(net));
+    }
+    for (uint32_t i : feedback_gates.index_range()) {
+        NetId net = circuit.gate_output(feedback_gates[i]);
+        r_net_literals[net] = aig_literal(graph.first_feedback_variable() +
+                                          i);
+    }
+
+    /* Simplify trivial nodes and only create one node for every pair of
+     * inputs. */
+    Map<std::pair<AigLiteral, AigLiteral>, AigLiteral> and_by_inputs;
+    auto add_and = [&](AigLiteral a, AigLiteral b) -> AigLiteral {
+        if (a < b) {
+            std::swap(a, b);
+        }
+        if (b == AIG_FALSE || a == aig_negate(b)) {
+            return AIG_FALSE;
+        }
+        if (b == AIG_TRUE || a == b) {
+            return a;
+        }
+        return and_by_inputs.lookup_or_add(
+            {a, b}, [&]() { return graph.add_and(a, b); });
+    };
+    auto add_xor = [&](AigLiteral a, AigLiteral b) {
+        AigLiteral only_a = add_and(a, aig_negate(b));
+        AigLiteral only_b = add_and(aig_negate(a), b);
+        return aig_negate(
+            add_and(aig_negate(only_a), aig_negate(only_b)));
+    };
+
+    Vector<AigLiteral> literals;
+    auto gate_literal = [&](GateId gate) -> AigLiteral {
+        literals.clear();
+        for (NetId net : circuit.gate_inputs(gate)) {
+            literals.append(r_net_literals[net]);
+        }
+        auto negate_all = [&]() {
+            for (AigLiteral &literal : literals) {
+                literal = aig_negate(literal);
+            }
+        };
+        switch (circuit.gate_type(gate)) {
+            case GateType::Constant0:
+                return AIG_FALSE;
+            case GateType::Constant1:
+                return AIG_TRUE;
+            case GateType::Buffer:
+                return literals[0];
+            case GateType::Not:
+                return aig_negate(literals[0]);
+            case GateType::And:
+                return reduce_balanced(literals, add_and);
+            case GateType::Nand:
+                return aig_negate(reduce_balanced(literals, add_and));
+            case GateType::Or:
+                negate_all();
+                return aig_negate(reduce_balanced(literals, add_and));
+            case GateType::Nor:
+                negate_all();
+                return reduce_balanced(literals, add_and);
+            case GateType::Xor:
+                return reduce_balanced(literals, add_xor);
+            case GateType::Xnor:
+                return aig_negate(reduce_balanced(literals, add_xor));
+            case GateType::Tristate:
+                /* Zero when disabled, like in the other two-valued
+                 * simulators. */
+                return add_and(literals[0], literals[1]);
+            case GateType::Input:
+            case GateType::FlipFlop:
+                break;
+        }
+        assert(false);
+        return AIG_FALSE;
+    };
+
+    /* Convert the gate of every net after the gates of its inputs. This does
+     * not use recursion, because paths can be very long. Inputs, latches and
+     * feedback variables already have their literals, so the remaining
+     * gates do not form loops. */
+    Vector<bool> is_expanded(circuit.net_amount(), false);
+    Vector<NetId> stack;
+    for (NetId root : circuit.nets()) {
+        if (r_net_literals[root] != NO_LITERAL) {
+            continue;
+        }
+        stack.append(root);
+        while (!stack.is_empty()) {
+            NetId net = stack.last();
+            if (r_net_literals[net] != NO_LITERAL) {
+                stack.remove_last();
+                continue;
+            }
+            GateId gate = circuit.net_driver(net);
+            if (!is_expanded[net]) {
+                is_expanded[net] = true;
+                for (NetId input : circuit.gate_inputs(gate)) {
+                    if (r_net_literals[input] == NO_LITERAL) {
+                        stack.append(input);
+                    }
+                }
+                continue;
+            }
+            r_net_literals[net] = gate_literal(gate);
+            stack.remove_last();
+        }
+    }
+
+    for (uint32_t i : feedback_gates.index_range()) {
+        graph.set_feedback_input(i, gate_literal(feedback_gates[i]));
+    }
+    for (uint32_t i : flip_flops.index_range()) {
+        NetId input = circuit.gate_inputs(flip_flops[i])[0];
+        graph.set_latch_input(i, r_net_literals[input]);
+    }
+    for (NetId net : circuit.output_nets()) {
+        graph.add_output(r_net_literals[net], circuit.net_name(net));
+    }
+    return graph;
+}
+
+Circuit AndInverterGraph::to_circuit() const
+{
+    Circuit circuit;
+    /* Nets of negated literals and of the constants are only created when
+     * they are used. */
+    Vector<NetId> variable_nets(this->variable_amount(), NO_NET);
+    Vector<NetId> negated_nets(this->variable_amount(), NO_NET);
+    auto get_net = [&](AigLiteral literal) {
+        uint32_t variable = aig_variable(literal);
+        bool is_negated = aig_is_negated(literal);
+        NetId &net = is_negated ? negated_nets[variable] :
+                                  variable_nets[variable];
+        if (net == NO_NET) {
+            net = circuit.add_net();
+            if (variable == 0) {
+                circuit.add_gate(is_negated ? GateType::Constant1 :
+                                              GateType::Constant0,
+                                 {},
+                                 net);
+            }
+            else {
+                circuit.add_gate(
+                    GateType::Not, {variable_nets[variable]}, net);
+            }
+        }
+        return net;
+    };
+
+    for (uint32_t i = 0; i < m_input_amount; i++) {
+        NetId net = circuit.add_net(m_input_names[i]);
+        circuit.add_gate(GateType::Input, {}, net);
+        variable_nets[1 + i] = net;
+    }
+    for (uint32_t i = 0; i < this->latch_amount(); i++) {
+        variable_nets[this->first_latch_variable() + i] = circuit.add_net(
+            m_latch_names[i]);
+    }
+    for (uint32_t i = 0; i < this->feedback_amount(); i++) {
+        variable_nets[this->first_feedback_variable() + i] =
+            circuit.add_net();
+    }
+    for (uint32_t i = 0; i < this->and_amount(); i++) {
+        NetId input1 = get_net(m_and_inputs[i * 2]);
+        NetId input2 = get_net(m_and_inputs[i * 2 + 1]);
+        NetId net = circuit.add_net();
+        circuit.add_gate(GateType::And, {input1, input2}, net);
+        variable_nets[this->first_and_variable() + i] = net;
+    }
+    for (uint32_t i = 0; i < this->latch_amount(); i++) {
+        circuit.add_gate(GateType::FlipFlop,
+                         {get_net(m_latch_inputs[i])},
+                         variable_nets[this->first_latch_variable() + i]);
+    }
+    for (uint32_t i = 0; i < this->feedback_amount(); i++) {
+        circuit.add_gate(GateType::Buffer,
+                         {get_net(m_feedback_inputs[i])},
+                         variable_nets[this->first_feedback_variable() + i]);
+    }
+    /* Outputs with other names get their own net, because nets cannot be
+     * renamed. */
+    for (size_t i : m_outputs.index_range()) {
+        NetId net = get_net(m_outputs[i]);
+        const std::string &name = m_output_names[i];
+        if (!name.empty() && name != circuit.net_name(net)) {
+            NetId output_net = circuit.add_net(name);
+            circuit.add_gate(GateType::Buffer, {net}, output_net);
+            net = output_net;
+        }
+        circuit.add_output(net);
+    }
+    return circuit;
+}
+
+}  // namespace gate_sim
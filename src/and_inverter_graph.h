@@ -0,0 +1,224 @@
+#pragma once
+
+#include <string>
+
+#include "circuit.h"
+
+namespace gate_sim {
+
+/**
+ * Reference to a variable of an and-inverter graph, possibly negated. The
+ * variable is stored in the upper 31 bits and the lowest bit tells whether
+ * the value is negated, just like in the AIGER format.
+ */
+using AigLiteral = uint32_t;
+
+constexpr AigLiteral AIG_FALSE = 0;
+constexpr AigLiteral AIG_TRUE = 1;
+
+inline AigLiteral aig_literal(uint32_t variable, bool is_negated = false)
+{
+    return variable * 2 + (is_negated ? 1 : 0);
+}
+
+inline uint32_t aig_variable(AigLiteral literal)
+{
+    return literal >> 1;
+}
+
+inline bool aig_is_negated(AigLiteral literal)
+{
+    return literal & 1;
+}
+
+inline AigLiteral aig_negate(AigLiteral literal)
+{
+    return literal ^ 1;
+}
+
+/**
+ * A circuit in which all combinational logic consists of two-input and
+ * nodes whose inputs can be negated. Every node is described by just the two
+ * literals of its inputs, so the whole logic is one flat array of 32 bit
+ * integers.
+ *
+ * Variables are numbered like in the AIGER format. Variable zero is the
+ * constant false, followed by the inputs, the latches and the and nodes. The
+ * inputs of every and node are variables with lower numbers, so evaluating
+ * the nodes in order computes all values in a single pass.
+ *
+ * Combinational loops cannot be represented that way. Instead, the nets of
+ * a loop get feedback variables, which come after the latches. Like a latch,
+ * a feedback variable takes the value of its input literal, but within a
+ * single step, as often as needed until the values settle. Graphs with
+ * feedback variables cannot be stored in the AIGER format.
+ */
+class AndInverterGraph {
+  private:
+    uint32_t m_input_amount = 0;
+    /* Next value of every latch. */
+    Vector<AigLiteral> m_latch_inputs;
+    Vector<AigLiteral> m_feedback_inputs;
+    /* The two inputs of every and node. */
+    Vector<AigLiteral> m_and_inputs;
+    Vector<AigLiteral> m_outputs;
+
+    /* Names of the inputs, latches and outputs, which may be empty. */
+    Vector<std::string> m_input_names;
+    Vector<std::string> m_latch_names;
+    Vector<std::string> m_output_names;
+
+  public:
+    AndInverterGraph() = default;
+
+    /**
+     * Create a graph without and nodes. The inputs of all latches and
+     * feedback variables are false until they are set.
+     */
+    AndInverterGraph(uint32_t input_amount,
+                     uint32_t latch_amount,
+                     uint32_t feedback_amount = 0);
+
+    /**
+     * Convert all gates of a circuit into and nodes. Nets without a driver
+     * become inputs, after the nets of the input gates. Flip-flops become
+     * latches. Equal nodes are only created once. The literal of every net is
+     * written into the given array.
+     */
+    static AndInverterGraph FromCircuit(const Circuit &circuit,
+                                        Vector<AigLiteral> &r_net_literals);
+
+    /**
+     * Create a circuit with an and gate for every and node and not gates for
+     * negated literals.
+     */
+    Circuit to_circuit() const;
+
+    uint32_t input_amount() const
+    {
+        return m_input_amount;
+    }
+
+    uint32_t latch_amount() const
+    {
+        return (uint32_t)m_latch_inputs.size();
+    }
+
+    uint32_t feedback_amount() const
+    {
+        return (uint32_t)m_feedback_inputs.size();
+    }
+
+    uint32_t and_amount() const
+    {
+        return (uint32_t)m_and_inputs.size() / 2;
+    }
+
+    uint32_t first_latch_variable() const
+    {
+        return 1 + m_input_amount;
+    }
+
+    uint32_t first_feedback_variable() const
+    {
+        return this->first_latch_variable() + this->latch_amount();
+    }
+
+    uint32_t first_and_variable() const
+    {
+        return this->first_feedback_variable() + this->feedback_amount();
+    }
+
+    /**
+     * Number of variables including the constant.
+     */
+    uint32_t variable_amount() const
+    {
+        return this->first_and_variable() + this->and_amount();
+    }
+
+    /**
+     * Add an and node and return the literal of its output. Both inputs have
+     * to be existing variables.
+     */
+    AigLiteral add_and(AigLiteral input1, AigLiteral input2)
+    {
+        assert(aig_variable(input1) < this->variable_amount());
+        assert(aig_variable(input2) < this->variable_amount());
+        AigLiteral output = aig_literal(this->variable_amount());
+        m_and_inputs.append(input1);
+        m_and_inputs.append(input2);
+        return output;
+    }
+
+    /**
+     * The inputs of all and nodes, two consecutive literals per node.
+     */
+    ArrayRef<AigLiteral> and_inputs() const
+    {
+        return m_and_inputs;
+    }
+
+    ArrayRef<AigLiteral> latch_inputs() const
+    {
+        return m_latch_inputs;
+    }
+
+    void set_latch_input(uint32_t latch, AigLiteral literal)
+    {
+        m_latch_inputs[latch] = literal;
+    }
+
+    ArrayRef<AigLiteral> feedback_inputs() const
+    {
+        return m_feedback_inputs;
+    }
+
+    void set_feedback_input(uint32_t feedback, AigLiteral literal)
+    {
+        m_feedback_inputs[feedback] = literal;
+    }
+
+    ArrayRef<AigLiteral> outputs() const
+    {
+        return m_outputs;
+    }
+
+    void add_output(AigLiteral literal, std::string name = "")
+    {
+        m_outputs.append(literal);
+        m_output_names.append(std::move(name));
+    }
+
+    const std::string &input_name(uint32_t input) const
+    {
+        return m_input_names[input];
+    }
+
+    void set_input_name(uint32_t input, std::string name)
+    {
+        m_input_names[input] = std::move(name);
+    }
+
+    const std::string &latch_name(uint32_t latch) const
+    {
+        return m_latch_names[latch];
+    }
+
+    void set_latch_name(uint32_t latch, std::string name)
+    {
+        m_latch_names[latch] = std::move(name);
+    }
+
+    const std::string &output_name(uint32_t output) const
+    {
+        return m_output_names[output];
+    }
+
+    void set_output_name(uint32_t output, std::string name)
+    {
+        m_output_names[output] = std::move(name);
+    }
+};
+
+}  // namespace gate_sim
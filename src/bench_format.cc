@@ -0,0 +1,171 @@
+#include "bas/string_map.h"
+
+#include "bench_format.h"
+
+namespace gate_sim {
+
+using bas::ssize_t;
+using bas::StringMap;
+
+static bool equals_ignore_case(StringRef text, StringRef lower_keyword)
+{
+    return text.size() == lower_keyword.size() &&
+           text.startswith_lower_ascii(lower_keyword);
+}
+
+static bool gate_type_from_keyword(StringRef keyword, GateType &r_type)
+{
+    static const std::pair<const char *, GateType> keywords[] = {
+        {"and", GateType::And},
+        {"nand", GateType::Nand},
+        {"or", GateType::Or},
+        {"nor", GateType::Nor},
+        {"xor", GateType::Xor},
+        {"xnor", GateType::Xnor},
+        {"not", GateType::Not},
+        {"buf", GateType::Buffer},
+        {"buff", GateType::Buffer},
+        {"dff", GateType::FlipFlop},
+    };
+    for (const auto &item : keywords) {
+        if (equals_ignore_case(keyword, item.first)) {
+            r_type = item.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Split a call like "NAND(G1, G3)" into the name in front of the parentheses
+ * and the comma separated arguments. Returns false when the parentheses are
+ * missing.
+ */
+static bool split_call(StringRef text,
+                       StringRef &r_name,
+                       Vector<StringRef> &r_arguments)
+{
+    r_arguments.clear();
+    ssize_t open = text.try_first_index_of('(');
+    if (open < 0 || !text.endswith(')')) {
+        return false;
+    }
+    r_name = text.substr(0, (size_t)open).strip();
+    StringRef arguments = text.substr((size_t)open + 1,
+                                      text.size() - (size_t)open - 2);
+    if (arguments.strip().size() == 0) {
+        return true;
+    }
+    size_t start = 0;
+    while (true) {
+        ssize_t comma = arguments.try_first_index_of(',', start);
+        size_t end = comma < 0 ? arguments.size() : (size_t)comma;
+        r_arguments.append(arguments.substr(start, end - start).strip());
+        if (comma < 0) {
+            return true;
+        }
+        start = end + 1;
+    }
+}
+
+std::optional<Circuit> parse_bench(StringRef text, std::string &r_error)
+{
+    Circuit circuit;
+    StringMap<NetId> net_by_name;
+    auto get_net = [&](StringRef name) {
+        const NetId *net = net_by_name.lookup_ptr(name);
+        if (net != nullptr) {
+            return *net;
+        }
+        NetId new_net = circuit.add_net(name);
+        net_by_name.add_new(name, new_net);
+        return new_net;
+    };
+
+    StringRef name;
+    Vector<StringRef> arguments;
+    Vector<NetId> inputs;
+    size_t line_start = 0;
+    for (size_t line_number = 1; line_start < text.size(); line_number++) {
+        size_t line_end = line_start;
+        while (line_end < text.size() && text[line_end] != '\n') {
+            line_end++;
+        }
+        StringRef line = text.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+
+        ssize_t comment_start = line.try_first_index_of('#');
+        if (comment_start >= 0) {
+            line = line.substr(0, (size_t)comment_start);
+        }
+        line = line.strip();
+        if (line.size() == 0) {
+            continue;
+        }
+
+        auto error = [&](const std::string &message) {
+            r_error = "line " + std::to_string(line_number) + ": " + message;
+            return std::nullopt;
+        };
+        auto drive = [&](NetId net,
+                         GateType type,
+                         ArrayRef<NetId> gate_inputs) {
+            if (circuit.net_driver(net) != NO_GATE) {
+                return false;
+            }
+            circuit.add_gate(type, gate_inputs, net);
+            return true;
+        };
+
+        ssize_t equal_sign = line.try_first_index_of('=');
+        if (equal_sign < 0) {
+            /* Declaration of an input or output. */
+            if (!split_call(line, name, arguments) || arguments.size() != 1 ||
+                arguments[0].size() == 0) {
+                return error("expected INPUT(name) or OUTPUT(name)");
+            }
+            NetId net = get_net(arguments[0]);
+            if (equals_ignore_case(name, "input")) {
+                if (!drive(net, GateType::Input, {})) {
+                    return error("net '" + std::string(arguments[0]) +
+                                 "' has more than one driver");
+                }
+            }
+            else if (equals_ignore_case(name, "output")) {
+                circuit.add_output(net);
+            }
+            else {
+                return error("expected INPUT(name) or OUTPUT(name)");
+            }
+            continue;
+        }
+
+        StringRef output_name = line.substr(0, (size_t)equal_sign).strip();
+        StringRef call = line.drop_prefix((size_t)equal_sign + 1).strip();
+        GateType type;
+        if (output_name.size() == 0 || !split_call(call, name, arguments)) {
+            return error("expected name = GATE(inputs)");
+        }
+        if (!gate_type_from_keyword(name, type)) {
+            return error("unknown gate type '" + std::string(name) + "'");
+        }
+        inputs.clear();
+        for (StringRef argument : arguments) {
+            if (argument.size() == 0) {
+                return error("missing input name");
+            }
+            inputs.append(get_net(argument));
+        }
+        if (!gate_type_supports_input_amount(type, inputs.size())) {
+            return error("wrong number of inputs for '" + std::string(name) +
+                         "'");
+        }
+        if (!drive(get_net(output_name), type, inputs)) {
+            return error("net '" + std::string(output_name) +
+                         "' has more than one driver");
+        }
+    }
+    return circuit;
+}
+
+}  // namespace gate_sim
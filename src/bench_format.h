@@ -0,0 +1,33 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include "bas/string_ref.h"
+
+#include "circuit.h"
+
+namespace gate_sim {
+
+using bas::StringRef;
+
+/**
+ * Parse a circuit in the .bench format of the ISCAS-85 and ISCAS-89
+ * benchmark circuits:
+ *
+ *   # c17
+ *   INPUT(G1)
+ *   OUTPUT(G22)
+ *   G10 = NAND(G1, G3)
+ *   G5 = DFF(G10)
+ *
+ * The gate types are AND, NAND, OR, NOR, XOR, XNOR, NOT, BUF (or BUFF) and
+ * DFF, independent of the case. Flip-flops belong to the global clock. Nets
+ * can be used before the line that drives them. Everything after a '#' is a
+ * comment.
+ *
+ * Returns nothing and sets the error message when the text is invalid.
+ */
+std::optional<Circuit> parse_bench(StringRef text, std::string &r_error);
+
+}  // namespace gate_sim
@@ -0,0 +1,73 @@
+#include <cstring>
+
+#include "binary_stimulus.h"
+
+namespace gate_sim {
+
+static constexpr char MAGIC[8] = {'G', 'S', 'S', 'T', 'I', 'M', '0', '1'};
+static constexpr size_t HEADER_SIZE = 16;
+
+/* Number of bytes that are released at once. Releasing is a system call,
+ * so it should not happen for every cycle. */
+static constexpr size_t RELEASE_GRANULARITY = 64 * 1024 * 1024;
+
+BinaryStimulus::BinaryStimulus(std::unique_ptr<MappedFile> file,
+                               uint32_t input_amount)
+    : m_file(std::move(file)),
+      m_input_amount(input_amount)
+{
+    /* The mapping starts at a page boundary, so all words are aligned. */
+    m_words = (const uint64_t *)(m_file->data().begin() + HEADER_SIZE);
+    m_cycle_amount = (m_file->size() - HEADER_SIZE) /
+                     (input_amount * sizeof(uint64_t));
+    m_file->advise_sequential();
+}
+
+std::unique_ptr<BinaryStimulus> BinaryStimulus::Open(const char *path,
+                                                     uint32_t input_amount,
+                                                     std::string &r_error)
+{
+    if (input_amount == 0) {
+        r_error = "the circuit has no inputs";
+        return {};
+    }
+    std::unique_ptr<MappedFile> file = MappedFile::Open(path, r_error);
+    if (!file) {
+        return {};
+    }
+    ArrayRef<uint8_t> data = file->data();
+    if (data.size() < HEADER_SIZE ||
+        memcmp(data.begin(), MAGIC, sizeof(MAGIC)) != 0) {
+        r_error = "not a binary stimulus file";
+        return {};
+    }
+    /* The words are read in the byte order of the machine, which is
+     * little endian on all supported platforms. */
+    uint32_t file_input_amount;
+    memcpy(&file_input_amount, data.begin() + 8, sizeof(uint32_t));
+    if (file_input_amount != input_amount) {
+        r_error = "expected stimulus for " + std::to_string(input_amount) +
+                  " inputs, but the file has " +
+                  std::to_string(file_input_amount);
+        return {};
+    }
+    if ((data.size() - HEADER_SIZE) % (input_amount * sizeof(uint64_t)) !=
+        0) {
+        r_error = "the last cycle is incomplete";
+        return {};
+    }
+    return std::unique_ptr<BinaryStimulus>(
+        new BinaryStimulus(std::move(file), input_amount));
+}
+
+void BinaryStimulus::release_before(uint64_t cycle)
+{
+    size_t offset = HEADER_SIZE + cycle * m_input_amount * sizeof(uint64_t);
+    if (offset - m_released_size < RELEASE_GRANULARITY) {
+        return;
+    }
+    m_file->advise_done(m_released_size, offset - m_released_size);
+    m_released_size = offset;
+}
+
+}  // namespace gate_sim
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "mapped_file.h"
+
+namespace gate_sim {
+
+using bas::uint32_t;
+using bas::uint64_t;
+
+/**
+ * Input values for many cycles in a binary file that is streamed through
+ * memory instead of being loaded, so that the file can be much larger than
+ * the main memory.
+ *
+ * The file starts with a 16 byte header: the 8 bytes "GSSTIM01", the number
+ * of inputs as 32 bit little endian integer and 4 zero bytes. It is followed
+ * by one record per cycle, which contains one 64 bit little endian word per
+ * input in the order of Circuit::input_nets. Every bit of a word is the
+ * value of the input in one lane, so the words can be given to
+ * Simulator::set_net_lanes directly.
+ */
+class BinaryStimulus {
+  private:
+    std::unique_ptr<MappedFile> m_file;
+    const uint64_t *m_words;
+    uint32_t m_input_amount;
+    uint64_t m_cycle_amount;
+    /* Everything before this byte offset has been released. */
+    size_t m_released_size = 0;
+
+  public:
+    /**
+     * Returns null and sets the error message when the file cannot be read
+     * or does not contain stimulus for the given number of inputs.
+     */
+    static std::unique_ptr<BinaryStimulus> Open(const char *path,
+                                                uint32_t input_amount,
+                                                std::string &r_error);
+
+    uint64_t cycle_amount() const
+    {
+        return m_cycle_amount;
+    }
+
+    /**
+     * Values of all inputs in a cycle. They point into the mapped file, so
+     * nothing is copied.
+     */
+    ArrayRef<uint64_t> cycle_inputs(uint64_t cycle) const
+    {
+        assert(cycle < m_cycle_amount);
+        return ArrayRef<uint64_t>(m_words + cycle * m_input_amount,
+                                  m_input_amount);
+    }
+
+    /**
+     * Allow the operating system to drop the memory of all cycles before
+     * the given one. Otherwise the page cache of a large file can push other
+     * memory out while streaming through it.
+     */
+    void release_before(uint64_t cycle);
+
+  private:
+    BinaryStimulus(std::unique_ptr<MappedFile> file, uint32_t input_amount);
+};
+
+}  // namespace gate_sim
@@ -0,0 +1,636 @@
+#include <algorithm>
+
+#include "bas/string_map.h"
+
+#include "blif_format.h"
+
+namespace gate_sim {
+
+using bas::StringMap;
+
+/* Text is split into chunks of about this size for parallel parsing. */
+static constexpr size_t CHUNK_SIZE = 4 << 20;
+
+/* Used for local nets that have not been mapped to a net of the circuit
+ * yet. */
+static constexpr uint32_t NO_NET = (uint32_t)-1;
+
+enum class RecordType : uint32_t {
+    Model,
+    End,
+    /* Followed by the net. */
+    Input,
+    Output,
+    /* Followed by the gate type, the output, the input amount and the
+     * inputs. */
+    Gate,
+};
+
+/**
+ * Result of parsing one chunk. Nets are referenced by local indices that are
+ * only valid within the chunk. Nets that are created for the gates of a cover
+ * have no name.
+ */
+struct BlifChunk {
+    StringRef text;
+    StringMap<uint32_t> local_net_by_name;
+    Vector<StringRef> local_net_names;
+    /* Every record starts with its type and line number in the chunk. */
+    Vector<uint32_t> records;
+    uint32_t line_amount = 0;
+    /* Parsing stops at the first error, the records before are kept. */
+    std::string error;
+    uint32_t error_line = 0;
+};
+
+static bool is_whitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**
+ * Returns true when the backslash at the index ends the line, so that the
+ * line is continued on the next one.
+ */
+static bool is_line_continuation(StringRef text, size_t index)
+{
+    if (text[index] != '\\') {
+        return false;
+    }
+    size_t next = index + 1;
+    if (next < text.size() && text[next] == '\r') {
+        next++;
+    }
+    return next < text.size() && text[next] == '\n';
+}
+
+/**
+ * Split the line that starts at the position into tokens and move the
+ * position to the start of the next line. Continued lines are read as one
+ * line. Everything after a '#' is a comment.
+ */
+static void read_line(StringRef text,
+                      size_t &r_position,
+                      uint32_t &r_line_amount,
+                      Vector<StringRef> &r_tokens)
+{
+    r_tokens.clear();
+    bool is_comment = false;
+    size_t i = r_position;
+    while (i < text.size()) {
+        char c = text[i];
+        if (c == '\n') {
+            i++;
+            r_line_amount++;
+            break;
+        }
+        if (is_line_continuation(text, i)) {
+            while (text[i] != '\n') {
+                i++;
+            }
+            i++;
+            r_line_amount++;
+            continue;
+        }
+        if (is_comment || is_whitespace(c)) {
+            i++;
+            continue;
+        }
+        if (c == '#') {
+            is_comment = true;
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < text.size() && !is_whitespace(text[i]) &&
+               text[i] != '\n' && text[i] != '#' &&
+               !is_line_continuation(text, i)) {
+            i++;
+        }
+        r_tokens.append(text.substr(start, i - start));
+    }
+    r_position = i;
+}
+
+/**
+ * Find the start of the first line at or after the position that starts a
+ * directive and is not the continuation of the line before. Chunks can be
+ * parsed independently when they are split there, because covers and
+ * continued lines never extend over a directive.
+ */
+static size_t find_directive_start(StringRef text, size_t position)
+{
+    while (position < text.size() && text[position - 1] != '\n') {
+        position++;
+    }
+    while (position < text.size()) {
+        bool is_continued = (position >= 2 &&
+                             is_line_continuation(text, position - 2)) ||
+                            (position >= 3 &&
+                             is_line_continuation(text, position - 3));
+        if (text[position] == '.' && !is_continued) {
+            return position;
+        }
+        while (position < text.size() && text[position] != '\n') {
+            position++;
+        }
+        position++;
+    }
+    return text.size();
+}
+
+static uint32_t get_local_net(BlifChunk &chunk, StringRef name)
+{
+    const uint32_t *net = chunk.local_net_by_name.lookup_ptr(name);
+    if (net != nullptr) {
+        return *net;
+    }
+    uint32_t new_net = (uint32_t)chunk.local_net_names.size();
+    chunk.local_net_names.append(name);
+    chunk.local_net_by_name.add_new(name, new_net);
+    return new_net;
+}
+
+static uint32_t add_unnamed_local_net(BlifChunk &chunk)
+{
+    uint32_t new_net = (uint32_t)chunk.local_net_names.size();
+    chunk.local_net_names.append(StringRef());
+    return new_net;
+}
+
+static void add_gate_record(BlifChunk &chunk,
+                            uint32_t line,
+                            GateType type,
+                            ArrayRef<uint32_t> inputs,
+                            uint32_t output)
+{
+    chunk.records.append((uint32_t)RecordType::Gate);
+    chunk.records.append(line);
+    chunk.records.append((uint32_t)type);
+    chunk.records.append(output);
+    chunk.records.append((uint32_t)inputs.size());
+    chunk.records.extend(inputs);
+}
+
+/**
+ * Returns true when the cover contains exactly the input combinations with
+ * an odd or exactly those with an even number of ones, i.e. when it is an
+ * xor or xnor. Only checked for few inputs, because the cover grows
+ * exponentially.
+ */
+static bool is_parity_cover(ArrayRef<StringRef> planes,
+                            size_t input_amount,
+                            bool &r_is_odd)
+{
+    if (input_amount < 2 || input_amount > 6 ||
+        planes.size() != (size_t)1 << (input_amount - 1)) {
+        return false;
+    }
+    uint64_t used_combinations = 0;
+    for (size_t i : planes.index_range()) {
+        uint32_t combination = 0;
+        bool is_odd = false;
+        for (size_t j = 0; j < input_amount; j++) {
+            if (planes[i][j] == '-') {
+                return false;
+            }
+            if (planes[i][j] == '1') {
+                combination |= 1 << j;
+                is_odd = !is_odd;
+            }
+        }
+        if (i == 0) {
+            r_is_odd = is_odd;
+        }
+        uint64_t bit = (uint64_t)1 << combination;
+        if (is_odd != r_is_odd || (used_combinations & bit)) {
+            return false;
+        }
+        used_combinations |= bit;
+    }
+    return true;
+}
+
+/**
+ * Add the gates for a cover. The output is one for the input combinations
+ * that match any of the rows when the value of the rows is one, and zero for
+ * them otherwise. The last gate drives the output net.
+ */
+static void add_cover_gates(BlifChunk &chunk,
+                            uint32_t line,
+                            ArrayRef<uint32_t> inputs,
+                            uint32_t output,
+                            ArrayRef<StringRef> planes,
+                            bool value)
+{
+    auto add_gate = [&](GateType type,
+                        ArrayRef<uint32_t> gate_inputs,
+                        uint32_t gate_output) {
+        add_gate_record(chunk, line, type, gate_inputs, gate_output);
+    };
+
+    /* Without rows, the output is always zero. */
+    if (planes.size() == 0) {
+        add_gate(GateType::Constant0, {}, output);
+        return;
+    }
+    bool all_positive = true;
+    bool all_negative = true;
+    bool all_single_literals = true;
+    for (StringRef plane : planes) {
+        size_t literal_amount = 0;
+        for (char c : plane) {
+            all_positive &= c != '0';
+            all_negative &= c != '1';
+            literal_amount += c != '-';
+        }
+        if (literal_amount == 0) {
+            add_gate(value ? GateType::Constant1 : GateType::Constant0,
+                     {},
+                     output);
+            return;
+        }
+        all_single_literals &= literal_amount == 1;
+    }
+
+    /* Negated inputs are only created once per cover. */
+    Vector<uint32_t> inverted_inputs(inputs.size(), NO_NET);
+    auto get_literal = [&](size_t input_index, char c) {
+        if (c == '1') {
+            return inputs[input_index];
+        }
+        uint32_t &inverted_input = inverted_inputs[input_index];
+        if (inverted_input == NO_NET) {
+            inverted_input = add_unnamed_local_net(chunk);
+            add_gate(GateType::Not, {inputs[input_index]}, inverted_input);
+        }
+        return inverted_input;
+    };
+    /* Inputs of cubes with only negated literals are not inverted, because
+     * the gate type accounts for that. */
+    Vector<uint32_t> literals;
+    auto get_literals = [&](StringRef plane, bool invert) {
+        literals.clear();
+        for (size_t i : IndexRange(plane.size())) {
+            if (plane[i] != '-') {
+                literals.append(invert ? get_literal(i, plane[i]) :
+                                         inputs[i]);
+            }
+        }
+    };
+
+    if (planes.size() == 1) {
+        StringRef plane = planes[0];
+        if (all_single_literals) {
+            get_literals(plane, false);
+            add_gate(all_positive == value ? GateType::Buffer :
+                                             GateType::Not,
+                     literals,
+                     output);
+        }
+        else if (all_positive) {
+            get_literals(plane, false);
+            add_gate(value ? GateType::And : GateType::Nand, literals, output);
+        }
+        else if (all_negative) {
+            get_literals(plane, false);
+            add_gate(value ? GateType::Nor : GateType::Or, literals, output);
+        }
+        else {
+            get_literals(plane, true);
+            add_gate(value ? GateType::And : GateType::Nand, literals, output);
+        }
+        return;
+    }
+
+    if (all_single_literals) {
+        Vector<uint32_t> terms;
+        for (StringRef plane : planes) {
+            get_literals(plane, !all_positive && !all_negative);
+            terms.append(literals[0]);
+        }
+        if (all_negative) {
+            add_gate(value ? GateType::Nand : GateType::And, terms, output);
+        }
+        else {
+            add_gate(value ? GateType::Or : GateType::Nor, terms, output);
+        }
+        return;
+    }
+
+    bool is_odd = false;
+    if (is_parity_cover(planes, inputs.size(), is_odd)) {
+        add_gate(is_odd == value ? GateType::Xor : GateType::Xnor,
+                 inputs,
+                 output);
+        return;
+    }
+
+    /* Sum of products. */
+    Vector<uint32_t> terms;
+    for (StringRef plane : planes) {
+        get_literals(plane, true);
+        if (literals.size() == 1) {
+            terms.append(literals[0]);
+        }
+        else {
+            uint32_t term = add_unnamed_local_net(chunk);
+            add_gate(GateType::And, literals, term);
+            terms.append(term);
+        }
+    }
+    add_gate(value ? GateType::Or : GateType::Nor, terms, output);
+}
+
+static bool is_ignored_directive(StringRef keyword)
+{
+    /* Timing and clock information that the simulation does not use. */
+    static const char *ignored_keywords[] = {
+        ".clock",
+        ".area",
+        ".delay",
+        ".wire_load_slope",
+        ".wire",
+        ".input_arrival",
+        ".default_input_arrival",
+        ".output_required",
+        ".default_output_required",
+        ".input_drive",
+        ".default_input_drive",
+        ".output_load",
+        ".default_output_load",
+        ".max_input_load",
+        ".default_max_input_load",
+    };
+    for (const char *ignored_keyword : ignored_keywords) {
+        if (keyword == ignored_keyword) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void parse_chunk(BlifChunk &chunk)
+{
+    auto error = [&](uint32_t line, const std::string &message) {
+        chunk.error = message;
+        chunk.error_line = line;
+    };
+    auto add_record = [&](RecordType type, uint32_t line) {
+        chunk.records.append((uint32_t)type);
+        chunk.records.append(line);
+    };
+
+    Vector<StringRef> tokens;
+    /* The cover that is currently read, which ends at the next directive. */
+    bool is_in_cover = false;
+    uint32_t cover_line = 0;
+    Vector<uint32_t> cover_nets;
+    Vector<StringRef> cover_planes;
+    bool cover_value = true;
+    auto finish_cover = [&]() {
+        if (is_in_cover) {
+            add_cover_gates(chunk,
+                            cover_line,
+                            cover_nets.as_ref().drop_back(1),
+                            cover_nets.last(),
+                            cover_planes,
+                            cover_value);
+            is_in_cover = false;
+        }
+    };
+
+    size_t position = 0;
+    while (position < chunk.text.size()) {
+        uint32_t line = chunk.line_amount + 1;
+        read_line(chunk.text, position, chunk.line_amount, tokens);
+        if (tokens.is_empty()) {
+            continue;
+        }
+        StringRef keyword = tokens[0];
+
+        if (!keyword.startswith('.')) {
+            if (!is_in_cover) {
+                return error(line, "unexpected '" + std::string(keyword) +
+                                       "'");
+            }
+            size_t input_amount = cover_nets.size() - 1;
+            StringRef plane = input_amount == 0 ? StringRef() : tokens[0];
+            if (tokens.size() != (input_amount == 0 ? 1 : 2)) {
+                return error(line, "invalid cover row");
+            }
+            StringRef output_value = tokens.last();
+            if (plane.size() != input_amount) {
+                return error(line, "expected " +
+                                       std::to_string(input_amount) +
+                                       " input values in cover row");
+            }
+            for (char c : plane) {
+                if (c != '0' && c != '1' && c != '-') {
+                    return error(line, "invalid input value in cover row");
+                }
+            }
+            if (output_value != "0" && output_value != "1") {
+                return error(line, "invalid output value in cover row");
+            }
+            bool value = output_value == "1";
+            if (cover_planes.is_empty()) {
+                cover_value = value;
+            }
+            else if (value != cover_value) {
+                return error(line, "cover rows with different outputs");
+            }
+            cover_planes.append(plane);
+            continue;
+        }
+
+        finish_cover();
+        if (keyword == ".model") {
+            add_record(RecordType::Model, line);
+        }
+        else if (keyword == ".end" || keyword == ".exdc") {
+            /* Everything after the first model is ignored. */
+            add_record(RecordType::End, line);
+            return;
+        }
+        else if (keyword == ".inputs" || keyword == ".outputs") {
+            RecordType type = keyword == ".inputs" ? RecordType::Input :
+                                                     RecordType::Output;
+            for (StringRef name : tokens.as_ref().drop_front(1)) {
+                add_record(type, line);
+                chunk.records.append(get_local_net(chunk, name));
+            }
+        }
+        else if (keyword == ".names") {
+            if (tokens.size() < 2) {
+                return error(line, "missing output net");
+            }
+            cover_nets.clear();
+            for (StringRef name : tokens.as_ref().drop_front(1)) {
+                cover_nets.append(get_local_net(chunk, name));
+            }
+            cover_planes.clear();
+            cover_line = line;
+            is_in_cover = true;
+        }
+        else if (keyword == ".latch") {
+            /* The type, control net and initial value are optional. */
+            if (tokens.size() < 3 || tokens.size() > 6) {
+                return error(line, "wrong number of arguments for '.latch'");
+            }
+            uint32_t input = get_local_net(chunk, tokens[1]);
+            uint32_t output = get_local_net(chunk, tokens[2]);
+            add_gate_record(chunk, line, GateType::FlipFlop, {input}, output);
+        }
+        else if (!is_ignored_directive(keyword)) {
+            return error(line, "unsupported directive '" +
+                                   std::string(keyword) + "'");
+        }
+    }
+    finish_cover();
+}
+
+/**
+ * Split the text into chunks of roughly the given size, at the start of
+ * directives. Returns the start of every chunk and the end of the last one.
+ */
+static Vector<size_t> find_chunk_bounds(StringRef text, size_t chunk_size)
+{
+    Vector<size_t> bounds = {0};
+    for (size_t target = chunk_size; target < text.size();
+         target += chunk_size) {
+        size_t start = find_directive_start(text,
+                                            std::max(target, bounds.last()));
+        if (start >= text.size()) {
+            break;
+        }
+        if (start > bounds.last()) {
+            bounds.append(start);
+        }
+    }
+    bounds.append(text.size());
+    return bounds;
+}
+
+std::optional<Circuit> parse_blif(StringRef text,
+                                  std::string &r_error,
+                                  ThreadPool *thread_pool)
+{
+    Vector<size_t> bounds = find_chunk_bounds(
+        text, thread_pool == nullptr ? text.size() + 1 : CHUNK_SIZE);
+    Vector<BlifChunk> chunks(bounds.size() - 1);
+    for (size_t i : chunks.index_range()) {
+        chunks[i].text = text.substr(bounds[i], bounds[i + 1] - bounds[i]);
+    }
+    if (thread_pool != nullptr && chunks.size() > 1) {
+        thread_pool->parallel_for(
+            chunks.index_range(), 1, [&](IndexRange range) {
+                for (size_t i : range) {
+                    parse_chunk(chunks[i]);
+                }
+            });
+    }
+    else {
+        for (BlifChunk &chunk : chunks) {
+            parse_chunk(chunk);
+        }
+    }
+
+    /* Nets of the circuit are created in the order in which they are first
+     * used in the file. */
+    Circuit circuit;
+    StringMap<NetId> net_by_name;
+    Vector<NetId> chunk_nets;
+    Vector<NetId> inputs;
+    uint32_t line_offset = 0;
+    bool has_model = false;
+    for (const BlifChunk &chunk : chunks) {
+        chunk_nets.clear();
+        chunk_nets.append_n_times(NO_NET, chunk.local_net_names.size());
+        auto get_net = [&](uint32_t local_net) {
+            NetId &net = chunk_nets[local_net];
+            if (net != NO_NET) {
+                return net;
+            }
+            StringRef name = chunk.local_net_names[local_net];
+            if (name.size() == 0) {
+                net = circuit.add_net();
+                return net;
+            }
+            const NetId *existing_net = net_by_name.lookup_ptr(name);
+            if (existing_net != nullptr) {
+                net = *existing_net;
+            }
+            else {
+                net = circuit.add_net(name);
+                net_by_name.add_new(name, net);
+            }
+            return net;
+        };
+        auto error = [&](uint32_t line, const std::string &message) {
+            r_error = "line " + std::to_string(line_offset + line) + ": " +
+                      message;
+            return std::nullopt;
+        };
+
+        ArrayRef<uint32_t> records = chunk.records;
+        size_t i = 0;
+        while (i < records.size()) {
+            RecordType type = (RecordType)records[i];
+            uint32_t line = records[i + 1];
+            i += 2;
+            switch (type) {
+                case RecordType::Model: {
+                    /* Only the first model is used. */
+                    if (has_model) {
+                        return circuit;
+                    }
+                    has_model = true;
+                    break;
+                }
+                case RecordType::End: {
+                    return circuit;
+                }
+                case RecordType::Input: {
+                    NetId net = get_net(records[i++]);
+                    if (circuit.net_driver(net) != NO_GATE) {
+                        return error(line, "net '" + circuit.net_name(net) +
+                                               "' has more than one driver");
+                    }
+                    circuit.add_gate(GateType::Input, {}, net);
+                    break;
+                }
+                case RecordType::Output: {
+                    circuit.add_output(get_net(records[i++]));
+                    break;
+                }
+                case RecordType::Gate: {
+                    GateType gate_type = (GateType)records[i];
+                    NetId output = get_net(records[i + 1]);
+                    uint32_t input_amount = records[i + 2];
+                    i += 3;
+                    if (circuit.net_driver(output) != NO_GATE) {
+                        return error(line, "net '" +
+                                               circuit.net_name(output) +
+                                               "' has more than one driver");
+                    }
+                    inputs.clear();
+                    for (uint32_t local_net :
+                         records.slice(i, input_amount)) {
+                        inputs.append(get_net(local_net));
+                    }
+                    i += input_amount;
+                    circuit.add_gate(gate_type, inputs, output);
+                    break;
+                }
+            }
+        }
+        if (!chunk.error.empty()) {
+            return error(chunk.error_line, chunk.error);
+        }
+        line_offset += chunk.line_amount;
+    }
+    return circuit;
+}
+
+}  // namespace gate_sim
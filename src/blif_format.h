@@ -0,0 +1,46 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include "bas/string_ref.h"
+
+#include "circuit.h"
+#include "thread_pool.h"
+
+namespace gate_sim {
+
+using bas::StringRef;
+
+/**
+ * Parse the first model of a netlist in the Berkeley Logic Interchange
+ * Format, as written by synthesis tools:
+ *
+ *   .model top
+ *   .inputs a b
+ *   .outputs y
+ *   .names a b n1
+ *   11 1
+ *   .latch n1 q re clk 0
+ *   .names q y
+ *   0 1
+ *   .end
+ *
+ * Every .names cover becomes a few gates. Covers of the common gate types are
+ * recognized, all others are built as sum of products from not, and and or
+ * gates. Latches become flip-flops of the global clock, their type, control
+ * and initial value are ignored. Hierarchical models (.subckt) and mapped
+ * library gates (.gate) are not supported.
+ *
+ * Large files are split into chunks at the start of directives, which are
+ * parsed in parallel on the thread pool, if one is given. Net names are only
+ * resolved to nets of the circuit when the chunks are merged in order, so
+ * the resulting circuit does not depend on the chunks.
+ *
+ * Returns nothing and sets the error message when the text is invalid.
+ */
+std::optional<Circuit> parse_blif(StringRef text,
+                                  std::string &r_error,
+                                  ThreadPool *thread_pool = nullptr);
+
+}  // namespace gate_sim
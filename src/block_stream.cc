@@ -0,0 +1,66 @@
+#include "block_stream.h"
+
+namespace gate_sim {
+
+static constexpr size_t BLOCK_ALIGNMENT = 8;
+
+static size_t padding_size(size_t size)
+{
+    return (BLOCK_ALIGNMENT - size % BLOCK_ALIGNMENT) % BLOCK_ALIGNMENT;
+}
+
+std::unique_ptr<BlockWriter> BlockWriter::Open(const char *path,
+                                               std::string &r_error)
+{
+    std::FILE *file = std::fopen(path, "wb");
+    if (file == nullptr) {
+        r_error = "cannot create file";
+        return {};
+    }
+    return std::unique_ptr<BlockWriter>(new BlockWriter(file));
+}
+
+BlockWriter::~BlockWriter()
+{
+    if (m_file != nullptr) {
+        std::fclose(m_file);
+    }
+}
+
+void BlockWriter::write_bytes(const void *data, size_t size)
+{
+    assert(m_file != nullptr);
+    static constexpr char zeros[BLOCK_ALIGNMENT] = {0};
+    /* Large blocks are passed to the operating system directly by the
+     * buffered stream, so they are not copied. */
+    if (size > 0) {
+        std::fwrite(data, 1, size, m_file);
+    }
+    std::fwrite(zeros, 1, padding_size(size), m_file);
+}
+
+bool BlockWriter::close(std::string &r_error)
+{
+    bool has_error = std::ferror(m_file) != 0;
+    has_error |= std::fclose(m_file) != 0;
+    m_file = nullptr;
+    if (has_error) {
+        r_error = "cannot write file";
+        return false;
+    }
+    return true;
+}
+
+bool BlockReader::read_bytes(size_t size, const uint8_t *&r_data)
+{
+    size_t padded_size = size + padding_size(size);
+    if (size > this->remaining_size() ||
+        padded_size > this->remaining_size()) {
+        return false;
+    }
+    r_data = m_data.begin() + m_position;
+    m_position += padded_size;
+    return true;
+}
+
+}  // namespace gate_sim
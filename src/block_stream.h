@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include "bas/vector.h"
+
+namespace gate_sim {
+
+using bas::ArrayRef;
+using bas::size_t;
+using bas::uint64_t;
+using bas::uint8_t;
+using bas::Vector;
+
+/**
+ * Writes values and arrays of trivially copyable types to a binary file.
+ * Arrays are written as one block with their size in front instead of
+ * element by element, so that saving is limited by the disk and not by the
+ * number of elements.
+ *
+ * Every block is padded to a multiple of 8 bytes, so that arrays in a mapped
+ * file can be used in place by BlockReader::read_array_ref. Values are
+ * written in the byte order of the machine.
+ */
+class BlockWriter : bas::NonCopyable, bas::NonMovable {
+  private:
+    std::FILE *m_file;
+
+  public:
+    /**
+     * Returns null and sets the error message when the file cannot be
+     * created.
+     */
+    static std::unique_ptr<BlockWriter> Open(const char *path,
+                                             std::string &r_error);
+
+    ~BlockWriter();
+
+    template<typename T> void write(const T &value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        this->write_bytes(&value, sizeof(T));
+    }
+
+    template<typename T> void write_array(ArrayRef<T> values)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        this->write<uint64_t>(values.size());
+        this->write_bytes(values.begin(), values.size() * sizeof(T));
+    }
+
+    void write_bytes(const void *data, size_t size);
+
+    /**
+     * Returns false and sets the error message when anything could not be
+     * written. Nothing can be written afterwards.
+     */
+    bool close(std::string &r_error);
+
+  private:
+    BlockWriter(std::FILE *file) : m_file(file)
+    {
+    }
+};
+
+/**
+ * Reads what a BlockWriter has written from memory, usually a mapped file
+ * that starts at a multiple of 8 bytes. All functions return false when the
+ * data ends too early.
+ */
+class BlockReader {
+  private:
+    ArrayRef<uint8_t> m_data;
+    size_t m_position = 0;
+
+  public:
+    BlockReader(ArrayRef<uint8_t> data) : m_data(data)
+    {
+    }
+
+    template<typename T> bool read(T &r_value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const uint8_t *data;
+        if (!this->read_bytes(sizeof(T), data)) {
+            return false;
+        }
+        memcpy(&r_value, data, sizeof(T));
+        return true;
+    }
+
+    /**
+     * Replace the values with a copy of the next array. The memory is
+     * allocated once for the whole array.
+     */
+    template<typename T> bool read_array(Vector<T> &r_values)
+    {
+        ArrayRef<T> values;
+        if (!this->read_array_ref(values)) {
+            return false;
+        }
+        r_values.clear();
+        r_values.reserve(values.size());
+        if (values.size() > 0) {
+            memcpy(r_values.begin(),
+                   values.begin(),
+                   values.size() * sizeof(T));
+        }
+        r_values.increase_size_unchecked(values.size());
+        return true;
+    }
+
+    /**
+     * Get the next array without copying it. It points into the data.
+     */
+    template<typename T> bool read_array_ref(ArrayRef<T> &r_values)
+    {
+        static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= 8);
+        uint64_t size;
+        const uint8_t *data;
+        if (!this->read(size) || size > this->remaining_size() / sizeof(T) ||
+            !this->read_bytes(size * sizeof(T), data)) {
+            return false;
+        }
+        r_values = ArrayRef<T>((const T *)data, size);
+        return true;
+    }
+
+    bool read_bytes(size_t size, const uint8_t *&r_data);
+
+  private:
+    size_t remaining_size() const
+    {
+        return m_data.size() - m_position;
+    }
+};
+
+}  // namespace gate_sim
@@ -0,0 +1,127 @@
+#include "circuit.h"
+
+namespace gate_sim {
+
+const char *gate_type_name(GateType type)
+{
+    switch (type) {
+        case GateType::Input:
+            return "Input";
+        case GateType::Constant0:
+            return "0";
+        case GateType::Constant1:
+            return "1";
+        case GateType::Buffer:
+            return "Buffer";
+        case GateType::Not:
+            return "Not";
+        case GateType::And:
+            return "And";
+        case GateType::Nand:
+            return "Nand";
+        case GateType::Or:
+            return "Or";
+        case GateType::Nor:
+            return "Nor";
+        case GateType::Xor:
+            return "Xor";
+        case GateType::Xnor:
+            return "Xnor";
+        case GateType::Tristate:
+            return "Tristate";
+        case GateType::FlipFlop:
+            return "Flip Flop";
+    }
+    assert(false);
+    return "";
+}
+
+bool gate_type_supports_input_amount(GateType type, size_t amount)
+{
+    switch (type) {
+        case GateType::Input:
+        case GateType::Constant0:
+        case GateType::Constant1:
+            return amount == 0;
+        case GateType::Buffer:
+        case GateType::Not:
+        case GateType::FlipFlop:
+            return amount == 1;
+        case GateType::And:
+        case GateType::Nand:
+        case GateType::Or:
+        case GateType::Nor:
+        case GateType::Xor:
+        case GateType::Xnor:
+            return amount >= 1;
+        case GateType::Tristate:
+            return amount == 2;
+    }
+    assert(false);
+    return false;
+}
+
+NetId Circuit::add_net(std::string name)
+{
+    NetId net = (NetId)m_net_names.size();
+    m_net_names.append(std::move(name));
+    m_net_drivers.append(NO_GATE);
+    return net;
+}
+
+GateId Circuit::add_gate(GateType type, ArrayRef<NetId> inputs, NetId output)
+{
+    assert(gate_type_supports_input_amount(type, inputs.size()));
+    assert(m_net_drivers[output] == NO_GATE);
+#ifndef NDEBUG
+    for (NetId net : inputs) {
+        assert(net < this->net_amount());
+    }
+#endif
+
+    GateId gate = (GateId)m_gate_types.size();
+    m_gate_types.append(type);
+    m_gate_inputs.append(inputs);
+    m_gate_outputs.append(output);
+    m_net_drivers[output] = gate;
+    return gate;
+}
+
+void Circuit::add_output(NetId net)
+{
+    assert(net < this->net_amount());
+    m_output_nets.append_non_duplicates(net);
+}
+
+void Circuit::reserve(size_t gate_amount, size_t net_amount)
+{
+    m_gate_types.reserve(gate_amount);
+    m_gate_inputs.reserve(gate_amount);
+    m_gate_outputs.reserve(gate_amount);
+    m_net_names.reserve(net_amount);
+    m_net_drivers.reserve(net_amount);
+}
+
+Vector<NetId> Circuit::input_nets() const
+{
+    Vector<NetId> nets;
+    for (GateId gate : this->gates()) {
+        if (m_gate_types[gate] == GateType::Input) {
+            nets.append(m_gate_outputs[gate]);
+        }
+    }
+    return nets;
+}
+
+Vector<GateId> Circuit::flip_flops() const
+{
+    Vector<GateId> gates;
+    for (GateId gate : this->gates()) {
+        if (m_gate_types[gate] == GateType::FlipFlop) {
+            gates.append(gate);
+        }
+    }
+    return gates;
+}
+
+}  // namespace gate_sim
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <string>
+
+#include "bas/array_ref.h"
+#include "bas/index_range.h"
+#include "bas/vector.h"
+
+namespace gate_sim {
+
+using bas::ArrayRef;
+using bas::IndexRange;
+using bas::size_t;
+using bas::uint32_t;
+using bas::uint8_t;
+using bas::Vector;
+
+using GateId = uint32_t;
+using NetId = uint32_t;
+
+/* Used for nets that are not driven by any gate. */
+constexpr GateId NO_GATE = (GateId)-1;
+
+enum class GateType : uint8_t {
+    Input,
+    Constant0,
+    Constant1,
+    Buffer,
+    Not,
+    And,
+    Nand,
+    Or,
+    Nor,
+    Xor,
+    Xnor,
+    /* Drives the first input when the second input is one and leaves the
+     * output undriven otherwise. Two-valued simulators cannot represent an
+     * undriven net and output zero in that case. */
+    Tristate,
+    /* Stores its input at every rising edge of the global clock and outputs
+     * the stored value until the next edge. */
+    FlipFlop,
+};
+
+constexpr uint32_t GATE_TYPE_AMOUNT = (uint32_t)GateType::FlipFlop + 1;
+
+const char *gate_type_name(GateType type);
+
+/**
+ * Returns true when a gate of the given type can have the given number of
+ * inputs.
+ */
+bool gate_type_supports_input_amount(GateType type, size_t amount);
+
+/**
+ * A circuit is a set of gates that are connected by nets. Every gate drives
+ * exactly one net with its output pin and reads any number of nets with its
+ * input pins. A net has at most one driver. Nets without a driver are
+ * primary inputs when they are driven by an input gate and undriven
+ * otherwise.
+ *
+ * All flip-flops share a single global clock. All other gates are
+ * combinational, so the circuit is synchronous when every loop contains a
+ * flip-flop.
+ *
+ * This is the editable representation of a circuit. Simulators copy the
+ * parts they need into their own compact data structures.
+ */
+class Circuit {
+  private:
+    Vector<GateType> m_gate_types;
+    Vector<Vector<NetId>> m_gate_inputs;
+    Vector<NetId> m_gate_outputs;
+
+    Vector<std::string> m_net_names;
+    Vector<GateId> m_net_drivers;
+
+    Vector<NetId> m_output_nets;
+
+  public:
+    /**
+     * Create a new net that is not connected to any gate yet.
+     */
+    NetId add_net(std::string name = "");
+
+    /**
+     * Create a new gate that reads the given input nets and drives the output
+     * net. The output net must not have a driver yet.
+     */
+    GateId add_gate(GateType type, ArrayRef<NetId> inputs, NetId output);
+
+    /**
+     * Mark a net as primary output of the circuit.
+     */
+    void add_output(NetId net);
+
+    /**
+     * Allocate memory for the given total numbers of gates and nets, when
+     * they are known before the circuit is built.
+     */
+    void reserve(size_t gate_amount, size_t net_amount);
+
+    size_t gate_amount() const
+    {
+        return m_gate_types.size();
+    }
+
+    size_t net_amount() const
+    {
+        return m_net_names.size();
+    }
+
+    IndexRange gates() const
+    {
+        return IndexRange(this->gate_amount());
+    }
+
+    IndexRange nets() const
+    {
+        return IndexRange(this->net_amount());
+    }
+
+    GateType gate_type(GateId gate) const
+    {
+        return m_gate_types[gate];
+    }
+
+    ArrayRef<GateType> gate_types() const
+    {
+        return m_gate_types;
+    }
+
+    ArrayRef<NetId> gate_inputs(GateId gate) const
+    {
+        return m_gate_inputs[gate];
+    }
+
+    NetId gate_output(GateId gate) const
+    {
+        return m_gate_outputs[gate];
+    }
+
+    ArrayRef<NetId> gate_outputs() const
+    {
+        return m_gate_outputs;
+    }
+
+    /**
+     * Get the gate that drives the net or NO_GATE when it is undriven.
+     */
+    GateId net_driver(NetId net) const
+    {
+        return m_net_drivers[net];
+    }
+
+    const std::string &net_name(NetId net) const
+    {
+        return m_net_names[net];
+    }
+
+    ArrayRef<NetId> output_nets() const
+    {
+        return m_output_nets;
+    }
+
+    /**
+     * Get the output nets of all input gates, in the order the gates have
+     * been added.
+     */
+    Vector<NetId> input_nets() const;
+
+    /**
+     * Get all flip-flop gates, in the order they have been added.
+     */
+    Vector<GateId> flip_flops() const;
+};
+
+}  // namespace gate_sim
@@ -0,0 +1,312 @@
+#include <cstring>
+
+#include "circuit_image.h"
+#include "netlist.h"
+
+namespace gate_sim {
+
+static constexpr char MAGIC[8] = {'G', 'S', 'C', 'I', 'R', 'C', '0', '1'};
+
+enum class Section : uint32_t {
+    GateTypes,
+    GateInputStarts,
+    GateInputNets,
+    GateOutputs,
+    FanoutStarts,
+    FanoutGates,
+    NetDrivers,
+    NameStarts,
+    NameChars,
+    OutputNets,
+};
+
+static constexpr uint32_t SECTION_AMOUNT = (uint32_t)Section::OutputNets + 1;
+
+struct SectionRange {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct ImageHeader {
+    char magic[8];
+    uint32_t gate_amount;
+    uint32_t net_amount;
+    uint32_t output_amount;
+    /* Allows detecting files of other versions that have more sections. */
+    uint32_t section_amount;
+    SectionRange sections[SECTION_AMOUNT];
+};
+
+std::unique_ptr<CircuitImage> CircuitImage::Open(const char *path,
+                                                 std::string &r_error)
+{
+    std::unique_ptr<MappedFile> file = MappedFile::Open(path, r_error);
+    if (!file) {
+        return {};
+    }
+    ArrayRef<uint8_t> data = file->data();
+    if (data.size() < sizeof(ImageHeader) ||
+        memcmp(data.begin(), MAGIC, sizeof(MAGIC)) != 0) {
+        r_error = "not a circuit image";
+        return {};
+    }
+    ImageHeader header;
+    memcpy(&header, data.begin(), sizeof(ImageHeader));
+    if (header.section_amount != SECTION_AMOUNT) {
+        r_error = "unsupported circuit image version";
+        return {};
+    }
+    for (const SectionRange &section : header.sections) {
+        if (section.offset % 8 != 0 || section.offset > data.size() ||
+            section.size > data.size() - section.offset) {
+            r_error = "sections are out of bounds";
+            return {};
+        }
+    }
+
+    /* The mapping starts at a page boundary, so all sections are aligned. */
+    auto section_data = [&](Section section) {
+        return data.begin() + header.sections[(uint32_t)section].offset;
+    };
+    auto has_size = [&](Section section, uint64_t size) {
+        return header.sections[(uint32_t)section].size == size;
+    };
+    uint64_t gate_amount = header.gate_amount;
+    uint64_t net_amount = header.net_amount;
+    if (!has_size(Section::GateTypes, gate_amount) ||
+        !has_size(Section::GateInputStarts, (gate_amount + 1) * 4) ||
+        !has_size(Section::GateOutputs, gate_amount * 4) ||
+        !has_size(Section::FanoutStarts, (net_amount + 1) * 4) ||
+        !has_size(Section::NetDrivers, net_amount * 4) ||
+        !has_size(Section::NameStarts, (net_amount + 1) * 8) ||
+        !has_size(Section::OutputNets, header.output_amount * 4)) {
+        r_error = "invalid section sizes";
+        return {};
+    }
+
+    std::unique_ptr<CircuitImage> image(new CircuitImage(std::move(file)));
+    image->m_gate_amount = header.gate_amount;
+    image->m_net_amount = header.net_amount;
+    image->m_gate_types = (const GateType *)section_data(Section::GateTypes);
+    image->m_gate_input_starts = (const uint32_t *)section_data(
+        Section::GateInputStarts);
+    image->m_gate_input_nets = (const NetId *)section_data(
+        Section::GateInputNets);
+    image->m_gate_outputs = (const NetId *)section_data(Section::GateOutputs);
+    image->m_fanout_starts = (const uint32_t *)section_data(
+        Section::FanoutStarts);
+    image->m_fanout_gates = (const GateId *)section_data(
+        Section::FanoutGates);
+    image->m_net_drivers = (const GateId *)section_data(Section::NetDrivers);
+    image->m_name_starts = (const uint64_t *)section_data(
+        Section::NameStarts);
+    image->m_name_chars = (const char *)section_data(Section::NameChars);
+    image->m_output_nets = ArrayRef<NetId>(
+        (const NetId *)section_data(Section::OutputNets),
+        header.output_amount);
+
+    /* The sizes of the remaining sections are given by the last start of
+     * the arrays that index into them. */
+    if (image->m_gate_input_starts[0] != 0 ||
+        !has_size(Section::GateInputNets,
+                  (uint64_t)image->m_gate_input_starts[gate_amount] * 4) ||
+        image->m_fanout_starts[0] != 0 ||
+        !has_size(Section::FanoutGates,
+                  (uint64_t)image->m_fanout_starts[net_amount] * 4) ||
+        image->m_name_starts[0] != 0 ||
+        !has_size(Section::NameChars, image->m_name_starts[net_amount])) {
+        r_error = "invalid section sizes";
+        return {};
+    }
+    return image;
+}
+
+std::optional<Circuit> CircuitImage::to_circuit(std::string &r_error) const
+{
+    CircuitArrays arrays;
+    arrays.gate_types = ArrayRef<GateType>(m_gate_types, m_gate_amount);
+    arrays.gate_input_starts = ArrayRef<uint32_t>(m_gate_input_starts,
+                                                  m_gate_amount + 1);
+    arrays.gate_input_nets = ArrayRef<NetId>(
+        m_gate_input_nets, m_gate_input_starts[m_gate_amount]);
+    arrays.gate_outputs = ArrayRef<NetId>(m_gate_outputs, m_gate_amount);
+    arrays.name_starts = ArrayRef<uint64_t>(m_name_starts, m_net_amount + 1);
+    arrays.name_chars = ArrayRef<char>(m_name_chars,
+                                       m_name_starts[m_net_amount]);
+    arrays.output_nets = m_output_nets;
+    std::optional<Circuit> circuit = circuit_from_arrays(arrays, r_error);
+    if (!circuit) {
+        return std::nullopt;
+    }
+
+    /* The drivers and the fanout are only used in place, but they still have
+     * to match the circuit. */
+    auto error = [&](const std::string &message) {
+        r_error = message;
+        return std::nullopt;
+    };
+    for (NetId net : this->nets()) {
+        if (m_net_drivers[net] != circuit->net_driver(net)) {
+            return error("invalid driver of net " + std::to_string(net));
+        }
+        if (m_fanout_starts[net + 1] < m_fanout_starts[net]) {
+            return error("invalid fanout of net " + std::to_string(net));
+        }
+        for (GateId gate : this->net_fanout(net)) {
+            if (gate >= m_gate_amount) {
+                return error("invalid fanout of net " + std::to_string(net));
+            }
+        }
+    }
+    return circuit;
+}
+
+std::optional<Circuit> circuit_from_arrays(const CircuitArrays &arrays,
+                                           std::string &r_error)
+{
+    auto error = [&](const std::string &message) {
+        r_error = message;
+        return std::nullopt;
+    };
+
+    size_t gate_amount = arrays.gate_types.size();
+    if (arrays.gate_input_starts.size() != gate_amount + 1 ||
+        arrays.gate_outputs.size() != gate_amount ||
+        arrays.name_starts.size() == 0) {
+        return error("invalid circuit");
+    }
+    size_t net_amount = arrays.name_starts.size() - 1;
+
+    Circuit circuit;
+    circuit.reserve(gate_amount, net_amount);
+    for (NetId net : IndexRange(net_amount)) {
+        uint64_t start = arrays.name_starts[net];
+        uint64_t end = arrays.name_starts[net + 1];
+        if (start > end || end > arrays.name_chars.size()) {
+            return error("invalid name of net " + std::to_string(net));
+        }
+        circuit.add_net(std::string(arrays.name_chars.begin() + start,
+                                    end - start));
+    }
+    for (GateId gate : IndexRange(gate_amount)) {
+        GateType type = arrays.gate_types[gate];
+        uint32_t start = arrays.gate_input_starts[gate];
+        uint32_t end = arrays.gate_input_starts[gate + 1];
+        NetId output = arrays.gate_outputs[gate];
+        if ((uint32_t)type >= GATE_TYPE_AMOUNT || start > end ||
+            end > arrays.gate_input_nets.size() ||
+            !gate_type_supports_input_amount(type, end - start) ||
+            output >= net_amount || circuit.net_driver(output) != NO_GATE) {
+            return error("invalid gate " + std::to_string(gate));
+        }
+        ArrayRef<NetId> inputs = arrays.gate_input_nets.slice(start,
+                                                              end - start);
+        for (NetId net : inputs) {
+            if (net >= net_amount) {
+                return error("invalid gate " + std::to_string(gate));
+            }
+        }
+        circuit.add_gate(type, inputs, output);
+    }
+    for (NetId net : arrays.output_nets) {
+        if (net >= net_amount) {
+            return error("invalid output net " + std::to_string(net));
+        }
+        circuit.add_output(net);
+    }
+    return circuit;
+}
+
+FlatCircuit::FlatCircuit(const Circuit &circuit) : m_circuit(circuit)
+{
+    m_gate_input_starts.reserve(circuit.gate_amount() + 1);
+    uint32_t input_amount = 0;
+    for (GateId gate : circuit.gates()) {
+        m_gate_input_starts.append_unchecked(input_amount);
+        input_amount += (uint32_t)circuit.gate_inputs(gate).size();
+    }
+    m_gate_input_starts.append_unchecked(input_amount);
+    m_gate_input_nets.reserve(input_amount);
+    for (GateId gate : circuit.gates()) {
+        m_gate_input_nets.extend_unchecked(circuit.gate_inputs(gate));
+    }
+
+    m_name_starts.reserve(circuit.net_amount() + 1);
+    for (NetId net : circuit.nets()) {
+        m_name_starts.append_unchecked(m_name_chars.size());
+        m_name_chars += circuit.net_name(net);
+    }
+    m_name_starts.append_unchecked(m_name_chars.size());
+}
+
+CircuitArrays FlatCircuit::arrays() const
+{
+    CircuitArrays arrays;
+    arrays.gate_types = m_circuit.gate_types();
+    arrays.gate_input_starts = m_gate_input_starts;
+    arrays.gate_input_nets = m_gate_input_nets;
+    arrays.gate_outputs = m_circuit.gate_outputs();
+    arrays.name_starts = m_name_starts;
+    arrays.name_chars = ArrayRef<char>(m_name_chars.data(),
+                                       m_name_chars.size());
+    arrays.output_nets = m_circuit.output_nets();
+    return arrays;
+}
+
+/**
+ * Append the array at the next multiple of 8 bytes and remember where it is.
+ */
+template<typename T>
+static void append_section(std::string &r_data,
+                           SectionRange &r_section,
+                           ArrayRef<T> values)
+{
+    r_data.resize((r_data.size() + 7) / 8 * 8, '\0');
+    r_section.offset = r_data.size();
+    r_section.size = values.size() * sizeof(T);
+    if (values.size() > 0) {
+        r_data.append((const char *)values.begin(), r_section.size);
+    }
+}
+
+std::string write_circuit_image(const Circuit &circuit)
+{
+    FlatCircuit flat_circuit(circuit);
+    CircuitArrays arrays = flat_circuit.arrays();
+    /* Only used for the fanout. */
+    Netlist netlist = Netlist::FromCircuit(circuit);
+
+    ImageHeader header;
+    memset(&header, 0, sizeof(ImageHeader));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.gate_amount = (uint32_t)circuit.gate_amount();
+    header.net_amount = (uint32_t)circuit.net_amount();
+    header.output_amount = (uint32_t)circuit.output_nets().size();
+    header.section_amount = SECTION_AMOUNT;
+
+    Vector<GateId> net_drivers;
+    net_drivers.reserve(circuit.net_amount());
+    for (NetId net : circuit.nets()) {
+        net_drivers.append(circuit.net_driver(net));
+    }
+
+    /* The header is written last, when the offsets are known. */
+    std::string data(sizeof(ImageHeader), '\0');
+    auto append = [&](Section section, auto values) {
+        append_section(data, header.sections[(uint32_t)section], values);
+    };
+    append(Section::GateTypes, arrays.gate_types);
+    append(Section::GateInputStarts, arrays.gate_input_starts);
+    append(Section::GateInputNets, arrays.gate_input_nets);
+    append(Section::GateOutputs, arrays.gate_outputs);
+    append(Section::FanoutStarts, netlist.fanout_starts());
+    append(Section::FanoutGates, netlist.fanout_gates());
+    append(Section::NetDrivers, net_drivers.as_ref());
+    append(Section::NameStarts, arrays.name_starts);
+    append(Section::NameChars, arrays.name_chars);
+    append(Section::OutputNets, arrays.output_nets);
+    memcpy(&data[0], &header, sizeof(ImageHeader));
+    return data;
+}
+
+}  // namespace gate_sim
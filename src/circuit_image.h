@@ -0,0 +1,189 @@
+#pragma once
+
+#include <optional>
+
+#include "bas/string_ref.h"
+
+#include "circuit.h"
+#include "mapped_file.h"
+
+namespace gate_sim {
+
+using bas::StringRef;
+using bas::uint64_t;
+
+/**
+ * The arrays that describe a circuit in files. The inputs of all gates and
+ * the names of all nets are stored in compressed sparse row format, the
+ * names follow each other without separator. The arrays either point into a
+ * file or into a FlatCircuit.
+ */
+struct CircuitArrays {
+    ArrayRef<GateType> gate_types;
+    /* One more than gates, the last start is the end of the inputs. */
+    ArrayRef<uint32_t> gate_input_starts;
+    ArrayRef<NetId> gate_input_nets;
+    ArrayRef<NetId> gate_outputs;
+    /* One more than nets. 64 bit, because all names of very large circuits
+     * can be longer than 4 GiB. */
+    ArrayRef<uint64_t> name_starts;
+    ArrayRef<char> name_chars;
+    ArrayRef<NetId> output_nets;
+};
+
+/**
+ * Check all indices of the arrays and build the circuit. Returns nothing and
+ * sets the error message when the arrays are inconsistent.
+ */
+std::optional<Circuit> circuit_from_arrays(const CircuitArrays &arrays,
+                                           std::string &r_error);
+
+/**
+ * Builds the arrays of a circuit that are not stored in one piece by the
+ * circuit itself, so that it can be written without a copy per gate or net.
+ * The circuit must not change while the arrays are used.
+ */
+class FlatCircuit : bas::NonCopyable, bas::NonMovable {
+  private:
+    const Circuit &m_circuit;
+    Vector<uint32_t> m_gate_input_starts;
+    Vector<NetId> m_gate_input_nets;
+    Vector<uint64_t> m_name_starts;
+    std::string m_name_chars;
+
+  public:
+    FlatCircuit(const Circuit &circuit);
+
+    CircuitArrays arrays() const;
+};
+
+/**
+ * A circuit in a binary file that is used directly from memory, so that
+ * even very large circuits open without parsing, allocating or hashing names.
+ * Processes that open the same file share its pages.
+ *
+ * The file holds the arrays of the Netlist in compressed sparse row format,
+ * the driver of every net, the output nets and the net names. Every section
+ * is an array in the byte order of the machine that starts at an offset which
+ * is a multiple of 8, so it can be used in place. The header contains
+ * "GSCIRC01", the numbers of gates, nets and outputs and the offset and size
+ * of every section.
+ *
+ * Only the header is validated when the file is opened, so that the arrays are
+ * not read until they are used. The accessors expect a file that has been
+ * written by write_circuit_image, #to_circuit checks all indices.
+ */
+class CircuitImage {
+  private:
+    std::unique_ptr<MappedFile> m_file;
+    uint32_t m_gate_amount;
+    uint32_t m_net_amount;
+
+    const GateType *m_gate_types;
+    const uint32_t *m_gate_input_starts;
+    const NetId *m_gate_input_nets;
+    const NetId *m_gate_outputs;
+    const uint32_t *m_fanout_starts;
+    const GateId *m_fanout_gates;
+    const GateId *m_net_drivers;
+    /* The names of all nets follow each other without separator. */
+    const uint64_t *m_name_starts;
+    const char *m_name_chars;
+    ArrayRef<NetId> m_output_nets;
+
+  public:
+    /**
+     * Returns null and sets the error message when the file cannot be
+     * mapped or its header is invalid.
+     */
+    static std::unique_ptr<CircuitImage> Open(const char *path,
+                                              std::string &r_error);
+
+    size_t gate_amount() const
+    {
+        return m_gate_amount;
+    }
+
+    size_t net_amount() const
+    {
+        return m_net_amount;
+    }
+
+    IndexRange gates() const
+    {
+        return IndexRange(m_gate_amount);
+    }
+
+    IndexRange nets() const
+    {
+        return IndexRange(m_net_amount);
+    }
+
+    GateType gate_type(GateId gate) const
+    {
+        assert(gate < m_gate_amount);
+        return m_gate_types[gate];
+    }
+
+    ArrayRef<NetId> gate_inputs(GateId gate) const
+    {
+        assert(gate < m_gate_amount);
+        uint32_t start = m_gate_input_starts[gate];
+        uint32_t end = m_gate_input_starts[gate + 1];
+        return ArrayRef<NetId>(m_gate_input_nets + start, end - start);
+    }
+
+    NetId gate_output(GateId gate) const
+    {
+        assert(gate < m_gate_amount);
+        return m_gate_outputs[gate];
+    }
+
+    /**
+     * Gates that read the net, except for flip-flops, like in the Netlist.
+     */
+    ArrayRef<GateId> net_fanout(NetId net) const
+    {
+        assert(net < m_net_amount);
+        uint32_t start = m_fanout_starts[net];
+        uint32_t end = m_fanout_starts[net + 1];
+        return ArrayRef<GateId>(m_fanout_gates + start, end - start);
+    }
+
+    GateId net_driver(NetId net) const
+    {
+        assert(net < m_net_amount);
+        return m_net_drivers[net];
+    }
+
+    StringRef net_name(NetId net) const
+    {
+        assert(net < m_net_amount);
+        uint64_t start = m_name_starts[net];
+        return StringRef(m_name_chars + start,
+                         m_name_starts[net + 1] - start);
+    }
+
+    ArrayRef<NetId> output_nets() const
+    {
+        return m_output_nets;
+    }
+
+    /**
+     * Copy the image into an editable circuit for the simulators. Returns
+     * nothing and sets the error message when the arrays are inconsistent.
+     */
+    std::optional<Circuit> to_circuit(std::string &r_error) const;
+
+  private:
+    CircuitImage(std::unique_ptr<MappedFile> file) : m_file(std::move(file))
+    {
+    }
+};
+
+/**
+ * Store the circuit in the format that is read by CircuitImage.
+ */
+std::string write_circuit_image(const Circuit &circuit);
+
+}  // namespace gate_sim
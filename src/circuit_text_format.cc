@@ -0,0 +1,126 @@
+#include "bas/map.h"
+
+#include "circuit_text_format.h"
+
+namespace gate_sim {
+
+using bas::Map;
+using bas::ssize_t;
+
+static bool is_whitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static void split_tokens(StringRef line, Vector<StringRef> &r_tokens)
+{
+    r_tokens.clear();
+    size_t i = 0;
+    while (i < line.size()) {
+        if (is_whitespace(line[i])) {
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < line.size() && !is_whitespace(line[i])) {
+            i++;
+        }
+        r_tokens.append(line.substr(start, i - start));
+    }
+}
+
+static bool gate_type_from_keyword(StringRef keyword, GateType &r_type)
+{
+    static const std::pair<const char *, GateType> keywords[] = {
+        {"input", GateType::Input},
+        {"const0", GateType::Constant0},
+        {"const1", GateType::Constant1},
+        {"buf", GateType::Buffer},
+        {"not", GateType::Not},
+        {"and", GateType::And},
+        {"nand", GateType::Nand},
+        {"or", GateType::Or},
+        {"nor", GateType::Nor},
+        {"xor", GateType::Xor},
+        {"xnor", GateType::Xnor},
+        {"tristate", GateType::Tristate},
+        {"dff", GateType::FlipFlop},
+    };
+    for (const auto &item : keywords) {
+        if (keyword == item.first) {
+            r_type = item.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<Circuit> parse_circuit_text(StringRef text,
+                                          std::string &r_error)
+{
+    Circuit circuit;
+    Map<std::string, NetId> net_by_name;
+    auto get_net = [&](StringRef name) {
+        return net_by_name.lookup_or_add(
+            name, [&]() { return circuit.add_net(name); });
+    };
+
+    Vector<StringRef> tokens;
+    Vector<NetId> inputs;
+    size_t line_start = 0;
+    for (size_t line_number = 1; line_start < text.size(); line_number++) {
+        size_t line_end = line_start;
+        while (line_end < text.size() && text[line_end] != '\n') {
+            line_end++;
+        }
+        StringRef line = text.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+
+        ssize_t comment_start = line.try_first_index_of('#');
+        if (comment_start >= 0) {
+            line = line.substr(0, (size_t)comment_start);
+        }
+        split_tokens(line, tokens);
+        if (tokens.is_empty()) {
+            continue;
+        }
+
+        auto error = [&](const std::string &message) {
+            r_error = "line " + std::to_string(line_number) + ": " + message;
+            return std::nullopt;
+        };
+
+        if (tokens[0] == "output") {
+            for (StringRef name : tokens.as_ref().drop_front(1)) {
+                circuit.add_output(get_net(name));
+            }
+            continue;
+        }
+
+        GateType type;
+        if (!gate_type_from_keyword(tokens[0], type)) {
+            return error("unknown gate type '" + std::string(tokens[0]) +
+                         "'");
+        }
+        if (tokens.size() < 2) {
+            return error("missing output net");
+        }
+        NetId output = get_net(tokens[1]);
+        if (circuit.net_driver(output) != NO_GATE) {
+            return error("net '" + std::string(tokens[1]) +
+                         "' has more than one driver");
+        }
+        inputs.clear();
+        for (StringRef name : tokens.as_ref().drop_front(2)) {
+            inputs.append(get_net(name));
+        }
+        if (!gate_type_supports_input_amount(type, inputs.size())) {
+            return error("wrong number of inputs for '" +
+                         std::string(tokens[0]) + "'");
+        }
+        circuit.add_gate(type, inputs, output);
+    }
+    return circuit;
+}
+
+}  // namespace gate_sim
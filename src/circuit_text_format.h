@@ -0,0 +1,36 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include "bas/string_ref.h"
+
+#include "circuit.h"
+
+namespace gate_sim {
+
+using bas::StringRef;
+
+/**
+ * Parse a circuit from a simple line based text format. Every line describes
+ * one gate by its type, the name of its output net and the names of its input
+ * nets, separated by whitespace:
+ *
+ *   input a
+ *   input b
+ *   and n1 a b
+ *   not n2 n1
+ *   dff q n2
+ *   output n2
+ *
+ * The gate types are input, const0, const1, buf, not, and, nand, or, nor,
+ * xor, xnor, tristate (data, enable) and dff. Lines starting with output
+ * mark nets as primary outputs. Nets can be used before the line that drives
+ * them, which is necessary for loops. Everything after a '#' is a comment.
+ *
+ * Returns nothing and sets the error message when the text is invalid.
+ */
+std::optional<Circuit> parse_circuit_text(StringRef text,
+                                          std::string &r_error);
+
+}  // namespace gate_sim
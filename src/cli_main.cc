@@ -0,0 +1,528 @@
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "bas/map.h"
+
+#include "aiger_format.h"
+#include "bench_format.h"
+#include "binary_stimulus.h"
+#include "blif_format.h"
+#include "circuit_image.h"
+#include "circuit_text_format.h"
+#include "fault_simulator.h"
+#include "mapped_file.h"
+#include "simulator.h"
+#include "toggle_coverage.h"
+#include "vcd_writer.h"
+#include "verilog_format.h"
+
+/**
+ * Headless command line front end. It loads a circuit, applies stimulus,
+ * simulates a number of cycles as fast as possible and writes the values of
+ * the output nets. It does not depend on a window system, so that it can run
+ * in environments without a display.
+ */
+
+using namespace gate_sim;
+
+static bool read_file(const char *path, std::string &r_content)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    r_content = stream.str();
+    return true;
+}
+
+/**
+ * Name of the simulator type on the command line, e.g. "parallel-levelized".
+ */
+static std::string simulator_cli_name(SimulatorType type)
+{
+    std::string name = simulator_type_name(type);
+    for (char &c : name) {
+        c = c == ' ' ? '-' : (char)tolower(c);
+    }
+    return name;
+}
+
+static bool simulator_type_from_name(const char *name, SimulatorType &r_type)
+{
+    for (uint32_t i = 0; i < SIMULATOR_TYPE_AMOUNT; i++) {
+        if (simulator_cli_name((SimulatorType)i) == name) {
+            r_type = (SimulatorType)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void print_usage()
+{
+    std::cerr
+        << "Usage: gate_sim_cli <circuit> [options]\n"
+        << "\n"
+        << "Circuits are read from .blif, binary .aig, ISCAS .bench,\n"
+        << "structural Verilog .v and circuit image .gsc files or the\n"
+        << "text format.\n"
+        << "\n"
+        << "Options:\n"
+        << "  --stimulus <file>    One line per cycle with a 0 or 1 for\n"
+        << "                       every input in declaration order.\n"
+        << "  --binary-stimulus <file>\n"
+        << "                       Stream 64 lane words per input and\n"
+        << "                       cycle from a binary stimulus file.\n"
+        << "  --random <seed>      Random values in all lanes instead.\n"
+        << "  --cycles <n>         Number of cycles (default: stimulus\n"
+        << "                       lines, or 1).\n"
+        << "  --simulator <name>   One of:";
+    for (uint32_t i = 0; i < SIMULATOR_TYPE_AMOUNT; i++) {
+        std::cerr << " " << simulator_cli_name((SimulatorType)i);
+    }
+    std::cerr << "\n"
+              << "  --output <file>      Write output values to the file\n"
+              << "                       instead of stdout.\n"
+              << "  --quiet              Do not write output values.\n"
+              << "  --vcd <file>         Write a waveform of the output\n"
+              << "                       nets in lane 0.\n"
+              << "  --vcd-nets <names>   Comma separated nets for the\n"
+              << "                       waveform instead of the outputs.\n"
+              << "  --toggle-coverage    Report how often every net\n"
+              << "                       toggled.\n"
+              << "  --fault-grade        Report the stuck-at faults that\n"
+              << "                       the simulated lanes detect.\n"
+              << "  --write-aiger <file> Write the circuit as and-inverter\n"
+              << "                       graph in the binary AIGER format.\n"
+              << "  --write-image <file> Write the circuit as image that\n"
+              << "                       opens without parsing.\n";
+}
+
+/**
+ * Name of the net for reports, nets without name are printed as "#<id>".
+ */
+static std::string net_report_name(const Circuit &circuit, NetId net)
+{
+    const std::string &name = circuit.net_name(net);
+    return name.empty() ? "#" + std::to_string(net) : name;
+}
+
+static void print_toggle_coverage(const ToggleCoverage &coverage,
+                                  const Circuit &circuit)
+{
+    ToggleSummary summary = coverage.summarize(
+        (uint32_t)circuit.net_amount(), (uint32_t)circuit.net_amount());
+    double percent = summary.net_amount == 0 ?
+                         100.0 :
+                         100.0 * summary.covered_net_amount /
+                             summary.net_amount;
+    std::cerr << "Toggle coverage: " << summary.covered_net_amount << "/"
+              << summary.net_amount << " nets (" << percent << "%), "
+              << summary.toggle_amount << " toggles in "
+              << summary.cycle_amount << " cycles\n";
+    std::cerr << "Nets by toggle amount:\n";
+    for (size_t bucket : summary.histogram.index_range()) {
+        if (summary.histogram[bucket] == 0) {
+            continue;
+        }
+        if (bucket == 0) {
+            std::cerr << "  0";
+        }
+        else {
+            std::cerr << "  " << ((uint64_t)1 << (bucket - 1)) << "-"
+                      << ((uint64_t)1 << bucket) - 1;
+        }
+        std::cerr << ": " << summary.histogram[bucket] << "\n";
+    }
+    if (!summary.never_toggled_nets.is_empty()) {
+        std::cerr << "Never toggled:";
+        for (NetId net : summary.never_toggled_nets) {
+            std::cerr << " " << net_report_name(circuit, net);
+        }
+        std::cerr << "\n";
+    }
+}
+
+static void print_fault_coverage(const FaultSimulator &fault_simulator,
+                                 const Circuit &circuit)
+{
+    ArrayRef<StuckAtFault> faults = fault_simulator.faults();
+    std::cerr << "Fault coverage: " << fault_simulator.detected_fault_amount()
+              << "/" << faults.size() << " stuck-at faults ("
+              << 100.0 * fault_simulator.fault_coverage() << "%)\n";
+    if (fault_simulator.detected_fault_amount() < faults.size()) {
+        std::cerr << "Undetected:";
+        for (uint32_t fault : faults.index_range()) {
+            if (!fault_simulator.is_detected(fault)) {
+                std::cerr << " " << net_report_name(circuit, faults[fault].net)
+                          << "/" << (faults[fault].value ? 1 : 0);
+            }
+        }
+        std::cerr << "\n";
+    }
+}
+
+/**
+ * Look up the nets in a comma separated list of names.
+ */
+static bool find_nets_by_name(const Circuit &circuit,
+                              const char *names,
+                              Vector<NetId> &r_nets)
+{
+    bas::Map<std::string, NetId> net_by_name;
+    for (NetId net : IndexRange(circuit.net_amount())) {
+        if (!circuit.net_name(net).empty()) {
+            net_by_name.add(circuit.net_name(net), net);
+        }
+    }
+    std::stringstream stream(names);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        const NetId *net = net_by_name.lookup_ptr(name);
+        if (net == nullptr) {
+            std::cerr << "Unknown net: " << name << "\n";
+            return false;
+        }
+        r_nets.append(*net);
+    }
+    return true;
+}
+
+static uint64_t random_word(uint64_t &r_state)
+{
+    /* splitmix64 */
+    uint64_t z = (r_state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+int main(int argc, char **argv)
+{
+    const char *circuit_path = nullptr;
+    const char *stimulus_path = nullptr;
+    const char *binary_stimulus_path = nullptr;
+    const char *output_path = nullptr;
+    const char *vcd_path = nullptr;
+    const char *vcd_net_names = nullptr;
+    const char *aiger_path = nullptr;
+    const char *image_path = nullptr;
+    SimulatorType simulator_type = SimulatorType::Levelized;
+    uint64_t cycle_amount = 0;
+    bool use_random = false;
+    uint64_t random_state = 0;
+    bool quiet = false;
+    bool count_toggles = false;
+    bool grade_faults = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (strcmp(arg, "--stimulus") == 0 && has_value) {
+            stimulus_path = argv[++i];
+        }
+        else if (strcmp(arg, "--binary-stimulus") == 0 && has_value) {
+            binary_stimulus_path = argv[++i];
+        }
+        else if (strcmp(arg, "--random") == 0 && has_value) {
+            use_random = true;
+            random_state = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(arg, "--cycles") == 0 && has_value) {
+            cycle_amount = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(arg, "--simulator") == 0 && has_value) {
+            if (!simulator_type_from_name(argv[++i], simulator_type)) {
+                std::cerr << "Unknown simulator: " << argv[i] << "\n";
+                return 1;
+            }
+        }
+        else if (strcmp(arg, "--output") == 0 && has_value) {
+            output_path = argv[++i];
+        }
+        else if (strcmp(arg, "--vcd") == 0 && has_value) {
+            vcd_path = argv[++i];
+        }
+        else if (strcmp(arg, "--vcd-nets") == 0 && has_value) {
+            vcd_net_names = argv[++i];
+        }
+        else if (strcmp(arg, "--write-aiger") == 0 && has_value) {
+            aiger_path = argv[++i];
+        }
+        else if (strcmp(arg, "--write-image") == 0 && has_value) {
+            image_path = argv[++i];
+        }
+        else if (strcmp(arg, "--quiet") == 0) {
+            quiet = true;
+        }
+        else if (strcmp(arg, "--toggle-coverage") == 0) {
+            count_toggles = true;
+        }
+        else if (strcmp(arg, "--fault-grade") == 0) {
+            grade_faults = true;
+        }
+        else if (arg[0] != '-' && circuit_path == nullptr) {
+            circuit_path = arg;
+        }
+        else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (circuit_path == nullptr) {
+        print_usage();
+        return 1;
+    }
+
+    std::string error;
+    std::optional<Circuit> circuit;
+    bool is_blif = StringRef(circuit_path).endswith(".blif");
+    bool is_aiger = StringRef(circuit_path).endswith(".aig");
+    bool is_verilog = StringRef(circuit_path).endswith(".v");
+    bool is_bench = StringRef(circuit_path).endswith(".bench");
+    if (StringRef(circuit_path).endswith(".gsc")) {
+        std::unique_ptr<CircuitImage> image = CircuitImage::Open(circuit_path,
+                                                                 error);
+        if (image) {
+            circuit = image->to_circuit(error);
+        }
+    }
+    else if (is_blif || is_aiger || is_verilog || is_bench) {
+        /* Netlists can be very large, so they are parsed in place. */
+        std::unique_ptr<MappedFile> file = MappedFile::Open(circuit_path,
+                                                            error);
+        if (!file) {
+            std::cerr << circuit_path << ": " << error << "\n";
+            return 1;
+        }
+        StringRef text((const char *)file->data().begin(), file->size());
+        if (is_blif) {
+            circuit = parse_blif(text, error, &get_thread_pool());
+        }
+        else if (is_verilog) {
+            circuit = parse_verilog(text, error);
+        }
+        else if (is_bench) {
+            circuit = parse_bench(text, error);
+        }
+        else {
+            std::optional<AndInverterGraph> graph = parse_aiger(file->data(),
+                                                                error);
+            if (graph) {
+                circuit = graph->to_circuit();
+            }
+        }
+    }
+    else {
+        std::string circuit_text;
+        if (!read_file(circuit_path, circuit_text)) {
+            std::cerr << "Cannot read " << circuit_path << "\n";
+            return 1;
+        }
+        circuit = parse_circuit_text(circuit_text, error);
+    }
+    if (!circuit) {
+        std::cerr << circuit_path << ": " << error << "\n";
+        return 1;
+    }
+    if (aiger_path != nullptr) {
+        Vector<AigLiteral> net_literals;
+        AndInverterGraph graph = AndInverterGraph::FromCircuit(*circuit,
+                                                               net_literals);
+        if (graph.feedback_amount() > 0) {
+            std::cerr << aiger_path
+                      << ": combinational loops cannot be written\n";
+            return 1;
+        }
+        std::string data = write_aiger(graph);
+        std::ofstream aiger_file(aiger_path, std::ios::binary);
+        if (!aiger_file.write(data.data(), (std::streamsize)data.size())) {
+            std::cerr << "Cannot write " << aiger_path << "\n";
+            return 1;
+        }
+    }
+    if (image_path != nullptr) {
+        std::string data = write_circuit_image(*circuit);
+        std::ofstream image_file(image_path, std::ios::binary);
+        if (!image_file.write(data.data(), (std::streamsize)data.size())) {
+            std::cerr << "Cannot write " << image_path << "\n";
+            return 1;
+        }
+    }
+    Vector<NetId> input_nets = circuit->input_nets();
+    ArrayRef<NetId> output_nets = circuit->output_nets();
+
+    /* Every stimulus line holds the values of one cycle. */
+    Vector<std::string> stimulus_lines;
+    if (stimulus_path != nullptr) {
+        std::string stimulus_text;
+        if (!read_file(stimulus_path, stimulus_text)) {
+            std::cerr << "Cannot read " << stimulus_path << "\n";
+            return 1;
+        }
+        std::stringstream stream(stimulus_text);
+        std::string line;
+        while (std::getline(stream, line)) {
+            std::string values;
+            for (char c : line) {
+                if (c == '0' || c == '1') {
+                    values.push_back(c);
+                }
+            }
+            if (values.empty()) {
+                continue;
+            }
+            if (values.size() != input_nets.size()) {
+                std::cerr << stimulus_path << ": expected "
+                          << input_nets.size() << " values per line\n";
+                return 1;
+            }
+            stimulus_lines.append(values);
+        }
+    }
+    std::unique_ptr<BinaryStimulus> binary_stimulus;
+    if (binary_stimulus_path != nullptr) {
+        binary_stimulus = BinaryStimulus::Open(
+            binary_stimulus_path, (uint32_t)input_nets.size(), error);
+        if (!binary_stimulus) {
+            std::cerr << binary_stimulus_path << ": " << error << "\n";
+            return 1;
+        }
+        if (binary_stimulus->cycle_amount() == 0) {
+            std::cerr << binary_stimulus_path << ": no cycles\n";
+            return 1;
+        }
+    }
+    if (cycle_amount == 0) {
+        if (binary_stimulus) {
+            cycle_amount = binary_stimulus->cycle_amount();
+        }
+        else {
+            cycle_amount = stimulus_lines.is_empty() ? 1 :
+                                                       stimulus_lines.size();
+        }
+    }
+
+    std::ofstream output_file;
+    if (output_path != nullptr) {
+        output_file.open(output_path);
+        if (!output_file) {
+            std::cerr << "Cannot write " << output_path << "\n";
+            return 1;
+        }
+    }
+    std::ostream &output = output_path != nullptr ? output_file : std::cout;
+
+    std::unique_ptr<Simulator> simulator = create_simulator(simulator_type,
+                                                            *circuit);
+    std::unique_ptr<VcdWriter> vcd_writer;
+    if (vcd_path != nullptr) {
+        Vector<NetId> vcd_nets;
+        if (vcd_net_names == nullptr) {
+            vcd_nets.extend(output_nets);
+        }
+        else if (!find_nets_by_name(*circuit, vcd_net_names, vcd_nets)) {
+            return 1;
+        }
+        vcd_writer = VcdWriter::Open(vcd_path, *circuit, vcd_nets, error);
+        if (!vcd_writer) {
+            std::cerr << vcd_path << ": " << error << "\n";
+            return 1;
+        }
+    }
+
+    std::unique_ptr<ToggleCoverage> coverage;
+    if (count_toggles) {
+        coverage = std::make_unique<ToggleCoverage>(*simulator);
+    }
+
+    /* Every cycle grades the values of all lanes as one block of patterns.
+     * Flip-flops are set like in a scan test, to the state that the
+     * simulation reached in that cycle. */
+    std::unique_ptr<FaultSimulator> fault_simulator;
+    Vector<uint64_t> pattern_words;
+    if (grade_faults) {
+        fault_simulator = std::make_unique<FaultSimulator>(*circuit,
+                                                           &get_thread_pool());
+        pattern_words = Vector<uint64_t>(
+            fault_simulator->pattern_nets().size(), 0);
+    }
+
+    std::string output_line(output_nets.size() + 1, '\n');
+    auto start_time = std::chrono::steady_clock::now();
+    for (uint64_t cycle = 0; cycle < cycle_amount; cycle++) {
+        if (cycle > 0) {
+            simulator->clock();
+        }
+        if (use_random) {
+            for (NetId net : input_nets) {
+                simulator->set_net_lanes(net, random_word(random_state));
+            }
+        }
+        else if (binary_stimulus) {
+            /* The last cycle is held like for text stimulus. */
+            uint64_t stimulus_cycle = std::min(
+                cycle, binary_stimulus->cycle_amount() - 1);
+            ArrayRef<uint64_t> words = binary_stimulus->cycle_inputs(
+                stimulus_cycle);
+            for (size_t i : input_nets.index_range()) {
+                simulator->set_net_lanes(input_nets[i], words[i]);
+            }
+            binary_stimulus->release_before(stimulus_cycle);
+        }
+        else if (!stimulus_lines.is_empty()) {
+            /* The last line is held when there are more cycles than lines. */
+            const std::string &values = stimulus_lines[std::min<uint64_t>(
+                cycle, stimulus_lines.size() - 1)];
+            for (size_t i : input_nets.index_range()) {
+                simulator->set_net(input_nets[i], values[i] == '1');
+            }
+        }
+        simulator->simulate();
+        if (coverage) {
+            coverage->count_cycle();
+        }
+        if (fault_simulator) {
+            ArrayRef<NetId> pattern_nets = fault_simulator->pattern_nets();
+            for (size_t i : pattern_nets.index_range()) {
+                pattern_words[i] = simulator->get_net_lanes(pattern_nets[i]);
+            }
+            fault_simulator->simulate_patterns(pattern_words);
+        }
+        if (vcd_writer) {
+            vcd_writer->record_cycle(cycle, *simulator);
+        }
+
+        if (!quiet) {
+            for (size_t i : output_nets.index_range()) {
+                output_line[i] = logic4_char(
+                    simulator->get_net_logic(output_nets[i]));
+            }
+            output << output_line;
+        }
+    }
+    output.flush();
+    std::chrono::duration<double> duration =
+        std::chrono::steady_clock::now() - start_time;
+
+    std::cerr << "Simulated " << cycle_amount << " cycles in "
+              << duration.count() << " s ("
+              << (double)cycle_amount / duration.count() << " cycles/s)\n";
+    if (coverage) {
+        print_toggle_coverage(*coverage, *circuit);
+    }
+    if (fault_simulator) {
+        print_fault_coverage(*fault_simulator, *circuit);
+    }
+    if (simulator->has_oscillation()) {
+        std::cerr << "Warning: a combinational loop oscillates\n";
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include "combinational_loops.h"
+#include "strongly_connected_components.h"
+
+namespace gate_sim {
+
+CombinationalLoops CombinationalLoops::FromNetlist(const Netlist &netlist)
+{
+    uint32_t gate_amount = (uint32_t)netlist.gate_amount();
+    Vector<GateId> gates;
+    gates.reserve(gate_amount);
+    for (GateId gate = 0; gate < gate_amount; gate++) {
+        gates.append(gate);
+    }
+
+    /* Flip-flops are not in the fanout, so they break loops. */
+    auto readers = [&](uint32_t gate) {
+        return netlist.net_fanout(netlist.gate_output(gate));
+    };
+    StronglyConnectedComponents components = StronglyConnectedComponents::Find(
+        gate_amount, gates, readers);
+
+    CombinationalLoops loops;
+    for (size_t i = 0; i < components.component_amount(); i++) {
+        if (!components.is_cycle(i, readers)) {
+            continue;
+        }
+        uint32_t loop = (uint32_t)loops.m_loops.size();
+        loops.m_loops.append(components.component(i));
+        for (GateId gate : components.component(i)) {
+            loops.m_loop_by_gate.add_new(gate, loop);
+        }
+    }
+    return loops;
+}
+
+LoopEvaluationCounter::LoopEvaluationCounter(const CombinationalLoops &loops,
+                                             size_t gate_amount)
+    : m_gate_loops(gate_amount, NO_LOOP),
+      m_max_evaluations(loops.loop_amount()),
+      m_evaluation_amounts(loops.loop_amount(), 0)
+{
+    for (uint32_t loop = 0; loop < loops.loop_amount(); loop++) {
+        ArrayRef<GateId> gates = loops.loop_gates(loop);
+        m_max_evaluations[loop] = MAX_LOOP_ITERATIONS * (uint32_t)gates.size();
+        for (GateId gate : gates) {
+            m_gate_loops[gate] = loop;
+        }
+    }
+}
+
+}  // namespace gate_sim
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "bas/map.h"
+
+#include "netlist.h"
+#include "simulator.h"
+
+namespace gate_sim {
+
+using bas::Map;
+
+constexpr uint32_t NO_LOOP = (uint32_t)-1;
+
+/**
+ * Groups of gates that form feedback loops without a flip-flop in between.
+ * Every group is a strongly connected component of the gate graph. The
+ * analysis is done once when a simulator is created, so that simulators do
+ * not have to check for loops while simulating.
+ */
+class CombinationalLoops {
+  private:
+    Vector<Vector<GateId>> m_loops;
+    /* Only contains the gates that are part of a loop, which are usually
+     * few. */
+    Map<GateId, uint32_t> m_loop_by_gate;
+
+  public:
+    static CombinationalLoops FromNetlist(const Netlist &netlist);
+
+    size_t loop_amount() const
+    {
+        return m_loops.size();
+    }
+
+    ArrayRef<GateId> loop_gates(uint32_t loop) const
+    {
+        return m_loops[loop];
+    }
+
+    /**
+     * Get the loop that contains the gate or NO_LOOP.
+     */
+    uint32_t loop_of_gate(GateId gate) const
+    {
+        return m_loop_by_gate.lookup_default(gate, NO_LOOP);
+    }
+};
+
+/**
+ * Counts how often the gates of every loop are evaluated, for simulators
+ * that follow changes from gate to gate. When a loop exceeds its budget, the
+ * simulator stops and reports an oscillation instead of running forever.
+ */
+class LoopEvaluationCounter {
+  private:
+    /* Dense copy of the loop of every gate for fast lookups. */
+    Vector<uint32_t> m_gate_loops;
+    Vector<uint32_t> m_max_evaluations;
+    Vector<uint32_t> m_evaluation_amounts;
+    bool m_is_exceeded = false;
+
+  public:
+    LoopEvaluationCounter(const CombinationalLoops &loops, size_t gate_amount);
+
+    void reset()
+    {
+        m_evaluation_amounts.fill(0);
+        m_is_exceeded = false;
+    }
+
+    void count(GateId gate)
+    {
+        uint32_t loop = m_gate_loops[gate];
+        if (loop != NO_LOOP) {
+            m_evaluation_amounts[loop]++;
+            if (m_evaluation_amounts[loop] > m_max_evaluations[loop]) {
+                m_is_exceeded = true;
+            }
+        }
+    }
+
+    /**
+     * True when any loop has been evaluated more often than allowed since
+     * the last reset.
+     */
+    bool is_exceeded() const
+    {
+        return m_is_exceeded;
+    }
+};
+
+}  // namespace gate_sim
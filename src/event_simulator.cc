@@ -0,0 +1,100 @@
+#include "event_simulator.h"
+
+namespace gate_sim {
+
+EventSimulator::EventSimulator(const Circuit &circuit)
+    : m_netlist(Netlist::FromCircuit(circuit)),
+      m_loop_counter(CombinationalLoops::FromNetlist(m_netlist),
+                     circuit.gate_amount())
+{
+    m_net_values = Vector<uint64_t>(circuit.net_amount(), 0);
+    m_gate_is_scheduled = Vector<bool>(circuit.gate_amount(), false);
+
+    m_flip_flops = circuit.flip_flops();
+    m_next_flip_flop_values = Vector<uint64_t>(m_flip_flops.size(), 0);
+
+    /* Evaluate every gate once, so that gates whose output is not zero when
+     * all inputs are zero get the correct initial value. */
+    for (GateId gate : circuit.gates()) {
+        this->schedule_gate(gate);
+    }
+    this->simulate();
+}
+
+void EventSimulator::set_net_lanes(NetId net, uint64_t lanes)
+{
+    m_pending_changes.append({net, lanes});
+}
+
+void EventSimulator::simulate()
+{
+    m_last_evaluation_amount = 0;
+    m_loop_counter.reset();
+
+    while (!m_pending_changes.is_empty() || !m_scheduled_gates.is_empty()) {
+        if (m_loop_counter.is_exceeded()) {
+            break;
+        }
+        for (NetChange change : m_pending_changes) {
+            if (m_net_values[change.net] == change.lanes) {
+                continue;
+            }
+            m_net_values[change.net] = change.lanes;
+            for (GateId gate : m_netlist.net_fanout(change.net)) {
+                this->schedule_gate(gate);
+            }
+        }
+        m_pending_changes.clear();
+
+        for (GateId gate : m_scheduled_gates) {
+            m_gate_is_scheduled[gate] = false;
+            m_loop_counter.count(gate);
+            NetId output = m_netlist.gate_output(gate);
+            uint64_t lanes = m_netlist.evaluate_gate(gate, m_net_values);
+            if (lanes != m_net_values[output]) {
+                m_pending_changes.append({output, lanes});
+            }
+        }
+        m_last_evaluation_amount += m_scheduled_gates.size();
+        m_scheduled_gates.clear();
+    }
+}
+
+void EventSimulator::clock()
+{
+    /* Read all inputs before changing any output. */
+    for (size_t i : m_flip_flops.index_range()) {
+        NetId input = m_netlist.gate_inputs(m_flip_flops[i])[0];
+        m_next_flip_flop_values[i] = m_net_values[input];
+    }
+    for (size_t i : m_flip_flops.index_range()) {
+        m_pending_changes.append(
+            {m_netlist.gate_output(m_flip_flops[i]),
+             m_next_flip_flop_values[i]});
+    }
+}
+
+void EventSimulator::read_state(MutableArrayRef<uint64_t> r_words) const
+{
+    r_words.copy_from(m_net_values);
+}
+
+void EventSimulator::write_state(ArrayRef<uint64_t> words)
+{
+    m_net_values.as_mutable_ref().copy_from(words);
+    m_pending_changes.clear();
+    for (GateId gate : m_scheduled_gates) {
+        m_gate_is_scheduled[gate] = false;
+    }
+    m_scheduled_gates.clear();
+}
+
+void EventSimulator::schedule_gate(GateId gate)
+{
+    if (!m_gate_is_scheduled[gate]) {
+        m_gate_is_scheduled[gate] = true;
+        m_scheduled_gates.append(gate);
+    }
+}
+
+}  // namespace gate_sim
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "combinational_loops.h"
+#include "netlist.h"
+#include "simulator.h"
+
+namespace gate_sim {
+
+/**
+ * Simulates a circuit by only evaluating gates whose inputs changed.
+ *
+ * Changes to nets are collected in a queue. Processing the queue updates the
+ * net values and schedules all gates that read a changed net. Every scheduled
+ * gate is evaluated once per round and its output change (if any) goes into
+ * the queue for the next round. This continues until no net changes anymore.
+ *
+ * The cost of a simulation step is proportional to the number of gates that
+ * are affected by a change, not to the size of the circuit. A gate is
+ * evaluated when its inputs changed in any lane.
+ *
+ * A clock edge turns every flip-flop whose stored value changes into a net
+ * change in the queue.
+ *
+ * Combinational loops are found when the simulator is created. When the
+ * gates of a loop are evaluated too often, simulate returns early and the
+ * remaining changes are processed by the next call.
+ */
+class EventSimulator : public Simulator {
+  private:
+    struct NetChange {
+        NetId net;
+        uint64_t lanes;
+    };
+
+    Netlist m_netlist;
+    Vector<uint64_t> m_net_values;
+
+    Vector<GateId> m_flip_flops;
+    /* Values that the flip-flops store at a clock edge. */
+    Vector<uint64_t> m_next_flip_flop_values;
+
+    Vector<NetChange> m_pending_changes;
+    Vector<GateId> m_scheduled_gates;
+    Vector<bool> m_gate_is_scheduled;
+
+    LoopEvaluationCounter m_loop_counter;
+
+    size_t m_last_evaluation_amount = 0;
+
+  public:
+    EventSimulator(const Circuit &circuit);
+
+    void set_net_lanes(NetId net, uint64_t lanes) override;
+
+    uint64_t get_net_lanes(NetId net) const override
+    {
+        return m_net_values[net];
+    }
+
+    /**
+     * Propagate all pending changes until the circuit is stable or a loop
+     * oscillates.
+     */
+    void simulate() override;
+
+    void clock() override;
+
+    bool has_oscillation() const override
+    {
+        return m_loop_counter.is_exceeded();
+    }
+
+    size_t state_word_amount() const override
+    {
+        return m_net_values.size();
+    }
+
+    void read_state(MutableArrayRef<uint64_t> r_words) const override;
+    void write_state(ArrayRef<uint64_t> words) override;
+
+    ArrayRef<uint64_t> value_words() const override
+    {
+        return m_net_values;
+    }
+
+    size_t net_value_word_index(NetId net) const override
+    {
+        return net;
+    }
+
+    uint32_t net_value_word_amount() const override
+    {
+        return 1;
+    }
+
+    /**
+     * Number of gate evaluations that were done in the last call to simulate.
+     */
+    size_t last_evaluation_amount() const
+    {
+        return m_last_evaluation_amount;
+    }
+
+  private:
+    void schedule_gate(GateId gate);
+};
+
+}  // namespace gate_sim
@@ -0,0 +1,353 @@
+#include "fault_simulator.h"
+
+namespace gate_sim {
+
+/* Fewer faults are simulated on the calling thread. */
+static constexpr size_t MIN_PARALLEL_FAULT_AMOUNT = 256;
+static constexpr size_t MIN_CHUNK_SIZE = 64;
+
+/**
+ * Memory that is needed to propagate a single fault. A chunk of faults
+ * claims one that no other thread uses, so that threads do not share any
+ * mutable data.
+ */
+struct FaultSimulator::Scratch {
+    /* Values of the faulty circuit. Only the changed nets differ from the
+     * fault free circuit, and they are reset after every fault. */
+    Vector<uint64_t> values;
+    Vector<NetId> changed_nets;
+    Vector<Vector<GateId>> level_queues;
+    Vector<bool> gate_is_scheduled;
+    std::atomic<bool> is_used{false};
+
+    Scratch(ArrayRef<uint64_t> good_values,
+            uint32_t level_amount,
+            size_t gate_amount)
+        : values(good_values),
+          level_queues(level_amount),
+          gate_is_scheduled(gate_amount, false)
+    {
+    }
+};
+
+FaultSimulator::FaultSimulator(const Circuit &circuit,
+                               ThreadPool *thread_pool)
+    : m_netlist(Netlist::FromCircuit(circuit)), m_thread_pool(thread_pool)
+{
+    Vector<GateId> flip_flops = circuit.flip_flops();
+
+    m_pattern_nets = circuit.input_nets();
+    for (GateId gate : flip_flops) {
+        m_pattern_nets.append(circuit.gate_output(gate));
+    }
+
+    m_net_is_observed = Vector<bool>(circuit.net_amount(), false);
+    for (NetId net : circuit.output_nets()) {
+        m_net_is_observed[net] = true;
+    }
+    for (GateId gate : flip_flops) {
+        m_net_is_observed[circuit.gate_inputs(gate)[0]] = true;
+    }
+
+    for (NetId net : circuit.nets()) {
+        if (circuit.net_driver(net) != NO_GATE) {
+            m_faults.append({net, false});
+            m_faults.append({net, true});
+        }
+    }
+    m_fault_is_detected = Vector<bool>(m_faults.size(), false);
+    m_remaining_faults.reserve(m_faults.size());
+    for (uint32_t fault : m_faults.index_range()) {
+        m_remaining_faults.append(fault);
+    }
+
+    /* Kahn's algorithm on the gates. Inputs and flip-flops are sources and
+     * are not part of the order. */
+    auto is_source = [&](GateId gate) {
+        GateType type = circuit.gate_type(gate);
+        return type == GateType::Input || type == GateType::FlipFlop;
+    };
+    Vector<uint32_t> dependency_amounts(circuit.gate_amount(), 0);
+    for (GateId gate : circuit.gates()) {
+        if (is_source(gate)) {
+            continue;
+        }
+        for (NetId net : circuit.gate_inputs(gate)) {
+            GateId driver = circuit.net_driver(net);
+            if (driver != NO_GATE && !is_source(driver)) {
+                dependency_amounts[gate]++;
+            }
+        }
+    }
+    m_gate_levels = Vector<uint32_t>(circuit.gate_amount(), 0);
+    for (GateId gate : circuit.gates()) {
+        if (!is_source(gate) && dependency_amounts[gate] == 0) {
+            m_gate_order.append(gate);
+        }
+    }
+    for (size_t i = 0; i < m_gate_order.size(); i++) {
+        GateId gate = m_gate_order[i];
+        m_level_amount = std::max(m_level_amount, m_gate_levels[gate] + 1);
+        for (GateId reader :
+             m_netlist.net_fanout(circuit.gate_output(gate))) {
+            m_gate_levels[reader] = std::max(m_gate_levels[reader],
+                                             m_gate_levels[gate] + 1);
+            dependency_amounts[reader]--;
+            if (dependency_amounts[reader] == 0) {
+                m_gate_order.append(reader);
+            }
+        }
+    }
+    /* Gates in or behind combinational loops go into an extra level at the
+     * end. */
+    for (GateId gate : circuit.gates()) {
+        if (dependency_amounts[gate] > 0) {
+            m_gate_order.append(gate);
+            m_gate_levels[gate] = m_level_amount;
+            m_cyclic_gate_amount++;
+        }
+    }
+    if (m_cyclic_gate_amount > 0) {
+        m_level_amount++;
+    }
+
+    m_good_values = Vector<uint64_t>(circuit.net_amount(), 0);
+    m_previous_cyclic_values = Vector<uint64_t>(m_cyclic_gate_amount, 0);
+}
+
+FaultSimulator::~FaultSimulator() = default;
+
+float FaultSimulator::fault_coverage() const
+{
+    if (m_faults.is_empty()) {
+        return 1.0f;
+    }
+    return (float)this->detected_fault_amount() / (float)m_faults.size();
+}
+
+size_t FaultSimulator::simulate_patterns(ArrayRef<uint64_t> pattern_words,
+                                         uint64_t lane_mask)
+{
+    assert(pattern_words.size() == m_pattern_nets.size());
+    this->simulate_good_circuit(pattern_words);
+
+    /* The scratch values only have to follow the nets that changed, instead
+     * of copying all values for every pattern block. */
+    for (std::unique_ptr<Scratch> &scratch : m_scratches) {
+        for (NetId net : m_changed_good_nets) {
+            scratch->values[net] = m_good_values[net];
+        }
+    }
+
+    size_t fault_amount = m_remaining_faults.size();
+    bool is_parallel = m_thread_pool != nullptr &&
+                       m_thread_pool->thread_amount() > 1 &&
+                       fault_amount >= MIN_PARALLEL_FAULT_AMOUNT;
+    size_t scratch_amount = is_parallel ? m_thread_pool->thread_amount() : 1;
+    while (m_scratches.size() < scratch_amount) {
+        m_scratches.append(std::make_unique<Scratch>(
+            m_good_values, m_level_amount, m_netlist.gate_amount()));
+    }
+
+    auto simulate_faults = [&](IndexRange range) {
+        Scratch &scratch = this->claim_scratch();
+        for (size_t i : range) {
+            uint32_t fault = m_remaining_faults[i];
+            if (this->detects_fault(m_faults[fault], lane_mask, scratch)) {
+                m_fault_is_detected[fault] = true;
+            }
+        }
+        scratch.is_used.store(false);
+    };
+
+    if (is_parallel) {
+        size_t grain_size = std::max(
+            fault_amount / (m_thread_pool->thread_amount() * 8),
+            MIN_CHUNK_SIZE);
+        m_thread_pool->parallel_for(
+            IndexRange(fault_amount), grain_size, simulate_faults);
+    }
+    else {
+        simulate_faults(IndexRange(fault_amount));
+    }
+
+    /* Fault dropping. */
+    Vector<uint32_t> remaining_faults;
+    for (uint32_t fault : m_remaining_faults) {
+        if (!m_fault_is_detected[fault]) {
+            remaining_faults.append(fault);
+        }
+    }
+    m_remaining_faults = std::move(remaining_faults);
+    return fault_amount - m_remaining_faults.size();
+}
+
+FaultSimulator::Scratch &FaultSimulator::claim_scratch()
+{
+    /* There is one scratch per thread and every thread processes one chunk
+     * at a time, so a free one is always found. */
+    while (true) {
+        for (std::unique_ptr<Scratch> &scratch : m_scratches) {
+            if (!scratch->is_used.exchange(true)) {
+                return *scratch;
+            }
+        }
+    }
+}
+
+void FaultSimulator::simulate_good_circuit(ArrayRef<uint64_t> pattern_words)
+{
+    m_changed_good_nets.clear();
+    auto set_value = [&](NetId net, uint64_t lanes) {
+        if (m_good_values[net] != lanes) {
+            m_good_values[net] = lanes;
+            m_changed_good_nets.append(net);
+        }
+    };
+    for (size_t i : m_pattern_nets.index_range()) {
+        set_value(m_pattern_nets[i], pattern_words[i]);
+    }
+    size_t acyclic_gate_amount = m_gate_order.size() - m_cyclic_gate_amount;
+    for (GateId gate : m_gate_order.as_ref().take_front(acyclic_gate_amount)) {
+        set_value(m_netlist.gate_output(gate),
+                  m_netlist.evaluate_gate(gate, m_good_values));
+    }
+    /* Like the other engines, loops keep the values of the last pattern
+     * block until they settle. */
+    ArrayRef<GateId> cyclic_gates = m_gate_order.as_ref().take_back(
+        m_cyclic_gate_amount);
+    for (size_t i : cyclic_gates.index_range()) {
+        m_previous_cyclic_values[i] =
+            m_good_values[m_netlist.gate_output(cyclic_gates[i])];
+    }
+    for (uint32_t iteration = 0; iteration < MAX_LOOP_ITERATIONS;
+         iteration++) {
+        size_t old_changed_amount = m_changed_good_nets.size();
+        for (GateId gate : cyclic_gates) {
+            set_value(m_netlist.gate_output(gate),
+                      m_netlist.evaluate_gate(gate, m_good_values));
+        }
+        if (m_changed_good_nets.size() == old_changed_amount) {
+            break;
+        }
+    }
+}
+
+bool FaultSimulator::detects_fault(const StuckAtFault &fault,
+                                   uint64_t lane_mask,
+                                   Scratch &scratch) const
+{
+    uint64_t stuck_lanes = fault.value ? ALL_LANES : 0;
+    if (((m_good_values[fault.net] ^ stuck_lanes) & lane_mask) == 0) {
+        /* The patterns do not activate the fault. */
+        return false;
+    }
+    if (m_net_is_observed[fault.net]) {
+        return true;
+    }
+
+    uint32_t min_level = m_level_amount;
+    uint32_t max_level = 0;
+    auto schedule_fanout = [&](NetId net) {
+        for (GateId gate : m_netlist.net_fanout(net)) {
+            if (!scratch.gate_is_scheduled[gate]) {
+                scratch.gate_is_scheduled[gate] = true;
+                uint32_t level = m_gate_levels[gate];
+                scratch.level_queues[level].append(gate);
+                min_level = std::min(min_level, level);
+                max_level = std::max(max_level, level);
+            }
+        }
+    };
+
+    scratch.values[fault.net] = stuck_lanes;
+    scratch.changed_nets.append(fault.net);
+    schedule_fanout(fault.net);
+
+    auto differs = [&](NetId net) {
+        return ((scratch.values[net] ^ m_good_values[net]) & lane_mask) != 0;
+    };
+
+    /* Gates in or behind loops can schedule gates of their own level again,
+     * so their values are only final when the level settles. */
+    uint32_t cyclic_level = m_cyclic_gate_amount > 0 ? m_level_amount - 1 :
+                                                       m_level_amount;
+    size_t max_cyclic_evaluations = MAX_LOOP_ITERATIONS *
+                                    m_cyclic_gate_amount;
+
+    bool is_detected = false;
+    bool has_oscillation = false;
+    for (uint32_t level = min_level; level <= max_level && !is_detected;
+         level++) {
+        bool is_cyclic = level == cyclic_level;
+        /* The queue can grow while it is processed, so it is indexed. The
+         * queues are cleared below. */
+        Vector<GateId> &queue = scratch.level_queues[level];
+        if (is_cyclic) {
+            /* Settle all loops again, starting from their values before the
+             * pattern block. */
+            ArrayRef<GateId> cyclic_gates = m_gate_order.as_ref().take_back(
+                m_cyclic_gate_amount);
+            for (size_t i : cyclic_gates.index_range()) {
+                GateId gate = cyclic_gates[i];
+                NetId output = m_netlist.gate_output(gate);
+                if (output != fault.net) {
+                    scratch.values[output] = m_previous_cyclic_values[i];
+                    scratch.changed_nets.append(output);
+                }
+                if (!scratch.gate_is_scheduled[gate]) {
+                    scratch.gate_is_scheduled[gate] = true;
+                    queue.append(gate);
+                }
+            }
+        }
+        for (size_t i = 0; i < queue.size(); i++) {
+            if (is_cyclic && i == max_cyclic_evaluations) {
+                /* The fault makes a loop oscillate, so the observed values
+                 * are not defined. */
+                has_oscillation = true;
+                break;
+            }
+            GateId gate = queue[i];
+            scratch.gate_is_scheduled[gate] = false;
+            NetId output = m_netlist.gate_output(gate);
+            if (output == fault.net) {
+                continue;
+            }
+            uint64_t lanes = m_netlist.evaluate_gate(gate, scratch.values);
+            if (lanes == scratch.values[output]) {
+                continue;
+            }
+            scratch.values[output] = lanes;
+            scratch.changed_nets.append(output);
+            if (!is_cyclic && m_net_is_observed[output] && differs(output)) {
+                is_detected = true;
+                break;
+            }
+            schedule_fanout(output);
+        }
+        if (is_cyclic && !has_oscillation) {
+            for (NetId net : scratch.changed_nets) {
+                if (m_net_is_observed[net] && differs(net)) {
+                    is_detected = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    /* Reset the scratch memory for the next fault. */
+    for (uint32_t level = min_level; level <= max_level; level++) {
+        for (GateId gate : scratch.level_queues[level]) {
+            scratch.gate_is_scheduled[gate] = false;
+        }
+        scratch.level_queues[level].clear();
+    }
+    for (NetId net : scratch.changed_nets) {
+        scratch.values[net] = m_good_values[net];
+    }
+    scratch.changed_nets.clear();
+    return is_detected;
+}
+
+}  // namespace gate_sim
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "netlist.h"
+#include "simulator.h"
+#include "thread_pool.h"
+
+namespace gate_sim {
+
+/**
+ * A net that always has the same value, independent of its driver.
+ */
+struct StuckAtFault {
+    NetId net;
+    bool value;
+};
+
+/**
+ * Grades a set of test patterns by finding the stuck-at faults that they
+ * detect (parallel pattern single fault propagation).
+ *
+ * Every lane holds a different pattern. The fault free circuit is simulated
+ * once for 64 patterns. Then every fault is injected separately and only the
+ * gates in its fanout cone are evaluated again, in topological order, until
+ * the difference to the fault free circuit disappears or reaches an
+ * observed net. A fault is detected when an observed net differs in any
+ * lane. Detected faults are dropped, so later patterns only have to be
+ * simulated for the remaining faults. Faults are independent of each other,
+ * so they are distributed over the threads of the thread pool.
+ *
+ * Flip-flops are treated as if they are part of a scan chain: their outputs
+ * are set by the patterns like primary inputs and their inputs are observed
+ * like primary outputs.
+ *
+ * There are two faults on every net that is driven by a gate or is a pattern
+ * net. Faults on the individual branches of a net with multiple readers are
+ * not modeled. Gates in or behind combinational loops form an extra last
+ * level that is evaluated until it settles, at most MAX_LOOP_ITERATIONS
+ * times per gate. Faults that make it oscillate count as undetected.
+ */
+class FaultSimulator {
+  private:
+    Netlist m_netlist;
+    /* Gates that compute a value from other nets, in topological order.
+     * The gates in or behind combinational loops are at the end. */
+    Vector<GateId> m_gate_order;
+    size_t m_cyclic_gate_amount = 0;
+    Vector<uint32_t> m_gate_levels;
+    uint32_t m_level_amount = 0;
+
+    Vector<NetId> m_pattern_nets;
+    Vector<bool> m_net_is_observed;
+
+    Vector<StuckAtFault> m_faults;
+    Vector<bool> m_fault_is_detected;
+    Vector<uint32_t> m_remaining_faults;
+
+    Vector<uint64_t> m_good_values;
+    /* Outputs of the cyclic gates before the last pattern block. Faulty
+     * circuits settle their loops from the same state as the fault free
+     * circuit. */
+    Vector<uint64_t> m_previous_cyclic_values;
+    /* Nets whose fault free values changed in the last pattern block. */
+    Vector<NetId> m_changed_good_nets;
+
+    struct Scratch;
+    /* At most one per thread, they are kept between pattern blocks. */
+    Vector<std::unique_ptr<Scratch>> m_scratches;
+
+    ThreadPool *m_thread_pool;
+
+  public:
+    FaultSimulator(const Circuit &circuit, ThreadPool *thread_pool = nullptr);
+    ~FaultSimulator();
+
+    /**
+     * Primary inputs followed by the outputs of all flip-flops. Patterns
+     * contain one word for each of these nets.
+     */
+    ArrayRef<NetId> pattern_nets() const
+    {
+        return m_pattern_nets;
+    }
+
+    ArrayRef<StuckAtFault> faults() const
+    {
+        return m_faults;
+    }
+
+    bool is_detected(uint32_t fault) const
+    {
+        return m_fault_is_detected[fault];
+    }
+
+    size_t detected_fault_amount() const
+    {
+        return m_faults.size() - m_remaining_faults.size();
+    }
+
+    /**
+     * Fraction of the faults that has been detected so far.
+     */
+    float fault_coverage() const;
+
+    /**
+     * Simulate up to 64 patterns, one per lane. Lanes that are not set in
+     * the lane mask are ignored. Returns the number of newly detected faults.
+     */
+    size_t simulate_patterns(ArrayRef<uint64_t> pattern_words,
+                             uint64_t lane_mask = ALL_LANES);
+
+  private:
+    void simulate_good_circuit(ArrayRef<uint64_t> pattern_words);
+    bool detects_fault(const StuckAtFault &fault,
+                       uint64_t lane_mask,
+                       Scratch &scratch) const;
+    Scratch &claim_scratch();
+};
+
+}  // namespace gate_sim
@@ -0,0 +1,192 @@
+#include <algorithm>
+
+#include "four_state_simulator.h"
+
+namespace gate_sim {
+
+FourStateSimulator::FourStateSimulator(const Circuit &circuit)
+    : m_program(LevelizedProgram::FromCircuit(circuit))
+{
+    Vector<Logic4Word> slots(m_program.slot_amount(), Logic4Word::AllX());
+    for (NetId net : circuit.nets()) {
+        if (circuit.net_driver(net) == NO_GATE) {
+            slots[net] = Logic4Word::AllZ();
+        }
+    }
+    m_slot_buffers[0] = slots;
+    m_slot_buffers[1] = std::move(slots);
+    m_slots = m_slot_buffers[0].begin();
+    m_next_slots = m_slot_buffers[1].begin();
+
+    size_t max_loop_size = 0;
+    for (const CyclicSegment &segment : m_program.cyclic_segments()) {
+        if (segment.is_loop) {
+            max_loop_size = std::max<size_t>(max_loop_size, segment.size);
+        }
+    }
+    m_loop_values = Vector<Logic4Word>(max_loop_size);
+    this->simulate();
+}
+
+void FourStateSimulator::set_net_lanes(NetId net, uint64_t lanes)
+{
+    this->set_net_word(net, Logic4Word::Known(lanes));
+}
+
+uint64_t FourStateSimulator::get_net_lanes(NetId net) const
+{
+    return this->get_net_word(net).is_one();
+}
+
+Logic4 FourStateSimulator::get_net_logic(NetId net) const
+{
+    return this->get_net_word(net).lane(0);
+}
+
+bool FourStateSimulator::add_gate(const Circuit &circuit, GateId gate)
+{
+    size_t old_slot_amount = m_program.slot_amount();
+    size_t old_net_amount = m_program.net_amount();
+    if (!m_program.add_gate(circuit, gate)) {
+        return false;
+    }
+    /* The pointers can change when the buffers grow. */
+    bool is_swapped = m_slots != m_slot_buffers[0].begin();
+    for (Vector<Logic4Word> &buffer : m_slot_buffers) {
+        for (size_t slot = old_slot_amount; slot < m_program.slot_amount();
+             slot++) {
+            buffer.append(Logic4Word::AllX());
+        }
+    }
+    m_slots = m_slot_buffers[is_swapped ? 1 : 0].begin();
+    m_next_slots = m_slot_buffers[is_swapped ? 0 : 1].begin();
+
+    for (NetId net = (NetId)old_net_amount; net < circuit.net_amount();
+         net++) {
+        if (circuit.net_driver(net) == NO_GATE) {
+            this->set_net_word(net, Logic4Word::AllZ());
+        }
+    }
+    /* The output might have been undriven before. */
+    this->set_net_word(circuit.gate_output(gate), Logic4Word::AllX());
+    return true;
+}
+
+static Logic4Word evaluate_instruction(const Instruction &instruction,
+                                       const Logic4Word *slots)
+{
+    Logic4Word a = slots[instruction.input1];
+    Logic4Word b = slots[instruction.input2];
+    switch (instruction.opcode) {
+        case Opcode::Constant0:
+            return Logic4Word::Known(0);
+        case Opcode::Constant1:
+            return Logic4Word::Known(ALL_LANES);
+        case Opcode::Buffer:
+            return logic4_buffer(a);
+        case Opcode::Not:
+            return logic4_not(a);
+        case Opcode::And:
+            return logic4_and(a, b);
+        case Opcode::Nand:
+            return logic4_not(logic4_and(a, b));
+        case Opcode::Or:
+            return logic4_or(a, b);
+        case Opcode::Nor:
+            return logic4_not(logic4_or(a, b));
+        case Opcode::Xor:
+            return logic4_xor(a, b);
+        case Opcode::Xnor:
+            return logic4_not(logic4_xor(a, b));
+        case Opcode::Tristate:
+            return logic4_tristate(a, b);
+    }
+    assert(false);
+    return Logic4Word::AllX();
+}
+
+void FourStateSimulator::read_state(MutableArrayRef<uint64_t> r_words) const
+{
+    assert(r_words.size() == this->state_word_amount());
+    for (size_t slot = 0; slot < m_program.slot_amount(); slot++) {
+        r_words[slot * 2] = m_slots[slot].value;
+        r_words[slot * 2 + 1] = m_slots[slot].unknown;
+    }
+}
+
+void FourStateSimulator::write_state(ArrayRef<uint64_t> words)
+{
+    assert(words.size() == this->state_word_amount());
+    for (size_t slot = 0; slot < m_program.slot_amount(); slot++) {
+        Logic4Word word = {words[slot * 2], words[slot * 2 + 1]};
+        m_slots[slot] = word;
+        m_next_slots[slot] = word;
+    }
+}
+
+void FourStateSimulator::evaluate(ArrayRef<Instruction> instructions)
+{
+    for (const Instruction &instruction : instructions) {
+        m_slots[instruction.output] = evaluate_instruction(instruction,
+                                                           m_slots);
+    }
+}
+
+void FourStateSimulator::simulate()
+{
+    this->evaluate(m_program.levelized_instructions());
+
+    m_has_oscillation = false;
+    for (const CyclicSegment &segment : m_program.cyclic_segments()) {
+        ArrayRef<Instruction> instructions = m_program.segment_instructions(
+            segment);
+        if (!segment.is_loop) {
+            this->evaluate(instructions);
+        }
+        else if (!this->simulate_loop(instructions)) {
+            m_has_oscillation = true;
+        }
+    }
+}
+
+/**
+ * Returns false when the loop did not settle.
+ */
+bool FourStateSimulator::simulate_loop(ArrayRef<Instruction> instructions)
+{
+    for (uint32_t iteration = 0; iteration < MAX_LOOP_ITERATIONS;
+         iteration++) {
+        for (size_t i : instructions.index_range()) {
+            m_loop_values[i] = m_slots[instructions[i].output];
+        }
+        this->evaluate(instructions);
+        bool is_stable = true;
+        for (size_t i : instructions.index_range()) {
+            Logic4Word old_word = m_loop_values[i];
+            Logic4Word new_word = m_slots[instructions[i].output];
+            if (old_word.value != new_word.value ||
+                old_word.unknown != new_word.unknown) {
+                is_stable = false;
+                break;
+            }
+        }
+        if (is_stable) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void FourStateSimulator::clock()
+{
+    for (const Register &reg : m_program.registers()) {
+        m_next_slots[reg.output] = logic4_buffer(m_slots[reg.input]);
+    }
+    /* Combinational loops can store values as well. */
+    for (const Instruction &instruction : m_program.cyclic_instructions()) {
+        m_next_slots[instruction.output] = m_slots[instruction.output];
+    }
+    std::swap(m_slots, m_next_slots);
+}
+
+}  // namespace gate_sim
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "levelized_program.h"
+#include "logic4.h"
+#include "simulator.h"
+
+namespace gate_sim {
+
+/**
+ * Levelized simulator that distinguishes between 0, 1, X and Z. All nets
+ * start out as X, except for nets without any driver, which are Z. This
+ * shows which parts of a circuit are still unknown after a reset sequence
+ * and how far an X propagates.
+ *
+ * The value of a gate is only X when the known inputs do not determine it.
+ * For example, an and gate with a zero input outputs zero even when its
+ * other input is X. Flip-flops start out as X as well, so it is possible to
+ * check that a reset sequence brings every flip-flop into a known state.
+ *
+ * Like in LevelizedSimulator, clock edges swap two slot buffers and
+ * combinational loops are evaluated until they settle.
+ */
+class FourStateSimulator : public Simulator {
+  private:
+    LevelizedProgram m_program;
+    Vector<Logic4Word> m_slot_buffers[2];
+    Logic4Word *m_slots;
+    Logic4Word *m_next_slots;
+    /* Values of a loop before its last iteration. */
+    Vector<Logic4Word> m_loop_values;
+    bool m_has_oscillation = false;
+
+  public:
+    FourStateSimulator(const Circuit &circuit);
+
+    void set_net_lanes(NetId net, uint64_t lanes) override;
+
+    /**
+     * Get the lanes that are one. Lanes that are X or Z are zero.
+     */
+    uint64_t get_net_lanes(NetId net) const override;
+
+    Logic4 get_net_logic(NetId net) const override;
+
+    /**
+     * Set a net that is not driven by a gate to any combination of the four
+     * values, e.g. to X to check that a reset sequence does not depend on it.
+     */
+    void set_net_word(NetId net, Logic4Word word)
+    {
+        uint32_t slot = m_program.net_slot(net);
+        m_slots[slot] = word;
+        m_next_slots[slot] = word;
+    }
+
+    Logic4Word get_net_word(NetId net) const
+    {
+        return m_slots[m_program.net_slot(net)];
+    }
+
+    void simulate() override;
+
+    void clock() override;
+
+    bool has_oscillation() const override
+    {
+        return m_has_oscillation;
+    }
+
+    /**
+     * Two words per slot: the value and the unknown bit plane.
+     */
+    size_t state_word_amount() const override
+    {
+        return m_program.slot_amount() * 2;
+    }
+
+    void read_state(MutableArrayRef<uint64_t> r_words) const override;
+    void write_state(ArrayRef<uint64_t> words) override;
+
+    /**
+     * All slots, including temporary values. Every slot has the value and
+     * the unknown bit plane.
+     */
+    ArrayRef<uint64_t> value_words() const override
+    {
+        static_assert(sizeof(Logic4Word) == 2 * sizeof(uint64_t));
+        return ArrayRef<uint64_t>((const uint64_t *)m_slots,
+                                  this->state_word_amount());
+    }
+
+    size_t net_value_word_index(NetId net) const override
+    {
+        return m_program.net_slot(net) * 2;
+    }
+
+    uint32_t net_value_word_amount() const override
+    {
+        return 2;
+    }
+
+    NetValueLayout net_value_layout() const override
+    {
+        return NetValueLayout::FourState;
+    }
+
+    /**
+     * Gates that do not depend on a combinational loop are added to the
+     * program incrementally. New nets start out as X, or Z when they are
+     * undriven.
+     */
+    bool add_gate(const Circuit &circuit, GateId gate) override;
+
+  private:
+    void evaluate(ArrayRef<Instruction> instructions);
+    bool simulate_loop(ArrayRef<Instruction> instructions);
+};
+
+}  // namespace gate_sim
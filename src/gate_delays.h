@@ -0,0 +1,46 @@
+#pragma once
+
+#include "circuit.h"
+
+namespace gate_sim {
+
+/**
+ * Propagation delay of every gate type in abstract time units. All delays
+ * are at least one, so that a change never affects the time step in which it
+ * happened.
+ */
+class GateDelays {
+  private:
+    uint32_t m_delays[GATE_TYPE_AMOUNT];
+
+  public:
+    GateDelays(uint32_t delay = 1)
+    {
+        assert(delay >= 1);
+        for (uint32_t &value : m_delays) {
+            value = delay;
+        }
+    }
+
+    uint32_t get(GateType type) const
+    {
+        return m_delays[(uint32_t)type];
+    }
+
+    void set(GateType type, uint32_t delay)
+    {
+        assert(delay >= 1);
+        m_delays[(uint32_t)type] = delay;
+    }
+
+    uint32_t max_delay() const
+    {
+        uint32_t max_delay = 1;
+        for (uint32_t delay : m_delays) {
+            max_delay = std::max(max_delay, delay);
+        }
+        return max_delay;
+    }
+};
+
+}  // namespace gate_sim
@@ -0,0 +1,553 @@
+#include "lane_kernels.h"
+
+/* Only 64 bit x86 is supported, because some of the intrinsics work on 64
+ * bit general purpose registers. Other platforms use the scalar code. */
+#if defined(__x86_64__) || defined(_M_X64)
+#    define GATE_SIM_X86
+#endif
+
+#ifdef GATE_SIM_X86
+#    include <immintrin.h>
+#    if defined(_MSC_VER)
+#        include <intrin.h>
+#    else
+#        include <cpuid.h>
+#    endif
+#endif
+
+/* Allows using intrinsics of instruction sets that are not enabled for the
+ * entire build. The functions must only be called after checking that the
+ * CPU supports them. */
+#if defined(__GNUC__)
+#    define GATE_SIM_TARGET(x) __attribute__((target(x)))
+#else
+#    define GATE_SIM_TARGET(x)
+#endif
+
+namespace gate_sim {
+
+const char *instruction_set_name(InstructionSet instruction_set)
+{
+    switch (instruction_set) {
+        case InstructionSet::Scalar:
+            return "Scalar";
+        case InstructionSet::SSE2:
+            return "SSE2";
+        case InstructionSet::AVX2:
+            return "AVX2";
+        case InstructionSet::AVX512:
+            return "AVX-512";
+    }
+    assert(false);
+    return "";
+}
+
+uint32_t instruction_set_lane_words(InstructionSet instruction_set)
+{
+    switch (instruction_set) {
+        case InstructionSet::Scalar:
+            return 1;
+        case InstructionSet::SSE2:
+            return 2;
+        case InstructionSet::AVX2:
+            return 4;
+        case InstructionSet::AVX512:
+            return 8;
+    }
+    assert(false);
+    return 1;
+}
+
+#ifdef GATE_SIM_X86
+
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t r_registers[4])
+{
+#    if defined(_MSC_VER)
+    int registers[4];
+    __cpuidex(registers, (int)leaf, (int)subleaf);
+    for (int i = 0; i < 4; i++) {
+        r_registers[i] = (uint32_t)registers[i];
+    }
+#    else
+    __cpuid_count(leaf,
+                  subleaf,
+                  r_registers[0],
+                  r_registers[1],
+                  r_registers[2],
+                  r_registers[3]);
+#    endif
+}
+
+/**
+ * Get the register state that is saved by the operating system on context
+ * switches. Vector registers can only be used when the OS preserves them.
+ */
+static uint64_t get_enabled_xsave_features()
+{
+#    if defined(_MSC_VER)
+    return _xgetbv(0);
+#    else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#    endif
+}
+
+static InstructionSet detect_instruction_set()
+{
+    uint32_t registers[4];
+    cpuid(0, 0, registers);
+    uint32_t max_leaf = registers[0];
+
+    cpuid(1, 0, registers);
+    bool has_sse2 = registers[3] & (1u << 26);
+    bool has_osxsave = registers[2] & (1u << 27);
+    bool has_avx = registers[2] & (1u << 28);
+    if (!has_sse2) {
+        return InstructionSet::Scalar;
+    }
+    if (!has_osxsave || !has_avx || max_leaf < 7) {
+        return InstructionSet::SSE2;
+    }
+
+    /* XMM and YMM state. */
+    uint64_t xsave_features = get_enabled_xsave_features();
+    if ((xsave_features & 0x06) != 0x06) {
+        return InstructionSet::SSE2;
+    }
+
+    cpuid(7, 0, registers);
+    bool has_avx2 = registers[1] & (1u << 5);
+    bool has_avx512f = registers[1] & (1u << 16);
+    /* Additionally opmask and ZMM state. */
+    if (has_avx512f && (xsave_features & 0xe6) == 0xe6) {
+        return InstructionSet::AVX512;
+    }
+    if (has_avx2) {
+        return InstructionSet::AVX2;
+    }
+    return InstructionSet::SSE2;
+}
+
+/**
+ * AVX-512 has a population count instruction only with the VPOPCNTDQ
+ * extension.
+ */
+static bool detect_avx512_popcount()
+{
+    if (best_instruction_set() != InstructionSet::AVX512) {
+        return false;
+    }
+    uint32_t registers[4];
+    cpuid(7, 0, registers);
+    return registers[2] & (1u << 14);
+}
+
+#else
+
+static InstructionSet detect_instruction_set()
+{
+    return InstructionSet::Scalar;
+}
+
+#endif
+
+InstructionSet best_instruction_set()
+{
+    static InstructionSet instruction_set = detect_instruction_set();
+    return instruction_set;
+}
+
+static void evaluate_instructions_scalar(ArrayRef<Instruction> instructions,
+                                         uint64_t *slots)
+{
+    for (const Instruction &instruction : instructions) {
+        uint64_t a = slots[instruction.input1];
+        uint64_t b = slots[instruction.input2];
+        uint64_t result = 0;
+        switch (instruction.opcode) {
+            case Opcode::Constant0:
+                result = 0;
+                break;
+            case Opcode::Constant1:
+                result = ~(uint64_t)0;
+                break;
+            case Opcode::Buffer:
+                result = a;
+                break;
+            case Opcode::Not:
+                result = ~a;
+                break;
+            case Opcode::And:
+                result = a & b;
+                break;
+            case Opcode::Nand:
+                result = ~(a & b);
+                break;
+            case Opcode::Or:
+                result = a | b;
+                break;
+            case Opcode::Nor:
+                result = ~(a | b);
+                break;
+            case Opcode::Xor:
+                result = a ^ b;
+                break;
+            case Opcode::Xnor:
+                result = ~(a ^ b);
+                break;
+            case Opcode::Tristate:
+                result = a & b;
+                break;
+        }
+        slots[instruction.output] = result;
+    }
+}
+
+#ifdef GATE_SIM_X86
+
+// clang-format off
+
+/* The evaluation loop is the same for all vector instruction sets. Only the
+ * vector type and the operations on it differ. */
+#define EVALUATE_INSTRUCTIONS_VECTORIZED(VECTOR, WORDS, LOAD, STORE, AND, OR, XOR, ONES, ZERO) \
+  const VECTOR ones = ONES; \
+  for (const Instruction &instruction : instructions) { \
+    VECTOR a = LOAD((const VECTOR *)(slots + (size_t)instruction.input1 * WORDS)); \
+    VECTOR b = LOAD((const VECTOR *)(slots + (size_t)instruction.input2 * WORDS)); \
+    VECTOR result; \
+    switch (instruction.opcode) { \
+      case Opcode::Constant0: result = ZERO; break; \
+      case Opcode::Constant1: result = ones; break; \
+      case Opcode::Buffer: result = a; break; \
+      case Opcode::Not: result = XOR(a, ones); break; \
+      case Opcode::And: result = AND(a, b); break; \
+      case Opcode::Nand: result = XOR(AND(a, b), ones); break; \
+      case Opcode::Or: result = OR(a, b); break; \
+      case Opcode::Nor: result = XOR(OR(a, b), ones); break; \
+      case Opcode::Xor: result = XOR(a, b); break; \
+      case Opcode::Xnor: result = XOR(XOR(a, b), ones); break; \
+      case Opcode::Tristate: result = AND(a, b); break; \
+      default: result = ZERO; break; \
+    } \
+    STORE((VECTOR *)(slots + (size_t)instruction.output * WORDS), result); \
+  } ((void)0)
+
+// clang-format on
+
+GATE_SIM_TARGET("sse2")
+static void evaluate_instructions_sse2(ArrayRef<Instruction> instructions,
+                                       uint64_t *slots)
+{
+    EVALUATE_INSTRUCTIONS_VECTORIZED(__m128i,
+                                     2,
+                                     _mm_load_si128,
+                                     _mm_store_si128,
+                                     _mm_and_si128,
+                                     _mm_or_si128,
+                                     _mm_xor_si128,
+                                     _mm_set1_epi32(-1),
+                                     _mm_setzero_si128());
+}
+
+GATE_SIM_TARGET("avx2")
+static void evaluate_instructions_avx2(ArrayRef<Instruction> instructions,
+                                       uint64_t *slots)
+{
+    EVALUATE_INSTRUCTIONS_VECTORIZED(__m256i,
+                                     4,
+                                     _mm256_load_si256,
+                                     _mm256_store_si256,
+                                     _mm256_and_si256,
+                                     _mm256_or_si256,
+                                     _mm256_xor_si256,
+                                     _mm256_set1_epi32(-1),
+                                     _mm256_setzero_si256());
+}
+
+GATE_SIM_TARGET("avx512f")
+static void evaluate_instructions_avx512(ArrayRef<Instruction> instructions,
+                                         uint64_t *slots)
+{
+    EVALUATE_INSTRUCTIONS_VECTORIZED(__m512i,
+                                     8,
+                                     _mm512_load_si512,
+                                     _mm512_store_si512,
+                                     _mm512_and_si512,
+                                     _mm512_or_si512,
+                                     _mm512_xor_si512,
+                                     _mm512_set1_epi32(-1),
+                                     _mm512_setzero_si512());
+}
+
+#    undef EVALUATE_INSTRUCTIONS_VECTORIZED
+
+#endif
+
+EvaluateInstructionsFn get_evaluate_instructions_fn(
+    InstructionSet instruction_set)
+{
+    switch (instruction_set) {
+        case InstructionSet::Scalar:
+            return evaluate_instructions_scalar;
+#ifdef GATE_SIM_X86
+        case InstructionSet::SSE2:
+            return evaluate_instructions_sse2;
+        case InstructionSet::AVX2:
+            return evaluate_instructions_avx2;
+        case InstructionSet::AVX512:
+            return evaluate_instructions_avx512;
+#else
+        default:
+            break;
+#endif
+    }
+    assert(false);
+    return evaluate_instructions_scalar;
+}
+
+// clang-format off
+
+/* Only the first word of every item holds the lanes, the other words are
+ * copies of it. */
+#define COUNT_TOGGLES_SCALAR(POPCOUNT) \
+  for (size_t item = 0; item < item_amount; item++) { \
+    size_t i = item * words_per_item; \
+    uint64_t value = values[i]; \
+    uint64_t last_value = last_values[i]; \
+    uint64_t changed = value ^ last_value; \
+    if (changed != 0) { \
+      rise_counts[item] += POPCOUNT(changed & value); \
+      fall_counts[item] += POPCOUNT(changed & last_value); \
+      last_values[i] = value; \
+    } \
+  } ((void)0)
+
+/* Every item is a value and an unknown word. Lanes that are unknown before
+ * or after the cycle do not toggle. */
+#define COUNT_FOUR_STATE_TOGGLES_SCALAR(POPCOUNT) \
+  for (size_t item = 0; item < item_amount; item++) { \
+    size_t i = item * 2; \
+    uint64_t value = values[i]; \
+    uint64_t last_value = last_values[i]; \
+    uint64_t known = ~(values[i + 1] | last_values[i + 1]); \
+    uint64_t changed = (value ^ last_value) & known; \
+    rise_counts[item] += POPCOUNT(changed & value); \
+    fall_counts[item] += POPCOUNT(changed & last_value); \
+    last_values[i] = value; \
+    last_values[i + 1] = values[i + 1]; \
+  } ((void)0)
+
+// clang-format on
+
+static uint64_t popcount(uint64_t value)
+{
+    value = value - ((value >> 1) & 0x5555555555555555);
+    value = (value & 0x3333333333333333) + ((value >> 2) & 0x3333333333333333);
+    value = (value + (value >> 4)) & 0x0f0f0f0f0f0f0f0f;
+    return (value * 0x0101010101010101) >> 56;
+}
+
+static void count_toggles_scalar(const uint64_t *values,
+                                 uint64_t *last_values,
+                                 uint64_t *rise_counts,
+                                 uint64_t *fall_counts,
+                                 size_t item_amount,
+                                 uint32_t words_per_item)
+{
+    COUNT_TOGGLES_SCALAR(popcount);
+}
+
+static void count_four_state_toggles_scalar(const uint64_t *values,
+                                            uint64_t *last_values,
+                                            uint64_t *rise_counts,
+                                            uint64_t *fall_counts,
+                                            size_t item_amount,
+                                            uint32_t words_per_item)
+{
+    assert(words_per_item == 2);
+    BAS_UNUSED_VAR(words_per_item);
+    COUNT_FOUR_STATE_TOGGLES_SCALAR(popcount);
+}
+
+#ifdef GATE_SIM_X86
+
+/* Every CPU with AVX2 has the popcnt instruction. */
+GATE_SIM_TARGET("popcnt")
+static void count_toggles_popcnt(const uint64_t *values,
+                                 uint64_t *last_values,
+                                 uint64_t *rise_counts,
+                                 uint64_t *fall_counts,
+                                 size_t item_amount,
+                                 uint32_t words_per_item)
+{
+    COUNT_TOGGLES_SCALAR(_mm_popcnt_u64);
+}
+
+GATE_SIM_TARGET("popcnt")
+static void count_four_state_toggles_popcnt(const uint64_t *values,
+                                            uint64_t *last_values,
+                                            uint64_t *rise_counts,
+                                            uint64_t *fall_counts,
+                                            size_t item_amount,
+                                            uint32_t words_per_item)
+{
+    assert(words_per_item == 2);
+    BAS_UNUSED_VAR(words_per_item);
+    COUNT_FOUR_STATE_TOGGLES_SCALAR(_mm_popcnt_u64);
+}
+
+/**
+ * Population count of every 64 bit element. The number of bits in every
+ * nibble is looked up with a shuffle and the bytes are summed up with
+ * a sum of absolute differences against zero.
+ */
+GATE_SIM_TARGET("avx2")
+static __m256i popcount_epi64_avx2(__m256i value)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2,
+                                            3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2,
+                                            2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i low = _mm256_and_si256(value, low_mask);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(value, 4), low_mask);
+    __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low),
+                                     _mm256_shuffle_epi8(lookup, high));
+    return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+}
+
+/**
+ * Requires one word per item. Four consecutive items are processed at once,
+ * so that their counters are updated with vector operations as well.
+ */
+GATE_SIM_TARGET("avx2,popcnt")
+static void count_toggles_avx2(const uint64_t *values,
+                               uint64_t *last_values,
+                               uint64_t *rise_counts,
+                               uint64_t *fall_counts,
+                               size_t item_amount,
+                               uint32_t words_per_item)
+{
+    assert(words_per_item == 1);
+    size_t item = 0;
+    for (; item + 4 <= item_amount; item += 4) {
+        __m256i value = _mm256_loadu_si256((const __m256i *)(values + item));
+        __m256i last_value = _mm256_loadu_si256(
+            (const __m256i *)(last_values + item));
+        __m256i changed = _mm256_xor_si256(value, last_value);
+        /* Most values do not change in most cycles. */
+        if (_mm256_testz_si256(changed, changed)) {
+            continue;
+        }
+        __m256i *rises = (__m256i *)(rise_counts + item);
+        __m256i *falls = (__m256i *)(fall_counts + item);
+        _mm256_storeu_si256(
+            rises,
+            _mm256_add_epi64(_mm256_loadu_si256(rises),
+                             popcount_epi64_avx2(
+                                 _mm256_and_si256(changed, value))));
+        _mm256_storeu_si256(
+            falls,
+            _mm256_add_epi64(_mm256_loadu_si256(falls),
+                             popcount_epi64_avx2(
+                                 _mm256_and_si256(changed, last_value))));
+        _mm256_storeu_si256((__m256i *)(last_values + item), value);
+    }
+    count_toggles_popcnt(values + item,
+                         last_values + item,
+                         rise_counts + item,
+                         fall_counts + item,
+                         item_amount - item,
+                         words_per_item);
+}
+
+/* Like the AVX2 version with eight items at once. */
+GATE_SIM_TARGET("avx512f,avx512vpopcntdq,popcnt")
+static void count_toggles_avx512(const uint64_t *values,
+                                 uint64_t *last_values,
+                                 uint64_t *rise_counts,
+                                 uint64_t *fall_counts,
+                                 size_t item_amount,
+                                 uint32_t words_per_item)
+{
+    assert(words_per_item == 1);
+    size_t item = 0;
+    for (; item + 8 <= item_amount; item += 8) {
+        __m512i value = _mm512_loadu_si512(values + item);
+        __m512i last_value = _mm512_loadu_si512(last_values + item);
+        __m512i changed = _mm512_xor_si512(value, last_value);
+        if (_mm512_test_epi64_mask(changed, changed) == 0) {
+            continue;
+        }
+        __m512i rises = _mm512_popcnt_epi64(_mm512_and_si512(changed, value));
+        __m512i falls = _mm512_popcnt_epi64(
+            _mm512_and_si512(changed, last_value));
+        _mm512_storeu_si512(
+            rise_counts + item,
+            _mm512_add_epi64(_mm512_loadu_si512(rise_counts + item), rises));
+        _mm512_storeu_si512(
+            fall_counts + item,
+            _mm512_add_epi64(_mm512_loadu_si512(fall_counts + item), falls));
+        _mm512_storeu_si512(last_values + item, value);
+    }
+    count_toggles_popcnt(values + item,
+                         last_values + item,
+                         rise_counts + item,
+                         fall_counts + item,
+                         item_amount - item,
+                         words_per_item);
+}
+
+#endif
+
+#undef COUNT_TOGGLES_SCALAR
+#undef COUNT_FOUR_STATE_TOGGLES_SCALAR
+
+CountTogglesFn get_count_toggles_fn(InstructionSet instruction_set,
+                                    uint32_t words_per_item)
+{
+    switch (instruction_set) {
+        case InstructionSet::Scalar:
+        case InstructionSet::SSE2:
+            return count_toggles_scalar;
+#ifdef GATE_SIM_X86
+        case InstructionSet::AVX2:
+            return words_per_item == 1 ? count_toggles_avx2 :
+                                         count_toggles_popcnt;
+        case InstructionSet::AVX512: {
+            static bool has_popcount = detect_avx512_popcount();
+            if (words_per_item != 1) {
+                return count_toggles_popcnt;
+            }
+            return has_popcount ? count_toggles_avx512 : count_toggles_avx2;
+        }
+#else
+        default:
+            break;
+#endif
+    }
+    assert(false);
+    return count_toggles_scalar;
+}
+
+CountTogglesFn get_count_four_state_toggles_fn(
+    InstructionSet instruction_set)
+{
+    switch (instruction_set) {
+        case InstructionSet::Scalar:
+        case InstructionSet::SSE2:
+            return count_four_state_toggles_scalar;
+#ifdef GATE_SIM_X86
+        case InstructionSet::AVX2:
+        case InstructionSet::AVX512:
+            return count_four_state_toggles_popcnt;
+#else
+        default:
+            break;
+#endif
+    }
+    assert(false);
+    return count_four_state_toggles_scalar;
+}
+
+}  // namespace gate_sim
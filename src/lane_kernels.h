@@ -0,0 +1,75 @@
+#pragma once
+
+#include "levelized_program.h"
+
+namespace gate_sim {
+
+using bas::uint64_t;
+
+enum class InstructionSet {
+    Scalar,
+    SSE2,
+    AVX2,
+    AVX512,
+};
+
+const char *instruction_set_name(InstructionSet instruction_set);
+
+/**
+ * Get the widest instruction set that is supported by the CPU and the
+ * operating system. The detection is done with cpuid once and cached.
+ */
+InstructionSet best_instruction_set();
+
+/**
+ * Number of 64 bit words that are processed by one vector operation.
+ */
+uint32_t instruction_set_lane_words(InstructionSet instruction_set);
+
+/**
+ * Values are stored in units of cache lines. This guarantees that the value
+ * of every slot is aligned for the widest vector loads.
+ */
+struct alignas(64) CacheLine {
+    uint64_t words[8];
+};
+
+/**
+ * Evaluates instructions on slots that consist of lane_words consecutive
+ * words each. The slot array has to be aligned to the vector size.
+ */
+using EvaluateInstructionsFn = void (*)(ArrayRef<Instruction> instructions,
+                                        uint64_t *slots);
+
+EvaluateInstructionsFn get_evaluate_instructions_fn(
+    InstructionSet instruction_set);
+
+/**
+ * Compares the values with the last values and stores them as the new last
+ * values. Every item of words_per_item consecutive words holds the lanes of
+ * one net. For every item, the number of lanes that changed from zero to one
+ * and from one to zero is added to its counters.
+ */
+using CountTogglesFn = void (*)(const uint64_t *values,
+                                uint64_t *last_values,
+                                uint64_t *rise_counts,
+                                uint64_t *fall_counts,
+                                size_t item_amount,
+                                uint32_t words_per_item);
+
+/**
+ * Get the fastest function for items whose first word holds the lanes and
+ * whose other words are copies of it, like the slots of vectorized
+ * simulators.
+ */
+CountTogglesFn get_count_toggles_fn(InstructionSet instruction_set,
+                                    uint32_t words_per_item);
+
+/**
+ * Get the fastest function for items that are a Logic4Word. Only changes
+ * between known zeros and ones are counted.
+ */
+CountTogglesFn get_count_four_state_toggles_fn(
+    InstructionSet instruction_set);
+
+}  // namespace gate_sim
@@ -0,0 +1,515 @@
+#include "bas/set.h"
+
+#include "levelized_program.h"
+#include "strongly_connected_components.h"
+
+namespace gate_sim {
+
+using bas::Set;
+
+static constexpr uint32_t NO_INSTRUCTION = (uint32_t)-1;
+static constexpr uint32_t NO_POSITION = (uint32_t)-1;
+/* Level of slots that are not computed by any instruction. */
+static constexpr uint32_t NO_LEVEL = (uint32_t)-1;
+/* Level of slots that are computed by instructions that cannot be
+ * levelized. */
+static constexpr uint32_t CYCLIC_LEVEL = (uint32_t)-2;
+
+static uint32_t opcode_input_amount(Opcode opcode)
+{
+    switch (opcode) {
+        case Opcode::Constant0:
+        case Opcode::Constant1:
+            return 0;
+        case Opcode::Buffer:
+        case Opcode::Not:
+            return 1;
+        case Opcode::And:
+        case Opcode::Nand:
+        case Opcode::Or:
+        case Opcode::Nor:
+        case Opcode::Xor:
+        case Opcode::Xnor:
+        case Opcode::Tristate:
+            return 2;
+    }
+    assert(false);
+    return 0;
+}
+
+/**
+ * Combine the values in the given slots with an associative operation. The
+ * values are combined in a balanced tree to keep the number of levels low.
+ * Only the final instruction can be inverting.
+ */
+static void append_reduction(Vector<Instruction> &instructions,
+                             Opcode opcode,
+                             bool invert,
+                             ArrayRef<uint32_t> input_slots,
+                             uint32_t output_slot,
+                             uint32_t &r_slot_amount)
+{
+    assert(input_slots.size() > 0);
+    if (input_slots.size() == 1) {
+        Opcode final_opcode = invert ? Opcode::Not : Opcode::Buffer;
+        instructions.append(
+            {final_opcode, input_slots[0], input_slots[0], output_slot});
+        return;
+    }
+
+    /* Every round overwrites the front of the slots with the results. */
+    Vector<uint32_t> slots = input_slots;
+    size_t amount = slots.size();
+    while (amount > 2) {
+        size_t new_amount = 0;
+        for (size_t i = 0; i + 1 < amount; i += 2) {
+            uint32_t temporary_slot = r_slot_amount++;
+            instructions.append(
+                {opcode, slots[i], slots[i + 1], temporary_slot});
+            slots[new_amount++] = temporary_slot;
+        }
+        if (amount % 2 == 1) {
+            slots[new_amount++] = slots[amount - 1];
+        }
+        amount = new_amount;
+    }
+
+    Opcode final_opcode = opcode;
+    if (invert) {
+        switch (opcode) {
+            case Opcode::And:
+                final_opcode = Opcode::Nand;
+                break;
+            case Opcode::Or:
+                final_opcode = Opcode::Nor;
+                break;
+            case Opcode::Xor:
+                final_opcode = Opcode::Xnor;
+                break;
+            default:
+                assert(false);
+                break;
+        }
+    }
+    instructions.append({final_opcode, slots[0], slots[1], output_slot});
+}
+
+/**
+ * Append the instructions that compute the output of the gate, or a register
+ * for flip-flops.
+ */
+static void append_gate_instructions(const Circuit &circuit,
+                                     GateId gate,
+                                     ArrayRef<uint32_t> net_slots,
+                                     Vector<Instruction> &instructions,
+                                     Vector<Register> &r_registers,
+                                     uint32_t &r_slot_amount)
+{
+    Vector<uint32_t> inputs;
+    for (NetId net : circuit.gate_inputs(gate)) {
+        inputs.append(net_slots[net]);
+    }
+    uint32_t output = net_slots[circuit.gate_output(gate)];
+
+    switch (circuit.gate_type(gate)) {
+        case GateType::Input:
+            break;
+        case GateType::Constant0:
+            instructions.append({Opcode::Constant0, output, output, output});
+            break;
+        case GateType::Constant1:
+            instructions.append({Opcode::Constant1, output, output, output});
+            break;
+        case GateType::Buffer:
+            instructions.append(
+                {Opcode::Buffer, inputs[0], inputs[0], output});
+            break;
+        case GateType::Not:
+            instructions.append({Opcode::Not, inputs[0], inputs[0], output});
+            break;
+        case GateType::And:
+        case GateType::Nand:
+            append_reduction(instructions,
+                             Opcode::And,
+                             circuit.gate_type(gate) == GateType::Nand,
+                             inputs,
+                             output,
+                             r_slot_amount);
+            break;
+        case GateType::Or:
+        case GateType::Nor:
+            append_reduction(instructions,
+                             Opcode::Or,
+                             circuit.gate_type(gate) == GateType::Nor,
+                             inputs,
+                             output,
+                             r_slot_amount);
+            break;
+        case GateType::Xor:
+        case GateType::Xnor:
+            append_reduction(instructions,
+                             Opcode::Xor,
+                             circuit.gate_type(gate) == GateType::Xnor,
+                             inputs,
+                             output,
+                             r_slot_amount);
+            break;
+        case GateType::Tristate:
+            instructions.append(
+                {Opcode::Tristate, inputs[0], inputs[1], output});
+            break;
+        case GateType::FlipFlop:
+            r_registers.append({inputs[0], output});
+            break;
+    }
+}
+
+LevelizedProgram LevelizedProgram::FromCircuit(const Circuit &circuit)
+{
+    uint32_t slot_amount = (uint32_t)circuit.net_amount();
+    Vector<uint32_t> net_slots(circuit.net_amount());
+    for (NetId net : circuit.nets()) {
+        net_slots[net] = net;
+    }
+    Vector<Register> registers;
+    Vector<Instruction> instructions;
+    for (GateId gate : circuit.gates()) {
+        append_gate_instructions(
+            circuit, gate, net_slots, instructions, registers, slot_amount);
+    }
+    uint32_t instruction_amount = (uint32_t)instructions.size();
+
+    Vector<uint32_t> producers(slot_amount, NO_INSTRUCTION);
+    for (uint32_t i : instructions.index_range()) {
+        producers[instructions[i].output] = i;
+    }
+
+    /* Find the instructions that read every slot, in compressed sparse row
+     * format. Also count how many inputs of every instruction are computed by
+     * other instructions. */
+    Vector<uint32_t> consumer_starts(slot_amount + 1, 0);
+    Vector<uint32_t> dependency_amounts(instruction_amount, 0);
+    for (uint32_t i : instructions.index_range()) {
+        const Instruction &instruction = instructions[i];
+        uint32_t inputs[2] = {instruction.input1, instruction.input2};
+        uint32_t input_amount = opcode_input_amount(instruction.opcode);
+        for (uint32_t j = 0; j < input_amount; j++) {
+            consumer_starts[inputs[j] + 1]++;
+            if (producers[inputs[j]] != NO_INSTRUCTION) {
+                dependency_amounts[i]++;
+            }
+        }
+    }
+    for (uint32_t slot = 0; slot < slot_amount; slot++) {
+        consumer_starts[slot + 1] += consumer_starts[slot];
+    }
+    Vector<uint32_t> consumers(consumer_starts.last());
+    {
+        Vector<uint32_t> offsets = consumer_starts;
+        for (uint32_t i : instructions.index_range()) {
+            const Instruction &instruction = instructions[i];
+            uint32_t inputs[2] = {instruction.input1, instruction.input2};
+            uint32_t input_amount = opcode_input_amount(instruction.opcode);
+            for (uint32_t j = 0; j < input_amount; j++) {
+                consumers[offsets[inputs[j]]++] = i;
+            }
+        }
+    }
+
+    /* Kahn's algorithm. An instruction gets a level that is one higher than
+     * the highest level of the instructions it depends on. */
+    Vector<uint32_t> levels(instruction_amount, 0);
+    Vector<uint32_t> queue;
+    queue.reserve(instruction_amount);
+    for (uint32_t i : instructions.index_range()) {
+        if (dependency_amounts[i] == 0) {
+            queue.append(i);
+        }
+    }
+    uint32_t level_amount = 0;
+    for (size_t queue_index = 0; queue_index < queue.size(); queue_index++) {
+        uint32_t i = queue[queue_index];
+        level_amount = std::max(level_amount, levels[i] + 1);
+        uint32_t output = instructions[i].output;
+        for (uint32_t k = consumer_starts[output];
+             k < consumer_starts[output + 1];
+             k++) {
+            uint32_t consumer = consumers[k];
+            levels[consumer] = std::max(levels[consumer], levels[i] + 1);
+            dependency_amounts[consumer]--;
+            if (dependency_amounts[consumer] == 0) {
+                queue.append(consumer);
+            }
+        }
+    }
+
+    /* Sort the levelized instructions by level with a counting sort. */
+    LevelizedProgram program;
+    program.m_net_amount = (uint32_t)circuit.net_amount();
+    program.m_slot_amount = slot_amount;
+    program.m_registers = std::move(registers);
+    program.m_level_starts = Vector<uint32_t>(level_amount + 1, 0);
+    for (uint32_t i : queue) {
+        program.m_level_starts[levels[i] + 1]++;
+    }
+    for (uint32_t level = 0; level < level_amount; level++) {
+        program.m_level_starts[level + 1] += program.m_level_starts[level];
+    }
+
+    program.m_net_slots = std::move(net_slots);
+    program.m_slot_levels = Vector<uint32_t>(slot_amount, NO_LEVEL);
+    program.m_slot_positions = Vector<uint32_t>(slot_amount, NO_POSITION);
+    program.m_instructions = Vector<Instruction>(instruction_amount);
+    Vector<uint32_t> offsets = program.m_level_starts;
+    for (uint32_t i : queue) {
+        program.m_slot_levels[instructions[i].output] = levels[i];
+        program.place_instruction(offsets[levels[i]]++, instructions[i]);
+    }
+
+    /* Remember the consumers by their output slot, which does not change
+     * when instructions are moved. */
+    program.m_consumer_starts = consumer_starts;
+    program.m_consumers = Vector<uint32_t>(consumers.size());
+    for (size_t k : consumers.index_range()) {
+        program.m_consumers[k] = instructions[consumers[k]].output;
+    }
+
+    /* The remaining instructions are part of or depend on a loop. Their
+     * successors are remaining instructions as well. */
+    Vector<uint32_t> cyclic_instructions;
+    for (uint32_t i : instructions.index_range()) {
+        if (dependency_amounts[i] > 0) {
+            cyclic_instructions.append(i);
+        }
+    }
+    auto successors = [&](uint32_t i) {
+        uint32_t output = instructions[i].output;
+        return consumers.as_ref().slice(
+            consumer_starts[output],
+            consumer_starts[output + 1] - consumer_starts[output]);
+    };
+    StronglyConnectedComponents components = StronglyConnectedComponents::Find(
+        instruction_amount, cyclic_instructions, successors);
+
+    /* Components are in reverse topological order. Consecutive components
+     * that are not loops are merged into a single segment. */
+    uint32_t cyclic_offset = (uint32_t)queue.size();
+    for (size_t c = components.component_amount(); c-- > 0;) {
+        bool is_loop = components.is_cycle(c, successors);
+        if (is_loop || program.m_cyclic_segments.is_empty() ||
+            program.m_cyclic_segments.last().is_loop) {
+            program.m_cyclic_segments.append({cyclic_offset, 0, is_loop});
+        }
+        for (uint32_t i : components.component(c)) {
+            program.m_slot_levels[instructions[i].output] = CYCLIC_LEVEL;
+            program.m_instructions[cyclic_offset++] = instructions[i];
+            program.m_cyclic_segments.last().size++;
+        }
+    }
+    return program;
+}
+
+bool LevelizedProgram::add_gate(const Circuit &circuit, GateId gate)
+{
+    /* Check that the gate can be levelized before changing anything. Nets
+     * without a slot are new and not computed by any instruction yet. */
+    auto existing_slot = [&](NetId net) {
+        return net < m_net_slots.size() ? m_net_slots[net] : NO_POSITION;
+    };
+    Vector<uint32_t> input_slots;
+    for (NetId net : circuit.gate_inputs(gate)) {
+        uint32_t slot = existing_slot(net);
+        if (slot != NO_POSITION) {
+            if (m_slot_levels[slot] == CYCLIC_LEVEL) {
+                return false;
+            }
+            input_slots.append(slot);
+        }
+    }
+    uint32_t old_output_slot = existing_slot(circuit.gate_output(gate));
+    bool is_register = circuit.gate_type(gate) == GateType::FlipFlop;
+    if (old_output_slot != NO_POSITION && !is_register) {
+        if (input_slots.contains(old_output_slot) ||
+            this->cone_contains_slots(old_output_slot, input_slots)) {
+            return false;
+        }
+    }
+
+    /* Nets that were added since the last update. */
+    while (m_net_slots.size() < circuit.net_amount()) {
+        m_net_slots.append(this->add_slot());
+    }
+    m_net_amount = (uint32_t)circuit.net_amount();
+
+    Vector<Instruction> instructions;
+    uint32_t slot_amount = m_slot_amount;
+    append_gate_instructions(circuit,
+                             gate,
+                             m_net_slots,
+                             instructions,
+                             m_registers,
+                             slot_amount);
+    while (m_slot_amount < slot_amount) {
+        this->add_slot();
+    }
+
+    /* The instructions of a gate are in topological order. */
+    for (const Instruction &instruction : instructions) {
+        uint32_t level = this->compute_level(instruction);
+        this->insert_instruction(instruction, level);
+        uint32_t inputs[2] = {instruction.input1, instruction.input2};
+        for (uint32_t j = 0; j < opcode_input_amount(instruction.opcode);
+             j++) {
+            m_added_consumers.add(inputs[j], instruction.output);
+        }
+    }
+    if (instructions.is_empty()) {
+        return true;
+    }
+
+    /* Instructions that read the output of the gate might have to move to a
+     * higher level. */
+    Vector<uint32_t> changed_slots = {instructions.last().output};
+    while (!changed_slots.is_empty()) {
+        uint32_t slot = changed_slots.pop_last();
+        this->foreach_consumer(slot, [&](uint32_t consumer) {
+            uint32_t old_level = m_slot_levels[consumer];
+            if (old_level == CYCLIC_LEVEL) {
+                return;
+            }
+            uint32_t position = m_slot_positions[consumer];
+            uint32_t new_level = this->compute_level(
+                m_instructions[position]);
+            if (new_level > old_level) {
+                this->move_instruction_up(consumer, new_level);
+                changed_slots.append(consumer);
+            }
+        });
+    }
+    return true;
+}
+
+uint32_t LevelizedProgram::add_slot()
+{
+    m_slot_levels.append(NO_LEVEL);
+    m_slot_positions.append(NO_POSITION);
+    return m_slot_amount++;
+}
+
+uint32_t LevelizedProgram::compute_level(const Instruction &instruction) const
+{
+    uint32_t inputs[2] = {instruction.input1, instruction.input2};
+    uint32_t level = 0;
+    for (uint32_t j = 0; j < opcode_input_amount(instruction.opcode); j++) {
+        uint32_t input_level = m_slot_levels[inputs[j]];
+        if (input_level != NO_LEVEL) {
+            assert(input_level != CYCLIC_LEVEL);
+            level = std::max(level, input_level + 1);
+        }
+    }
+    return level;
+}
+
+/**
+ * Check if any of the given slots is computed from the slot by levelized
+ * instructions.
+ */
+bool LevelizedProgram::cone_contains_slots(uint32_t slot,
+                                           ArrayRef<uint32_t> slots) const
+{
+    Set<uint32_t> visited_slots;
+    Vector<uint32_t> slots_to_visit = {slot};
+    bool found = false;
+    while (!slots_to_visit.is_empty() && !found) {
+        uint32_t current = slots_to_visit.pop_last();
+        this->foreach_consumer(current, [&](uint32_t consumer) {
+            if (m_slot_levels[consumer] == CYCLIC_LEVEL ||
+                !visited_slots.add(consumer)) {
+                return;
+            }
+            if (slots.contains(consumer)) {
+                found = true;
+            }
+            slots_to_visit.append(consumer);
+        });
+    }
+    return found;
+}
+
+/**
+ * Insert the instruction at the end of the level. The first instruction of
+ * every higher level moves to the end of its level to make room.
+ */
+void LevelizedProgram::insert_instruction(const Instruction &instruction,
+                                          uint32_t level)
+{
+    /* The cyclic instructions move back by one. There are usually few of
+     * them. */
+    uint32_t levelized_end = m_level_starts.last();
+    m_instructions.append(instruction);
+    for (uint32_t position = (uint32_t)m_instructions.size() - 1;
+         position > levelized_end;
+         position--) {
+        m_instructions[position] = m_instructions[position - 1];
+    }
+    for (CyclicSegment &segment : m_cyclic_segments) {
+        segment.start++;
+    }
+
+    while (level >= this->level_amount()) {
+        this->add_level();
+    }
+    uint32_t free_position = levelized_end;
+    for (size_t k = this->level_amount() - 1; k > level; k--) {
+        uint32_t first = m_level_starts[k];
+        if (first != free_position) {
+            this->place_instruction(free_position, m_instructions[first]);
+            free_position = first;
+        }
+        m_level_starts[k + 1]++;
+    }
+    m_level_starts[level + 1]++;
+    m_slot_levels[instruction.output] = level;
+    this->place_instruction(free_position, instruction);
+}
+
+/**
+ * Move the instruction that computes the slot to the end of a higher level.
+ * The last instruction of every level in between takes the free position.
+ */
+void LevelizedProgram::move_instruction_up(uint32_t slot, uint32_t level)
+{
+    uint32_t old_level = m_slot_levels[slot];
+    assert(level > old_level);
+    while (level >= this->level_amount()) {
+        this->add_level();
+    }
+    uint32_t free_position = m_slot_positions[slot];
+    Instruction instruction = m_instructions[free_position];
+    for (uint32_t k = old_level; k < level; k++) {
+        uint32_t last = m_level_starts[k + 1] - 1;
+        if (last != free_position) {
+            this->place_instruction(free_position, m_instructions[last]);
+            free_position = last;
+        }
+        m_level_starts[k + 1]--;
+    }
+    m_slot_levels[slot] = level;
+    this->place_instruction(free_position, instruction);
+}
+
+void LevelizedProgram::place_instruction(uint32_t position,
+                                         const Instruction &instruction)
+{
+    m_instructions[position] = instruction;
+    m_slot_positions[instruction.output] = position;
+}
+
+void LevelizedProgram::add_level()
+{
+    /* Copy the value first, because appending can reallocate. */
+    uint32_t end = m_level_starts.last();
+    m_level_starts.append(end);
+}
+
+}  // namespace gate_sim
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "bas/multi_map.h"
+
+#include "circuit.h"
+
+namespace gate_sim {
+
+using bas::MultiMap;
+
+enum class Opcode : uint8_t {
+    Constant0,
+    Constant1,
+    Buffer,
+    Not,
+    And,
+    Nand,
+    Or,
+    Nor,
+    Xor,
+    Xnor,
+    /* The first input is the data and the second input the enable signal. */
+    Tristate,
+};
+
+/**
+ * A single two-input operation. Unary operations ignore the second input.
+ * Inputs and output are slot indices. The first slots correspond to the nets
+ * of the circuit, the remaining slots hold temporary values.
+ */
+struct Instruction {
+    Opcode opcode;
+    uint32_t input1;
+    uint32_t input2;
+    uint32_t output;
+};
+
+/**
+ * A flip-flop that copies the input slot into the output slot at every clock
+ * edge.
+ */
+struct Register {
+    uint32_t input;
+    uint32_t output;
+};
+
+/**
+ * A range of instructions after the levelized instructions. The instructions
+ * of a loop form a combinational loop and have to be evaluated repeatedly
+ * until their values settle. Other segments are evaluated once in order.
+ */
+struct CyclicSegment {
+    uint32_t start;
+    uint32_t size;
+    bool is_loop;
+};
+
+/**
+ * The combinational logic of a circuit compiled into a flat list of
+ * instructions. Gates with more than two inputs are split up into a balanced
+ * tree of two-input instructions.
+ *
+ * The instructions are sorted by their topological level. All inputs of an
+ * instruction are computed by instructions in lower levels, so evaluating the
+ * instructions in order computes all values in a single pass. Instructions
+ * within the same level are independent of each other.
+ *
+ * Flip-flops are not part of the instructions. Their outputs are sources of
+ * the combinational logic, just like primary inputs, and their inputs are
+ * only read at clock edges.
+ *
+ * Instructions that are part of or depend on a combinational loop cannot be
+ * levelized. They come after the levelized instructions, split into segments
+ * in topological order of the loops (strongly connected components).
+ *
+ * Gates that are added to the circuit later can be added to the program
+ * without compiling it again. Only the instructions in the fan-out cone of
+ * the new gate change their level. Moving an instruction to another level
+ * moves one instruction per level in between, because the order within a
+ * level does not matter.
+ */
+class LevelizedProgram {
+  private:
+    Vector<Instruction> m_instructions;
+    /* Index of the first instruction of every level, followed by the total
+     * number of levelized instructions. */
+    Vector<uint32_t> m_level_starts;
+    Vector<Register> m_registers;
+    Vector<CyclicSegment> m_cyclic_segments;
+    uint32_t m_net_amount = 0;
+    uint32_t m_slot_amount = 0;
+
+    /* Slot of every net. Nets that are added later get slots after the
+     * temporary values. */
+    Vector<uint32_t> m_net_slots;
+    /* Level of the instruction that computes every slot. */
+    Vector<uint32_t> m_slot_levels;
+    /* Position of the instruction that computes every slot. */
+    Vector<uint32_t> m_slot_positions;
+    /* Output slots of the instructions that read every slot, in compressed
+     * sparse row format. Instructions added later are in the multi map. */
+    Vector<uint32_t> m_consumer_starts;
+    Vector<uint32_t> m_consumers;
+    MultiMap<uint32_t, uint32_t> m_added_consumers;
+
+  public:
+    static LevelizedProgram FromCircuit(const Circuit &circuit);
+
+    /**
+     * Update the program after a gate has been added to the circuit. Returns
+     * false and does not change the program when the gate is part of or
+     * depends on a combinational loop. Then the program has to be created
+     * again.
+     */
+    bool add_gate(const Circuit &circuit, GateId gate);
+
+    /**
+     * All instructions, the levelized ones followed by the cyclic ones.
+     */
+    ArrayRef<Instruction> instructions() const
+    {
+        return m_instructions;
+    }
+
+    size_t level_amount() const
+    {
+        return m_level_starts.size() - 1;
+    }
+
+    IndexRange level_range(size_t level) const
+    {
+        uint32_t start = m_level_starts[level];
+        return IndexRange(start, m_level_starts[level + 1] - start);
+    }
+
+    ArrayRef<Instruction> level_instructions(size_t level) const
+    {
+        return this->instructions().slice(this->level_range(level));
+    }
+
+    ArrayRef<Instruction> levelized_instructions() const
+    {
+        return this->instructions().take_front(m_level_starts.last());
+    }
+
+    /**
+     * Instructions that are part of or depend on a combinational loop.
+     */
+    ArrayRef<Instruction> cyclic_instructions() const
+    {
+        return this->instructions().drop_front(m_level_starts.last());
+    }
+
+    ArrayRef<CyclicSegment> cyclic_segments() const
+    {
+        return m_cyclic_segments;
+    }
+
+    ArrayRef<Instruction> segment_instructions(
+        const CyclicSegment &segment) const
+    {
+        return this->instructions().slice(segment.start, segment.size);
+    }
+
+    ArrayRef<Register> registers() const
+    {
+        return m_registers;
+    }
+
+    size_t net_amount() const
+    {
+        return m_net_amount;
+    }
+
+    uint32_t net_slot(NetId net) const
+    {
+        return m_net_slots[net];
+    }
+
+    /**
+     * Number of values that an evaluator has to store: one per net plus the
+     * temporary values.
+     */
+    size_t slot_amount() const
+    {
+        return m_slot_amount;
+    }
+
+  private:
+    uint32_t add_slot();
+    uint32_t compute_level(const Instruction &instruction) const;
+    bool cone_contains_slots(uint32_t slot, ArrayRef<uint32_t> slots) const;
+    void insert_instruction(const Instruction &instruction, uint32_t level);
+    void move_instruction_up(uint32_t slot, uint32_t level);
+    void place_instruction(uint32_t position, const Instruction &instruction);
+    void add_level();
+
+    template<typename FuncT>
+    void foreach_consumer(uint32_t slot, const FuncT &func) const
+    {
+        if (slot + 1 < m_consumer_starts.size()) {
+            for (uint32_t k = m_consumer_starts[slot];
+                 k < m_consumer_starts[slot + 1];
+                 k++) {
+                func(m_consumers[k]);
+            }
+        }
+        for (uint32_t consumer : m_added_consumers.lookup_default(slot)) {
+            func(consumer);
+        }
+    }
+};
+
+}  // namespace gate_sim
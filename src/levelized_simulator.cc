@@ -0,0 +1,201 @@
+#include <algorithm>
+
+#include "levelized_simulator.h"
+
+namespace gate_sim {
+
+/* Levels with fewer instructions are evaluated on the calling thread, because
+ * distributing them costs more than it saves. */
+static constexpr size_t MIN_PARALLEL_LEVEL_SIZE = 4096;
+static constexpr size_t MIN_CHUNK_SIZE = 1024;
+
+LevelizedSimulator::LevelizedSimulator(const Circuit &circuit,
+                                       InstructionSet instruction_set,
+                                       ThreadPool *thread_pool)
+    : m_program(LevelizedProgram::FromCircuit(circuit)),
+      m_instruction_set(instruction_set),
+      m_lane_words(instruction_set_lane_words(instruction_set)),
+      m_evaluate_fn(get_evaluate_instructions_fn(instruction_set)),
+      m_thread_pool(thread_pool)
+{
+    m_slots = nullptr;
+    m_next_slots = nullptr;
+    this->allocate_slots();
+
+    size_t max_loop_size = 0;
+    for (const CyclicSegment &segment : m_program.cyclic_segments()) {
+        if (segment.is_loop) {
+            max_loop_size = std::max<size_t>(max_loop_size, segment.size);
+        }
+    }
+    m_loop_values = Vector<uint64_t>(max_loop_size * m_lane_words);
+    this->simulate();
+}
+
+/**
+ * Make sure that the buffers have space for all slots of the program. Values
+ * of existing slots are kept and new slots are zero.
+ */
+void LevelizedSimulator::allocate_slots()
+{
+    size_t word_amount = m_program.slot_amount() * m_lane_words;
+    size_t line_amount = (word_amount + 7) / 8;
+    size_t old_line_amount = m_slot_lines[0].size();
+    if (line_amount <= old_line_amount && m_slots != nullptr) {
+        return;
+    }
+    /* Grow exponentially, so that adding many gates one by one is cheap.
+     * Always allocate at least one line, so that the pointers are valid. */
+    line_amount = std::max({line_amount, old_line_amount * 2, (size_t)1});
+    uint64_t *old_slots[2] = {m_slots, m_next_slots};
+    Array<CacheLine, 0> new_lines[2];
+    for (int i = 0; i < 2; i++) {
+        new_lines[i] = Array<CacheLine, 0>(line_amount);
+        if (old_slots[i] != nullptr) {
+            std::copy_n(old_slots[i],
+                        old_line_amount * 8,
+                        new_lines[i].begin()->words);
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        m_slot_lines[i] = std::move(new_lines[i]);
+    }
+    m_slots = m_slot_lines[0].begin()->words;
+    m_next_slots = m_slot_lines[1].begin()->words;
+}
+
+void LevelizedSimulator::set_net_lanes(NetId net, uint64_t lanes)
+{
+    this->net_words(net).fill(lanes);
+    MutableArrayRef<uint64_t>(
+        m_next_slots + m_program.net_slot(net) * m_lane_words, m_lane_words)
+        .fill(lanes);
+}
+
+uint64_t LevelizedSimulator::get_net_lanes(NetId net) const
+{
+    return this->net_words(net)[0];
+}
+
+void LevelizedSimulator::read_state(MutableArrayRef<uint64_t> r_words) const
+{
+    assert(r_words.size() == this->state_word_amount());
+    r_words.copy_from(m_slots);
+}
+
+void LevelizedSimulator::write_state(ArrayRef<uint64_t> words)
+{
+    assert(words.size() == this->state_word_amount());
+    std::copy_n(words.begin(), words.size(), m_slots);
+    std::copy_n(words.begin(), words.size(), m_next_slots);
+}
+
+bool LevelizedSimulator::add_gate(const Circuit &circuit, GateId gate)
+{
+    if (!m_program.add_gate(circuit, gate)) {
+        return false;
+    }
+    this->allocate_slots();
+    return true;
+}
+
+void LevelizedSimulator::simulate()
+{
+    if (m_thread_pool != nullptr && m_thread_pool->thread_amount() > 1) {
+        this->simulate_parallel();
+    }
+    else {
+        m_evaluate_fn(m_program.levelized_instructions(), m_slots);
+    }
+    this->simulate_cyclic();
+}
+
+void LevelizedSimulator::clock()
+{
+    for (const Register &reg : m_program.registers()) {
+        std::copy_n(m_slots + reg.input * m_lane_words,
+                    m_lane_words,
+                    m_next_slots + reg.output * m_lane_words);
+    }
+    /* Combinational loops can store values as well. */
+    for (const Instruction &instruction : m_program.cyclic_instructions()) {
+        std::copy_n(m_slots + instruction.output * m_lane_words,
+                    m_lane_words,
+                    m_next_slots + instruction.output * m_lane_words);
+    }
+    std::swap(m_slots, m_next_slots);
+}
+
+void LevelizedSimulator::simulate_parallel()
+{
+    uint64_t *slots = m_slots;
+    size_t thread_amount = m_thread_pool->thread_amount();
+
+    for (size_t level = 0; level < m_program.level_amount(); level++) {
+        ArrayRef<Instruction> instructions = m_program.level_instructions(
+            level);
+        if (instructions.size() < MIN_PARALLEL_LEVEL_SIZE) {
+            m_evaluate_fn(instructions, slots);
+            continue;
+        }
+
+        /* Use a few chunks per thread, so that threads that finish early can
+         * steal work from others. */
+        size_t grain_size = std::max(instructions.size() / (thread_amount * 4),
+                                     MIN_CHUNK_SIZE);
+        m_thread_pool->parallel_for(
+            IndexRange(instructions.size()),
+            grain_size,
+            [&](IndexRange range) {
+                m_evaluate_fn(instructions.slice(range), slots);
+            });
+    }
+}
+
+void LevelizedSimulator::simulate_cyclic()
+{
+    m_has_oscillation = false;
+    for (const CyclicSegment &segment : m_program.cyclic_segments()) {
+        ArrayRef<Instruction> instructions = m_program.segment_instructions(
+            segment);
+        if (!segment.is_loop) {
+            m_evaluate_fn(instructions, m_slots);
+        }
+        else if (!this->simulate_loop(instructions)) {
+            m_has_oscillation = true;
+        }
+    }
+}
+
+/**
+ * Returns false when the loop did not settle.
+ */
+bool LevelizedSimulator::simulate_loop(ArrayRef<Instruction> instructions)
+{
+    for (uint32_t iteration = 0; iteration < MAX_LOOP_ITERATIONS;
+         iteration++) {
+        for (size_t i : instructions.index_range()) {
+            std::copy_n(m_slots + instructions[i].output * m_lane_words,
+                        m_lane_words,
+                        m_loop_values.begin() + i * m_lane_words);
+        }
+        m_evaluate_fn(instructions, m_slots);
+        bool is_stable = true;
+        for (size_t i : instructions.index_range()) {
+            const uint64_t *old_words = m_loop_values.begin() +
+                                        i * m_lane_words;
+            const uint64_t *new_words = m_slots +
+                                        instructions[i].output * m_lane_words;
+            if (!std::equal(old_words, old_words + m_lane_words, new_words)) {
+                is_stable = false;
+                break;
+            }
+        }
+        if (is_stable) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace gate_sim
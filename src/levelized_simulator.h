@@ -0,0 +1,151 @@
+#pragma once
+
+#include "bas/array.h"
+
+#include "lane_kernels.h"
+#include "levelized_program.h"
+#include "simulator.h"
+#include "thread_pool.h"
+
+namespace gate_sim {
+
+using bas::Array;
+using bas::MutableArrayRef;
+
+/**
+ * Evaluates the entire circuit in a single linear pass over a levelized
+ * program. There is no event queue, so every gate is evaluated in every
+ * step. This is faster than event driven simulation when a large part of
+ * the circuit changes in every step.
+ *
+ * Every slot holds lane_word_amount consecutive 64 bit words, so that every
+ * instruction is a single vector operation that is evaluated for all lanes
+ * at once. The vector width is chosen based on the instruction sets that the
+ * CPU supports.
+ *
+ * When a thread pool is given, every level that is wide enough is split into
+ * chunks that are evaluated in parallel. The instructions within a level are
+ * independent, so threads only have to wait for each other between levels.
+ *
+ * Synchronous circuits are simulated cycle by cycle. There are two slot
+ * buffers: the flip-flop outputs in the current buffer are read by the
+ * combinational logic and a clock edge writes the flip-flop inputs into the
+ * next buffer. Then the buffers are swapped, so that there is no need to
+ * schedule events for individual flip-flops or to copy their values twice.
+ * Nets that are set from the outside are kept up to date in both buffers.
+ *
+ * Combinational loops are evaluated repeatedly until their values settle, at
+ * most MAX_LOOP_ITERATIONS times.
+ */
+class LevelizedSimulator : public Simulator {
+  private:
+    LevelizedProgram m_program;
+    InstructionSet m_instruction_set;
+    uint32_t m_lane_words;
+    EvaluateInstructionsFn m_evaluate_fn;
+    Array<CacheLine, 0> m_slot_lines[2];
+    uint64_t *m_slots;
+    uint64_t *m_next_slots;
+    ThreadPool *m_thread_pool;
+    /* Values of a loop before its last iteration. */
+    Vector<uint64_t> m_loop_values;
+    bool m_has_oscillation = false;
+
+  public:
+    LevelizedSimulator(
+        const Circuit &circuit,
+        InstructionSet instruction_set = best_instruction_set(),
+        ThreadPool *thread_pool = nullptr);
+
+    /**
+     * Set the same 64 lanes in every word of the net.
+     */
+    void set_net_lanes(NetId net, uint64_t lanes) override;
+
+    /**
+     * Get the lanes in the first word of the net.
+     */
+    uint64_t get_net_lanes(NetId net) const override;
+
+    void simulate() override;
+
+    void clock() override;
+
+    bool has_oscillation() const override
+    {
+        return m_has_oscillation;
+    }
+
+    /**
+     * All words of all slots, including temporary values.
+     */
+    size_t state_word_amount() const override
+    {
+        return m_program.slot_amount() * m_lane_words;
+    }
+
+    void read_state(MutableArrayRef<uint64_t> r_words) const override;
+    void write_state(ArrayRef<uint64_t> words) override;
+
+    /**
+     * All slots, including temporary values.
+     */
+    ArrayRef<uint64_t> value_words() const override
+    {
+        return ArrayRef<uint64_t>(m_slots, this->state_word_amount());
+    }
+
+    size_t net_value_word_index(NetId net) const override
+    {
+        return m_program.net_slot(net) * m_lane_words;
+    }
+
+    uint32_t net_value_word_amount() const override
+    {
+        return m_lane_words;
+    }
+
+    /**
+     * Gates that do not depend on a combinational loop are added to the
+     * program incrementally.
+     */
+    bool add_gate(const Circuit &circuit, GateId gate) override;
+
+    InstructionSet instruction_set() const
+    {
+        return m_instruction_set;
+    }
+
+    /**
+     * Number of 64 bit words that every net has. The total number of lanes
+     * is 64 times as large.
+     */
+    uint32_t lane_word_amount() const
+    {
+        return m_lane_words;
+    }
+
+    /**
+     * Access all words of a net. This allows setting different values in all
+     * lanes.
+     */
+    MutableArrayRef<uint64_t> net_words(NetId net)
+    {
+        return MutableArrayRef<uint64_t>(
+            m_slots + m_program.net_slot(net) * m_lane_words, m_lane_words);
+    }
+
+    ArrayRef<uint64_t> net_words(NetId net) const
+    {
+        return ArrayRef<uint64_t>(
+            m_slots + m_program.net_slot(net) * m_lane_words, m_lane_words);
+    }
+
+  private:
+    void allocate_slots();
+    void simulate_parallel();
+    void simulate_cyclic();
+    bool simulate_loop(ArrayRef<Instruction> instructions);
+};
+
+}  // namespace gate_sim
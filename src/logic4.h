@@ -0,0 +1,138 @@
+#pragma once
+
+#include "bas/utildefines.h"
+
+namespace gate_sim {
+
+using bas::uint64_t;
+using bas::uint8_t;
+
+enum class Logic4 : uint8_t {
+    Zero,
+    One,
+    /* Unknown value, e.g. of nets that have not been initialized. */
+    X,
+    /* High impedance, i.e. the net is not driven. */
+    Z,
+};
+
+inline char logic4_char(Logic4 value)
+{
+    switch (value) {
+        case Logic4::Zero:
+            return '0';
+        case Logic4::One:
+            return '1';
+        case Logic4::X:
+            return 'x';
+        case Logic4::Z:
+            return 'z';
+    }
+    assert(false);
+    return '?';
+}
+
+/**
+ * Four-valued logic for 64 lanes stored as two bit planes:
+ *
+ *        value  unknown
+ *   0      0       0
+ *   1      1       0
+ *   X      0       1
+ *   Z      1       1
+ *
+ * With this encoding every gate reduces to a few bitwise operations for all
+ * lanes. Gates never output Z, except for tri-state buffers. A Z at a gate
+ * input is treated like X.
+ */
+struct Logic4Word {
+    uint64_t value;
+    uint64_t unknown;
+
+    static Logic4Word Known(uint64_t value)
+    {
+        return {value, 0};
+    }
+
+    static Logic4Word AllX()
+    {
+        return {0, ~(uint64_t)0};
+    }
+
+    static Logic4Word AllZ()
+    {
+        return {~(uint64_t)0, ~(uint64_t)0};
+    }
+
+    uint64_t is_zero() const
+    {
+        return ~(value | unknown);
+    }
+
+    uint64_t is_one() const
+    {
+        return value & ~unknown;
+    }
+
+    Logic4 lane(uint32_t lane) const
+    {
+        bool v = (value >> lane) & 1;
+        bool u = (unknown >> lane) & 1;
+        if (u) {
+            return v ? Logic4::Z : Logic4::X;
+        }
+        return v ? Logic4::One : Logic4::Zero;
+    }
+};
+
+/**
+ * Build a word from the known lanes and the lanes that are one. Lanes that
+ * are neither become X.
+ */
+inline Logic4Word logic4_from_known(uint64_t is_one, uint64_t is_zero)
+{
+    return {is_one, ~(is_one | is_zero)};
+}
+
+inline Logic4Word logic4_buffer(Logic4Word a)
+{
+    return {a.is_one(), a.unknown};
+}
+
+inline Logic4Word logic4_not(Logic4Word a)
+{
+    return {a.is_zero(), a.unknown};
+}
+
+inline Logic4Word logic4_and(Logic4Word a, Logic4Word b)
+{
+    return logic4_from_known(a.is_one() & b.is_one(),
+                             a.is_zero() | b.is_zero());
+}
+
+inline Logic4Word logic4_or(Logic4Word a, Logic4Word b)
+{
+    return logic4_from_known(a.is_one() | b.is_one(),
+                             a.is_zero() & b.is_zero());
+}
+
+inline Logic4Word logic4_xor(Logic4Word a, Logic4Word b)
+{
+    uint64_t unknown = a.unknown | b.unknown;
+    return {(a.value ^ b.value) & ~unknown, unknown};
+}
+
+/**
+ * Outputs the data when enable is one and Z when enable is zero. The output
+ * is X when enable is unknown.
+ */
+inline Logic4Word logic4_tristate(Logic4Word data, Logic4Word enable)
+{
+    uint64_t enabled = enable.is_one();
+    uint64_t disabled = enable.is_zero();
+    Logic4Word buffered = logic4_buffer(data);
+    return {(enabled & buffered.value) | disabled,
+            (enabled & buffered.unknown) | ~enabled};
+}
+
+}  // namespace gate_sim
@@ -1,4 +1,11 @@
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <utility>
 
 #include "bas/map.h"
@@ -14,14 +21,48 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 
+#include "block_stream.h"
+#include "circuit.h"
+#include "circuit_image.h"
+#include "lane_kernels.h"
+#include "mapped_file.h"
+#include "simulation_history.h"
+#include "simulation_thread.h"
+#include "simulator.h"
+#include "toggle_coverage.h"
+#include "vcd_writer.h"
+#include "waveform_store.h"
+
 using bas::ArrayRef;
+using bas::IndexRange;
 using bas::Map;
 using bas::MultiMap;
 using bas::size_t;
+using bas::uint64_t;
 using bas::Stack;
 using bas::Vector;
 using bas::VectorSet;
 
+using gate_sim::BlockReader;
+using gate_sim::BlockWriter;
+using gate_sim::Circuit;
+using gate_sim::CircuitArrays;
+using gate_sim::FlatCircuit;
+using gate_sim::GateId;
+using gate_sim::GateType;
+using gate_sim::Logic4;
+using gate_sim::MappedFile;
+using gate_sim::NetId;
+using gate_sim::SimulationHistory;
+using gate_sim::SimulationSnapshot;
+using gate_sim::SimulationThread;
+using gate_sim::Simulator;
+using gate_sim::SimulatorType;
+using gate_sim::ToggleCoverage;
+using gate_sim::ToggleSummary;
+using gate_sim::VcdWriter;
+using gate_sim::WaveformStore;
+
 using uint = unsigned int;
 
 struct float2 {
@@ -85,6 +126,16 @@ class rectf {
     {
         return float2(xmax, ymin);
     }
+
+    float2 left_center() const
+    {
+        return float2(xmin, (ymin + ymax) * 0.5f);
+    }
+
+    float2 right_center() const
+    {
+        return float2(xmax, (ymin + ymax) * 0.5f);
+    }
 };
 
 ImVec2 to_im(float2 vec)
@@ -94,15 +145,66 @@ ImVec2 to_im(float2 vec)
 
 float2 box_size = {50, 50};
 
+static ImColor get_wire_color(Logic4 value)
+{
+    switch (value) {
+        case Logic4::Zero:
+            return ImColor(120, 120, 120);
+        case Logic4::One:
+            return ImColor(240, 240, 120);
+        case Logic4::X:
+            return ImColor(200, 120, 230);
+        case Logic4::Z:
+            return ImColor(100, 150, 240);
+    }
+    return ImColor(0, 0, 0);
+}
+
+static ImColor get_box_color(Logic4 value)
+{
+    switch (value) {
+        case Logic4::Zero:
+            return ImColor(230, 80, 80);
+        case Logic4::One:
+            return ImColor(80, 200, 80);
+        case Logic4::X:
+            return ImColor(150, 80, 200);
+        case Logic4::Z:
+            return ImColor(80, 120, 230);
+    }
+    return ImColor(0, 0, 0);
+}
+
+/**
+ * Every box represents the gate with the same index in the circuit.
+ */
 struct State {
+    Circuit circuit;
     Vector<float2> box_positions;
     Vector<bool> box_selections;
+    /* Only used for boxes that represent input gates. */
+    Vector<bool> box_input_values;
     int a = 0;
 
-    void add_box(float2 position)
+    /**
+     * Add a box with a new gate that reads the outputs of the given boxes.
+     */
+    GateId add_box(float2 position,
+                   GateType type,
+                   ArrayRef<GateId> input_boxes = {})
     {
+        Vector<NetId> inputs;
+        for (GateId box : input_boxes) {
+            inputs.append(circuit.gate_output(box));
+        }
+        NetId output = circuit.add_net();
+        GateId gate = circuit.add_gate(type, inputs, output);
+        assert(gate == box_positions.size());
+
         box_positions.append(position);
         box_selections.append(false);
+        box_input_values.append(false);
+        return gate;
     }
 
     rectf get_box_rect(size_t index)
@@ -115,6 +217,435 @@ static State state;
 
 static Stack<State> undo_stack;
 
+static SimulatorType simulator_type = SimulatorType::EventDriven;
+static std::unique_ptr<Simulator> simulator;
+static gate_sim::GateDelays gate_delays;
+static std::unique_ptr<SimulationHistory> history;
+/* Cycles that were simulated before the history was started. */
+static uint64_t history_start_cycle = 0;
+/* Owns the simulator while it exists. */
+static std::unique_ptr<SimulationThread> simulation_thread;
+static bool count_toggles = false;
+/* Only exists when toggles are counted. */
+static std::unique_ptr<ToggleCoverage> toggle_coverage;
+/* Only exists while a waveform is recorded. */
+static std::unique_ptr<VcdWriter> vcd_writer;
+static char vcd_path[256] = "waveform.vcd";
+/* Why the last recording could not be started, shown below the file. */
+static std::string vcd_error;
+static char state_path[256] = "scene.gss";
+/* Result of the last save or load, shown below the scene file. */
+static std::string state_file_message;
+static bool state_file_failed = false;
+/* History of the probed nets. Only exists when nets are probed. */
+static std::unique_ptr<WaveformStore> waveform_store;
+/* Visible part of the waveforms. */
+static double waveform_start_cycle = 0.0;
+static double waveform_cycles_per_pixel = 1.0 / 8.0;
+static bool waveform_follow = true;
+
+static Vector<uint64_t> get_input_lanes()
+{
+    Vector<uint64_t> input_lanes;
+    for (GateId gate : state.circuit.gates()) {
+        if (state.circuit.gate_type(gate) == GateType::Input) {
+            input_lanes.append(state.box_input_values[gate] ?
+                                   gate_sim::ALL_LANES :
+                                   0);
+        }
+    }
+    return input_lanes;
+}
+
+/**
+ * Clock edge and apply the current input values.
+ */
+static void next_cycle()
+{
+    history->next_cycle(get_input_lanes());
+    if (toggle_coverage) {
+        toggle_coverage->count_cycle();
+    }
+}
+
+static void previous_cycle()
+{
+    if (history->current_cycle() == 0) {
+        return;
+    }
+    history->go_to_cycle(history->current_cycle() - 1);
+
+    /* Show the inputs of that cycle. */
+    ArrayRef<uint64_t> input_lanes = history->cycle_inputs(
+        history->current_cycle());
+    size_t input_index = 0;
+    for (GateId gate : state.circuit.gates()) {
+        if (state.circuit.gate_type(gate) == GateType::Input) {
+            state.box_input_values[gate] = input_lanes[input_index++] & 1;
+        }
+    }
+}
+
+/**
+ * Has to be called whenever the circuit in the state or the simulator type
+ * changed.
+ */
+static void start_simulation_thread()
+{
+    simulation_thread = std::make_unique<SimulationThread>(
+        *simulator,
+        state.circuit,
+        history_start_cycle + history->current_cycle(),
+        toggle_coverage.get(),
+        vcd_writer.get(),
+        waveform_store.get());
+}
+
+/**
+ * Start a new history at the current state of the simulator. The previous
+ * history does not fit anymore when cycles were simulated without recording
+ * them or when the state layout changed.
+ */
+static void restart_history(uint64_t skipped_cycle_amount)
+{
+    history_start_cycle += history->current_cycle() + skipped_cycle_amount;
+    history = std::make_unique<SimulationHistory>(
+        *simulator, state.circuit.input_nets());
+    next_cycle();
+}
+
+/**
+ * Gives the simulator back to the history. Cycles that were simulated by
+ * the thread are not recorded, so the history starts again at the current
+ * state.
+ */
+static void stop_simulation_thread()
+{
+    simulation_thread->stop();
+    uint64_t simulated_cycle_amount =
+        simulation_thread->simulated_cycle_amount();
+    simulation_thread.reset();
+    if (simulated_cycle_amount > 0) {
+        restart_history(simulated_cycle_amount);
+    }
+}
+
+static void rebuild_simulator()
+{
+    simulation_thread.reset();
+    /* The cycles start again at zero. */
+    vcd_writer.reset();
+    waveform_store.reset();
+    simulator = gate_sim::create_simulator(
+        simulator_type, state.circuit, gate_delays);
+    toggle_coverage.reset();
+    if (count_toggles) {
+        toggle_coverage = std::make_unique<ToggleCoverage>(*simulator);
+    }
+    history = std::make_unique<SimulationHistory>(
+        *simulator, state.circuit.input_nets());
+    history_start_cycle = 0;
+    next_cycle();
+    start_simulation_thread();
+}
+
+/**
+ * Has to be called after State::add_box. Most simulators only update the
+ * part of the compiled circuit that is affected by the new gate, which is
+ * much faster than recreating them for large circuits.
+ */
+static void update_simulator_for_new_box(GateId box)
+{
+    stop_simulation_thread();
+    if (!simulator->add_gate(state.circuit, box)) {
+        rebuild_simulator();
+        return;
+    }
+    restart_history(0);
+    start_simulation_thread();
+}
+
+static void step_cycle(bool forward)
+{
+    stop_simulation_thread();
+    if (forward) {
+        next_cycle();
+    }
+    else {
+        previous_cycle();
+    }
+    start_simulation_thread();
+}
+
+static void set_count_toggles(bool new_count_toggles)
+{
+    stop_simulation_thread();
+    count_toggles = new_count_toggles;
+    toggle_coverage.reset();
+    if (count_toggles) {
+        toggle_coverage = std::make_unique<ToggleCoverage>(*simulator);
+        toggle_coverage->count_cycle();
+    }
+    start_simulation_thread();
+}
+
+/**
+ * Record the output nets of the selected boxes.
+ */
+static void start_vcd_recording()
+{
+    Vector<NetId> nets;
+    for (GateId box : state.circuit.gates()) {
+        if (state.box_selections[box]) {
+            nets.append(state.circuit.gate_output(box));
+        }
+    }
+    stop_simulation_thread();
+    vcd_error.clear();
+    vcd_writer = VcdWriter::Open(vcd_path, state.circuit, nets, vcd_error);
+    start_simulation_thread();
+}
+
+static void stop_vcd_recording()
+{
+    stop_simulation_thread();
+    vcd_writer.reset();
+    start_simulation_thread();
+}
+
+/**
+ * Replace the probed nets with the output nets of the selected boxes.
+ */
+static void probe_selected_boxes()
+{
+    Vector<NetId> nets;
+    for (GateId box : state.circuit.gates()) {
+        if (state.box_selections[box]) {
+            nets.append(state.circuit.gate_output(box));
+        }
+    }
+    stop_simulation_thread();
+    waveform_store.reset();
+    if (!nets.is_empty()) {
+        waveform_store = std::make_unique<WaveformStore>(nets);
+    }
+    start_simulation_thread();
+}
+
+/**
+ * Draw a part of a trace in which the signal takes the values in the mask.
+ * Parts with a single value are drawn as line at the height of the value,
+ * parts with transitions are filled.
+ */
+static void draw_waveform_segment(ImDrawList *draw_list,
+                                  float x_start,
+                                  float x_end,
+                                  float y_top,
+                                  float y_bottom,
+                                  uint8_t mask,
+                                  uint8_t previous_mask)
+{
+    if (mask == 0) {
+        return;
+    }
+    if ((mask & (mask - 1)) != 0) {
+        draw_list->AddRectFilled(ImVec2(x_start, y_top),
+                                 ImVec2(x_end, y_bottom),
+                                 ImColor(170, 200, 150));
+        return;
+    }
+    Logic4 value = Logic4::Zero;
+    while ((mask & WaveformStore::value_mask(value)) == 0) {
+        value = (Logic4)((int)value + 1);
+    }
+    ImColor color = get_wire_color(value);
+    switch (value) {
+        case Logic4::Zero:
+            draw_list->AddLine(
+                ImVec2(x_start, y_bottom), ImVec2(x_end, y_bottom), color);
+            break;
+        case Logic4::One:
+            draw_list->AddLine(
+                ImVec2(x_start, y_top), ImVec2(x_end, y_top), color);
+            break;
+        case Logic4::X:
+            draw_list->AddRectFilled(
+                ImVec2(x_start, y_top), ImVec2(x_end, y_bottom), color);
+            break;
+        case Logic4::Z: {
+            float y_middle = (y_top + y_bottom) * 0.5f;
+            draw_list->AddLine(
+                ImVec2(x_start, y_middle), ImVec2(x_end, y_middle), color);
+            break;
+        }
+    }
+    if (previous_mask != 0 && previous_mask != mask) {
+        draw_list->AddLine(ImVec2(x_start, y_top),
+                           ImVec2(x_start, y_bottom),
+                           ImColor(200, 200, 200));
+    }
+}
+
+/**
+ * Draws the probed nets over time. The traces are drawn from the summaries
+ * of the waveform store with one value mask per pixel, so the number of
+ * primitives depends on the width of the window, not on the number of
+ * changes.
+ */
+static void draw_waveform_window()
+{
+    if (!waveform_store) {
+        return;
+    }
+    const float name_width = 100.0f;
+    const float row_height = 20.0f;
+    const float row_padding = 4.0f;
+
+    ImGui::Begin("Waveforms");
+    ImGui::Checkbox("Follow", &waveform_follow);
+    uint64_t start_cycle = waveform_store->start_cycle();
+    uint64_t end_cycle = waveform_store->end_cycle();
+    ArrayRef<NetId> nets = waveform_store->nets();
+
+    ImDrawList *draw_list = ImGui::GetWindowDrawList();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = std::max(ImGui::GetContentRegionAvail().x, name_width + 1);
+    float trace_x = origin.x + name_width;
+    float trace_width = width - name_width;
+    ImGui::InvisibleButton("Traces",
+                           ImVec2(width, row_height * (float)nets.size()));
+
+    /* Zoom around the mouse with the wheel and pan by dragging. */
+    ImGuiIO &io = ImGui::GetIO();
+    if (ImGui::IsItemHovered() && io.MouseWheel != 0.0f) {
+        double mouse_offset = io.MousePos.x - trace_x;
+        double mouse_cycle = waveform_start_cycle +
+                             mouse_offset * waveform_cycles_per_pixel;
+        waveform_cycles_per_pixel = std::clamp(
+            waveform_cycles_per_pixel * std::pow(1.25, -io.MouseWheel),
+            1.0 / 32.0,
+            1e9);
+        waveform_start_cycle = mouse_cycle -
+                               mouse_offset * waveform_cycles_per_pixel;
+    }
+    if (ImGui::IsItemActive() && ImGui::IsMouseDragging(0)) {
+        waveform_start_cycle -= io.MouseDelta.x * waveform_cycles_per_pixel;
+        waveform_follow = false;
+    }
+    if (waveform_follow) {
+        waveform_start_cycle = (double)end_cycle -
+                               trace_width * waveform_cycles_per_pixel;
+    }
+    waveform_start_cycle = std::max(waveform_start_cycle,
+                                    (double)start_cycle);
+
+    /* Every range of cycles becomes a part of the trace. When zoomed out,
+     * ranges are one pixel wide, otherwise they are one cycle long. */
+    uint64_t cycles_per_range = 1;
+    float range_width = (float)(1.0 / waveform_cycles_per_pixel);
+    if (waveform_cycles_per_pixel >= 1.0) {
+        cycles_per_range = (uint64_t)waveform_cycles_per_pixel;
+        range_width = (float)((double)cycles_per_range /
+                              waveform_cycles_per_pixel);
+    }
+    /* Ranges start at multiples of their length, so that they do not
+     * change while panning. */
+    uint64_t first_cycle = (uint64_t)waveform_start_cycle /
+                           cycles_per_range * cycles_per_range;
+    float first_x = trace_x + (float)(((double)first_cycle -
+                                       waveform_start_cycle) /
+                                      waveform_cycles_per_pixel);
+    uint32_t range_amount = (uint32_t)(trace_width / range_width) + 2;
+
+    Vector<uint8_t> masks;
+    for (uint32_t i = 0; i < nets.size(); i++) {
+        float y_top = origin.y + i * row_height + row_padding;
+        float y_bottom = origin.y + (i + 1) * row_height - row_padding;
+        const std::string &name = state.circuit.net_name(nets[i]);
+        std::string label = name.empty() ? "Net " + std::to_string(nets[i]) :
+                                           name;
+        draw_list->AddText(
+            ImVec2(origin.x, y_top), IM_COL32_WHITE, label.c_str());
+
+        draw_list->PushClipRect(ImVec2(trace_x, origin.y),
+                                ImVec2(trace_x + trace_width,
+                                       origin.y + nets.size() * row_height),
+                                true);
+        waveform_store->summarize_ranges(
+            i, first_cycle, cycles_per_range, range_amount, masks);
+        uint8_t previous_mask = 0;
+        size_t segment_start = 0;
+        while (segment_start < masks.size()) {
+            size_t segment_end = segment_start + 1;
+            while (segment_end < masks.size() &&
+                   masks[segment_end] == masks[segment_start]) {
+                segment_end++;
+            }
+            draw_waveform_segment(draw_list,
+                                  first_x + segment_start * range_width,
+                                  first_x + segment_end * range_width,
+                                  y_top,
+                                  y_bottom,
+                                  masks[segment_start],
+                                  previous_mask);
+            previous_mask = masks[segment_start];
+            segment_start = segment_end;
+        }
+        draw_list->PopClipRect();
+    }
+
+    if (ImGui::IsItemHovered()) {
+        double mouse_cycle = waveform_start_cycle +
+                             (io.MousePos.x - trace_x) *
+                                 waveform_cycles_per_pixel;
+        ImGui::SetTooltip("Cycle %llu",
+                          (unsigned long long)std::max(mouse_cycle, 0.0));
+    }
+    ImGui::End();
+}
+
+static void draw_toggle_coverage(const ToggleSummary &summary)
+{
+    double percent = summary.net_amount == 0 ?
+                         100.0 :
+                         100.0 * summary.covered_net_amount /
+                             summary.net_amount;
+    ImGui::Text("Covered: %u/%u nets (%.1f%%)",
+                summary.covered_net_amount,
+                summary.net_amount,
+                percent);
+    ImGui::Text("Toggles: %llu in %llu cycles",
+                (unsigned long long)summary.toggle_amount,
+                (unsigned long long)summary.cycle_amount);
+
+    Vector<float> histogram;
+    for (uint32_t amount : summary.histogram) {
+        histogram.append((float)amount);
+    }
+    ImGui::PlotHistogram("Nets by log2 toggles",
+                         histogram.begin(),
+                         (int)histogram.size(),
+                         0,
+                         nullptr,
+                         0.0f,
+                         FLT_MAX,
+                         ImVec2(0.0f, 60.0f));
+
+    ImGui::Text("Never toggled: %u", summary.never_toggled_net_amount);
+    for (NetId net : summary.never_toggled_nets) {
+        GateId driver = state.circuit.net_driver(net);
+        const char *driver_name = driver == gate_sim::NO_GATE ?
+                                      "undriven" :
+                                      gate_sim::gate_type_name(
+                                          state.circuit.gate_type(driver));
+        ImGui::BulletText("Net %u (%s)", net, driver_name);
+    }
+    if (summary.never_toggled_nets.size() <
+        summary.never_toggled_net_amount) {
+        ImGui::BulletText("...");
+    }
+}
+
 static void push_undo_step()
 {
     undo_stack.push(state);
@@ -130,6 +661,7 @@ static void pop_undo_step()
 
     undo_stack.pop();
     state = undo_stack.peek();
+    rebuild_simulator();
     std::cout << "Pop undo step\n";
 }
 
@@ -140,11 +672,231 @@ static void push_undo_after_edit()
     }
 }
 
+/* Files start with the magic and the version, which is increased whenever
+ * the layout changes. */
+static constexpr char STATE_FILE_MAGIC[8] = {
+    'G', 'S', 'S', 'C', 'E', 'N', 'E', '\0'};
+static constexpr uint32_t STATE_FILE_VERSION = 2;
+
+static void write_circuit_blocks(BlockWriter &writer, const Circuit &circuit)
+{
+    FlatCircuit flat_circuit(circuit);
+    CircuitArrays arrays = flat_circuit.arrays();
+    writer.write_array(arrays.gate_types);
+    writer.write_array(arrays.gate_input_starts);
+    writer.write_array(arrays.gate_input_nets);
+    writer.write_array(arrays.gate_outputs);
+    writer.write_array(arrays.name_starts);
+    writer.write_array(arrays.name_chars);
+    writer.write_array(arrays.output_nets);
+}
+
+static bool read_circuit_blocks(BlockReader &reader,
+                                Circuit &r_circuit,
+                                std::string &r_error)
+{
+    /* The arrays point into the file. */
+    CircuitArrays arrays;
+    if (!reader.read_array_ref(arrays.gate_types) ||
+        !reader.read_array_ref(arrays.gate_input_starts) ||
+        !reader.read_array_ref(arrays.gate_input_nets) ||
+        !reader.read_array_ref(arrays.gate_outputs) ||
+        !reader.read_array_ref(arrays.name_starts) ||
+        !reader.read_array_ref(arrays.name_chars) ||
+        !reader.read_array_ref(arrays.output_nets)) {
+        r_error = "the file is truncated";
+        return false;
+    }
+    std::optional<Circuit> circuit = circuit_from_arrays(arrays, r_error);
+    if (!circuit) {
+        return false;
+    }
+    r_circuit = std::move(*circuit);
+    return true;
+}
+
+/**
+ * Flags are stored as one byte each, so that files with other values can be
+ * detected instead of being read into bools.
+ */
+static Vector<uint8_t> flags_to_bytes(const Vector<bool> &flags)
+{
+    Vector<uint8_t> bytes;
+    bytes.reserve(flags.size());
+    for (bool flag : flags) {
+        bytes.append_unchecked(flag ? 1 : 0);
+    }
+    return bytes;
+}
+
+static bool read_flags(BlockReader &reader, Vector<bool> &r_flags)
+{
+    ArrayRef<uint8_t> bytes;
+    if (!reader.read_array_ref(bytes)) {
+        return false;
+    }
+    r_flags.clear();
+    r_flags.reserve(bytes.size());
+    for (uint8_t byte : bytes) {
+        if (byte > 1) {
+            return false;
+        }
+        r_flags.append_unchecked(byte == 1);
+    }
+    return true;
+}
+
+/**
+ * Every array is written as one block, so that saving large scenes is
+ * limited by the disk and not by the number of boxes.
+ */
+static bool save_state(const char *path, std::string &r_error)
+{
+    std::unique_ptr<BlockWriter> writer = BlockWriter::Open(path, r_error);
+    if (!writer) {
+        return false;
+    }
+    writer->write_bytes(STATE_FILE_MAGIC, sizeof(STATE_FILE_MAGIC));
+    writer->write(STATE_FILE_VERSION);
+    writer->write(state.a);
+    writer->write_array(state.box_positions.as_ref());
+    writer->write_array(flags_to_bytes(state.box_selections).as_ref());
+    writer->write_array(flags_to_bytes(state.box_input_values).as_ref());
+    write_circuit_blocks(*writer, state.circuit);
+    return writer->close(r_error);
+}
+
+static bool load_state(const char *path, State &r_state, std::string &r_error)
+{
+    std::unique_ptr<MappedFile> file = MappedFile::Open(path, r_error);
+    if (!file) {
+        return false;
+    }
+    BlockReader reader(file->data());
+    const uint8_t *magic;
+    uint32_t version;
+    if (!reader.read_bytes(sizeof(STATE_FILE_MAGIC), magic) ||
+        memcmp(magic, STATE_FILE_MAGIC, sizeof(STATE_FILE_MAGIC)) != 0 ||
+        !reader.read(version)) {
+        r_error = "not a saved scene";
+        return false;
+    }
+    if (version != STATE_FILE_VERSION) {
+        r_error = "unsupported version " + std::to_string(version);
+        return false;
+    }
+    if (!reader.read(r_state.a) ||
+        !reader.read_array(r_state.box_positions)) {
+        r_error = "the file is truncated";
+        return false;
+    }
+    if (!read_flags(reader, r_state.box_selections) ||
+        !read_flags(reader, r_state.box_input_values)) {
+        r_error = "invalid box flags";
+        return false;
+    }
+    if (!read_circuit_blocks(reader, r_state.circuit, r_error)) {
+        return false;
+    }
+    size_t box_amount = r_state.circuit.gate_amount();
+    if (r_state.box_positions.size() != box_amount ||
+        r_state.box_selections.size() != box_amount ||
+        r_state.box_input_values.size() != box_amount) {
+        r_error = "the boxes do not match the circuit";
+        return false;
+    }
+    return true;
+}
+
+static void save_state_file()
+{
+    auto start_time = std::chrono::steady_clock::now();
+    std::string error;
+    state_file_failed = !save_state(state_path, error);
+    if (state_file_failed) {
+        state_file_message = error;
+        return;
+    }
+    std::chrono::duration<double, std::milli> duration =
+        std::chrono::steady_clock::now() - start_time;
+    std::stringstream message;
+    message << "Saved " << state.box_positions.size() << " boxes in "
+            << duration.count() << " ms";
+    state_file_message = message.str();
+}
+
+static void load_state_file()
+{
+    State new_state;
+    std::string error;
+    state_file_failed = !load_state(state_path, new_state, error);
+    if (state_file_failed) {
+        state_file_message = error;
+        return;
+    }
+    state_file_message = "Loaded " +
+                         std::to_string(new_state.box_positions.size()) +
+                         " boxes";
+    state = std::move(new_state);
+    push_undo_step();
+    rebuild_simulator();
+}
+
 static bool is_key_down(GLFWwindow *window, int key)
 {
     return glfwGetKey(window, key) == GLFW_PRESS;
 }
 
+static void toggle_input_box(GateId box)
+{
+    bool value = !state.box_input_values[box];
+    state.box_input_values[box] = value;
+    simulation_thread->set_input_lanes(get_input_lanes());
+    push_undo_step();
+}
+
+/**
+ * Add a gate that reads the outputs of all selected boxes.
+ */
+static void add_box_for_selection(GateType type)
+{
+    Vector<GateId> input_boxes;
+    float2 position = {20, 20};
+    for (size_t i : state.box_positions.index_range()) {
+        if (state.box_selections[i]) {
+            input_boxes.append((GateId)i);
+            position.x = std::max(position.x,
+                                  state.box_positions[i].x + 100);
+            position.y = state.box_positions[i].y;
+        }
+    }
+    if (!gate_sim::gate_type_supports_input_amount(type, input_boxes.size())) {
+        std::cout << "Wrong number of selected inputs\n";
+        return;
+    }
+
+    GateId box = state.add_box(position, type, input_boxes);
+    state.box_selections.fill(false);
+    push_undo_step();
+    update_simulator_for_new_box(box);
+}
+
+static bool get_gate_type_name(void *data, int index, const char **r_name)
+{
+    BAS_UNUSED_VAR(data);
+    *r_name = gate_sim::gate_type_name((GateType)index);
+    return true;
+}
+
+static bool get_simulator_type_name(void *data,
+                                    int index,
+                                    const char **r_name)
+{
+    BAS_UNUSED_VAR(data);
+    *r_name = gate_sim::simulator_type_name((SimulatorType)index);
+    return true;
+}
+
 int main()
 {
     if (!glfwInit()) {
@@ -165,6 +917,10 @@ int main()
 
     gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
     std::cout << "OpenGL: " << glGetString(GL_VERSION) << "\n";
+    std::cout << "Instruction Set: "
+              << gate_sim::instruction_set_name(
+                     gate_sim::best_instruction_set())
+              << "\n";
 
     ImGui::CreateContext();
     ImGui::StyleColorsDark();
@@ -176,9 +932,16 @@ int main()
     // double last_mouse_x = 0.0f;
     // double last_mouse_y = 0.0f;
 
-    state.add_box({100, 100});
-    state.add_box({400, 200});
+    {
+        GateId a = state.add_box({100, 100}, GateType::Input);
+        GateId b = state.add_box({100, 250}, GateType::Input);
+        GateId gate = state.add_box({300, 175}, GateType::And, {a, b});
+        state.add_box({500, 175}, GateType::Not, {gate});
+    }
     push_undo_step();
+    rebuild_simulator();
+
+    int new_gate_type = (int)GateType::And;
 
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
@@ -212,11 +975,40 @@ int main()
 
         ImGui::NewFrame();
 
+        if (!imgui_uses_mouse && ImGui::IsMouseDoubleClicked(0)) {
+            for (GateId box : state.circuit.gates()) {
+                if (state.circuit.gate_type(box) == GateType::Input &&
+                    state.get_box_rect(box).contains(mouse_position)) {
+                    toggle_input_box(box);
+                }
+            }
+        }
+
+        const SimulationSnapshot &snapshot =
+            simulation_thread->read_snapshot();
+
         {
             ImDrawList *draw_list = ImGui::GetBackgroundDrawList();
+            for (GateId gate : state.circuit.gates()) {
+                rectf box = state.get_box_rect(gate);
+                for (NetId net : state.circuit.gate_inputs(gate)) {
+                    GateId driver = state.circuit.net_driver(net);
+                    if (driver == gate_sim::NO_GATE) {
+                        continue;
+                    }
+                    rectf driver_box = state.get_box_rect(driver);
+                    ImColor color = get_wire_color(
+                        snapshot.net_values[net]);
+                    draw_list->AddLine(to_im(driver_box.right_center()),
+                                       to_im(box.left_center()),
+                                       color,
+                                       2.0f);
+                }
+            }
             for (size_t i : state.box_positions.index_range()) {
                 rectf box = state.get_box_rect(i);
-                ImColor color = ImColor(230, 80, 80);
+                ImColor color = get_box_color(
+                    snapshot.net_values[state.circuit.gate_output((GateId)i)]);
                 if (state.box_selections[i]) {
                     color.Value.x *= 0.6f;
                 }
@@ -226,6 +1018,10 @@ int main()
 
                 draw_list->AddRectFilled(
                     to_im(box.upper_left()), to_im(box.lower_right()), color);
+                draw_list->AddText(
+                    to_im(state.box_positions[i]),
+                    IM_COL32_WHITE,
+                    gate_sim::gate_type_name(state.circuit.gate_type(i)));
             }
         }
 
@@ -263,11 +1059,142 @@ int main()
 
         // ImGui::PopStyleVar();
 
+        /* The buttons below can replace the simulation thread, which
+         * invalidates the snapshot. */
+        uint64_t cycle = snapshot.cycle;
+        double cycles_per_second = snapshot.cycles_per_second;
+        bool has_oscillation = snapshot.has_oscillation;
+        bool has_toggle_summary = snapshot.has_toggle_summary;
+        ToggleSummary toggle_summary = snapshot.toggle_summary;
+
         ImGui::Begin("Other Window");
         ImGui::SliderInt("A", &state.a, 0, 100);
         push_undo_after_edit();
+        ImGui::Combo("Gate",
+                     &new_gate_type,
+                     get_gate_type_name,
+                     nullptr,
+                     (int)gate_sim::GATE_TYPE_AMOUNT);
+        if (ImGui::Button("Add Gate")) {
+            add_box_for_selection((GateType)new_gate_type);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Clear Selection")) {
+            state.box_selections.fill(false);
+        }
+        bool is_running = simulation_thread->is_running();
+        if (is_running) {
+            if (ImGui::Button("Stop")) {
+                stop_simulation_thread();
+                start_simulation_thread();
+            }
+            ImGui::SameLine();
+            ImGui::Text("Cycle: %llu (%.0f cycles/s)",
+                        (unsigned long long)cycle,
+                        cycles_per_second);
+        }
+        else {
+            if (ImGui::Button("Previous Cycle")) {
+                step_cycle(false);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Next Cycle")) {
+                step_cycle(true);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Run")) {
+                simulation_thread->set_running(true);
+            }
+            ImGui::SameLine();
+            ImGui::Text("Cycle: %llu", (unsigned long long)cycle);
+        }
+        if (has_oscillation) {
+            ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f),
+                               "A combinational loop oscillates");
+        }
+        int simulator_type_index = (int)simulator_type;
+        if (ImGui::Combo("Simulator",
+                         &simulator_type_index,
+                         get_simulator_type_name,
+                         nullptr,
+                         (int)gate_sim::SIMULATOR_TYPE_AMOUNT)) {
+            simulator_type = (SimulatorType)simulator_type_index;
+            rebuild_simulator();
+        }
+        if (simulator_type == SimulatorType::Timing &&
+            ImGui::CollapsingHeader("Gate Delays")) {
+            for (uint i = 0; i < gate_sim::GATE_TYPE_AMOUNT; i++) {
+                GateType type = (GateType)i;
+                int delay = (int)gate_delays.get(type);
+                if (ImGui::InputInt(gate_sim::gate_type_name(type), &delay)) {
+                    gate_delays.set(type, (uint)std::max(delay, 1));
+                    rebuild_simulator();
+                }
+            }
+        }
+        if (ImGui::CollapsingHeader("Scene")) {
+            ImGui::InputText("Scene File", state_path, sizeof(state_path));
+            if (ImGui::Button("Save")) {
+                save_state_file();
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Load")) {
+                load_state_file();
+            }
+            if (state_file_failed) {
+                ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f),
+                                   "%s",
+                                   state_file_message.c_str());
+            }
+            else if (!state_file_message.empty()) {
+                ImGui::Text("%s", state_file_message.c_str());
+            }
+        }
+        if (ImGui::CollapsingHeader("Waveform")) {
+            if (vcd_writer) {
+                ImGui::Text("Recording to %s", vcd_path);
+                if (ImGui::Button("Stop Recording")) {
+                    stop_vcd_recording();
+                }
+            }
+            else {
+                ImGui::InputText("File", vcd_path, sizeof(vcd_path));
+                if (ImGui::Button("Record Selected Gates")) {
+                    start_vcd_recording();
+                }
+                if (!vcd_error.empty()) {
+                    ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f),
+                                       "%s",
+                                       vcd_error.c_str());
+                }
+            }
+        }
+        if (ImGui::CollapsingHeader("Probes")) {
+            if (ImGui::Button("Probe Selected Gates")) {
+                probe_selected_boxes();
+            }
+            if (waveform_store) {
+                uint64_t cycle_amount = waveform_store->end_cycle() -
+                                        waveform_store->start_cycle();
+                ImGui::Text("%u nets, %llu cycles, %.2f MB",
+                            (uint)waveform_store->nets().size(),
+                            (unsigned long long)cycle_amount,
+                            waveform_store->memory_size() / 1e6);
+            }
+        }
+        if (ImGui::CollapsingHeader("Toggle Coverage")) {
+            bool new_count_toggles = count_toggles;
+            if (ImGui::Checkbox("Count Toggles", &new_count_toggles)) {
+                set_count_toggles(new_count_toggles);
+            }
+            else if (has_toggle_summary) {
+                draw_toggle_coverage(toggle_summary);
+            }
+        }
         ImGui::End();
 
+        draw_waveform_window();
+
         ImGui::Render();
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -279,6 +1206,8 @@ int main()
         // last_mouse_y = mouse_y;
     }
 
+    simulation_thread.reset();
+
     ImGui_ImplGlfw_Shutdown();
     glfwDestroyWindow(window);
     glfwTerminate();
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#    define NOMINMAX
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+
+namespace gate_sim {
+
+#ifdef _WIN32
+
+std::unique_ptr<MappedFile> MappedFile::Open(const char *path,
+                                             std::string &r_error)
+{
+    std::unique_ptr<MappedFile> file(new MappedFile());
+    HANDLE file_handle = CreateFileA(path,
+                                     GENERIC_READ,
+                                     FILE_SHARE_READ,
+                                     nullptr,
+                                     OPEN_EXISTING,
+                                     FILE_FLAG_SEQUENTIAL_SCAN,
+                                     nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        r_error = "cannot open file";
+        return {};
+    }
+    file->m_file_handle = file_handle;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_handle, &size)) {
+        r_error = "cannot get file size";
+        return {};
+    }
+    file->m_size = (size_t)size.QuadPart;
+    if (file->m_size == 0) {
+        return file;
+    }
+    HANDLE mapping_handle = CreateFileMappingA(
+        file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_handle == nullptr) {
+        r_error = "cannot map file";
+        return {};
+    }
+    file->m_mapping_handle = mapping_handle;
+    file->m_data = (const uint8_t *)MapViewOfFile(
+        mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    if (file->m_data == nullptr) {
+        r_error = "cannot map file";
+        return {};
+    }
+    return file;
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data != nullptr) {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping_handle != nullptr) {
+        CloseHandle(m_mapping_handle);
+    }
+    if (m_file_handle != nullptr) {
+        CloseHandle(m_file_handle);
+    }
+}
+
+/* The file has been opened for sequential scanning already. */
+void MappedFile::advise_sequential()
+{
+}
+
+void MappedFile::advise_done(size_t offset, size_t size)
+{
+    BAS_UNUSED_VAR(offset);
+    BAS_UNUSED_VAR(size);
+}
+
+#else
+
+std::unique_ptr<MappedFile> MappedFile::Open(const char *path,
+                                             std::string &r_error)
+{
+    std::unique_ptr<MappedFile> file(new MappedFile());
+    file->m_file_descriptor = open(path, O_RDONLY);
+    if (file->m_file_descriptor == -1) {
+        r_error = strerror(errno);
+        return {};
+    }
+    struct stat stat_buffer;
+    if (fstat(file->m_file_descriptor, &stat_buffer) != 0) {
+        r_error = strerror(errno);
+        return {};
+    }
+    file->m_size = (size_t)stat_buffer.st_size;
+    /* Mapping zero bytes fails. */
+    if (file->m_size == 0) {
+        return file;
+    }
+    void *data = mmap(nullptr,
+                      file->m_size,
+                      PROT_READ,
+                      MAP_PRIVATE,
+                      file->m_file_descriptor,
+                      0);
+    if (data == MAP_FAILED) {
+        r_error = strerror(errno);
+        return {};
+    }
+    file->m_data = (const uint8_t *)data;
+    return file;
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data != nullptr) {
+        munmap((void *)m_data, m_size);
+    }
+    if (m_file_descriptor != -1) {
+        close(m_file_descriptor);
+    }
+}
+
+void MappedFile::advise_sequential()
+{
+    if (m_data != nullptr) {
+        madvise((void *)m_data, m_size, MADV_SEQUENTIAL);
+    }
+}
+
+void MappedFile::advise_done(size_t offset, size_t size)
+{
+    /* Only whole pages can be dropped. */
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = (offset + page_size - 1) / page_size * page_size;
+    size_t end = std::min(offset + size, m_size) / page_size * page_size;
+    if (m_data != nullptr && start < end) {
+        madvise((void *)(m_data + start), end - start, MADV_DONTNEED);
+    }
+}
+
+#endif
+
+}  // namespace gate_sim
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "bas/array_ref.h"
+
+namespace gate_sim {
+
+using bas::ArrayRef;
+using bas::size_t;
+using bas::uint8_t;
+
+/**
+ * A file that is mapped into memory for reading. Nothing is read until the
+ * memory is accessed, and pages that have been read can be dropped by the
+ * operating system again. This allows processing files that are much larger
+ * than the main memory.
+ *
+ * Requires a 64 bit address space for files larger than a few GB.
+ */
+class MappedFile : bas::NonCopyable, bas::NonMovable {
+  private:
+    const uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void *m_file_handle = nullptr;
+    void *m_mapping_handle = nullptr;
+#else
+    int m_file_descriptor = -1;
+#endif
+
+  public:
+    /**
+     * Returns null and sets the error message when the file cannot be
+     * mapped. The file should not be changed while it is mapped.
+     */
+    static std::unique_ptr<MappedFile> Open(const char *path,
+                                            std::string &r_error);
+
+    ~MappedFile();
+
+    ArrayRef<uint8_t> data() const
+    {
+        return ArrayRef<uint8_t>(m_data, m_size);
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * Tell the operating system that the file is read from front to back,
+     * so that it reads ahead aggressively and drops pages behind the read
+     * position first.
+     */
+    void advise_sequential();
+
+    /**
+     * Tell the operating system that the given range is not needed anymore.
+     * It is read again from the file when it is accessed later.
+     */
+    void advise_done(size_t offset, size_t size);
+
+  private:
+    MappedFile() = default;
+};
+
+}  // namespace gate_sim
@@ -0,0 +1,107 @@
+#include "netlist.h"
+#include "simulator.h"
+
+namespace gate_sim {
+
+Netlist Netlist::FromCircuit(const Circuit &circuit)
+{
+    size_t gate_amount = circuit.gate_amount();
+    size_t net_amount = circuit.net_amount();
+
+    Netlist netlist;
+    netlist.m_gate_input_starts.reserve(gate_amount + 1);
+    for (GateId gate : circuit.gates()) {
+        netlist.m_gate_types.append(circuit.gate_type(gate));
+        netlist.m_gate_input_starts.append(
+            (uint32_t)netlist.m_gate_input_nets.size());
+        netlist.m_gate_input_nets.extend(circuit.gate_inputs(gate));
+        netlist.m_gate_outputs.append(circuit.gate_output(gate));
+    }
+    netlist.m_gate_input_starts.append(
+        (uint32_t)netlist.m_gate_input_nets.size());
+
+    /* Count the readers of every net first, so that the fanout of all nets
+     * can be stored in a single array. Flip-flops only read their input at
+     * clock edges, so they are not part of the fanout. */
+    Vector<uint32_t> fanout_amounts(net_amount, 0);
+    for (GateId gate : circuit.gates()) {
+        if (circuit.gate_type(gate) == GateType::FlipFlop) {
+            continue;
+        }
+        for (NetId net : netlist.gate_inputs(gate)) {
+            fanout_amounts[net]++;
+        }
+    }
+    netlist.m_fanout_starts.reserve(net_amount + 1);
+    uint32_t offset = 0;
+    for (NetId net : circuit.nets()) {
+        netlist.m_fanout_starts.append(offset);
+        offset += fanout_amounts[net];
+    }
+    netlist.m_fanout_starts.append(offset);
+
+    netlist.m_fanout_gates = Vector<GateId>(offset);
+    fanout_amounts.fill(0);
+    for (GateId gate : circuit.gates()) {
+        if (circuit.gate_type(gate) == GateType::FlipFlop) {
+            continue;
+        }
+        for (NetId net : netlist.gate_inputs(gate)) {
+            uint32_t index = netlist.m_fanout_starts[net] +
+                             fanout_amounts[net];
+            netlist.m_fanout_gates[index] = gate;
+            fanout_amounts[net]++;
+        }
+    }
+    return netlist;
+}
+
+uint64_t Netlist::evaluate_gate(GateId gate,
+                                ArrayRef<uint64_t> net_values) const
+{
+    ArrayRef<NetId> inputs = this->gate_inputs(gate);
+
+    switch (m_gate_types[gate]) {
+        case GateType::Input:
+        case GateType::FlipFlop:
+            return net_values[m_gate_outputs[gate]];
+        case GateType::Constant0:
+            return 0;
+        case GateType::Constant1:
+            return ALL_LANES;
+        case GateType::Buffer:
+            return net_values[inputs[0]];
+        case GateType::Not:
+            return ~net_values[inputs[0]];
+        case GateType::And:
+        case GateType::Nand: {
+            uint64_t result = ALL_LANES;
+            for (NetId net : inputs) {
+                result &= net_values[net];
+            }
+            return (m_gate_types[gate] == GateType::Nand) ? ~result : result;
+        }
+        case GateType::Or:
+        case GateType::Nor: {
+            uint64_t result = 0;
+            for (NetId net : inputs) {
+                result |= net_values[net];
+            }
+            return (m_gate_types[gate] == GateType::Nor) ? ~result : result;
+        }
+        case GateType::Xor:
+        case GateType::Xnor: {
+            uint64_t result = 0;
+            for (NetId net : inputs) {
+                result ^= net_values[net];
+            }
+            return (m_gate_types[gate] == GateType::Xnor) ? ~result : result;
+        }
+        case GateType::Tristate:
+            return net_values[inputs[0]] & net_values[inputs[1]];
+    }
+    assert(false);
+    return 0;
+}
+
+}  // namespace gate_sim
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "circuit.h"
+
+namespace gate_sim {
+
+using bas::uint64_t;
+
+/**
+ * Read-only copy of the connectivity of a circuit for simulators that follow
+ * changes from gate to gate. The inputs of all gates and the gates that read
+ * every net are stored in compressed sparse row format, so that there is no
+ * separate allocation per gate or net.
+ */
+class Netlist {
+  private:
+    Vector<GateType> m_gate_types;
+    Vector<uint32_t> m_gate_input_starts;
+    Vector<NetId> m_gate_input_nets;
+    Vector<NetId> m_gate_outputs;
+
+    /* Gates that have to be evaluated when a net changes. */
+    Vector<uint32_t> m_fanout_starts;
+    Vector<GateId> m_fanout_gates;
+
+  public:
+    static Netlist FromCircuit(const Circuit &circuit);
+
+    size_t gate_amount() const
+    {
+        return m_gate_types.size();
+    }
+
+    size_t net_amount() const
+    {
+        return m_fanout_starts.size() - 1;
+    }
+
+    GateType gate_type(GateId gate) const
+    {
+        return m_gate_types[gate];
+    }
+
+    ArrayRef<NetId> gate_inputs(GateId gate) const
+    {
+        uint32_t start = m_gate_input_starts[gate];
+        uint32_t end = m_gate_input_starts[gate + 1];
+        return ArrayRef<NetId>(m_gate_input_nets.begin() + start, end - start);
+    }
+
+    NetId gate_output(GateId gate) const
+    {
+        return m_gate_outputs[gate];
+    }
+
+    ArrayRef<GateId> net_fanout(NetId net) const
+    {
+        uint32_t start = m_fanout_starts[net];
+        uint32_t end = m_fanout_starts[net + 1];
+        return ArrayRef<GateId>(m_fanout_gates.begin() + start, end - start);
+    }
+
+    /**
+     * The fanout of all nets in compressed sparse row format. The fanout of
+     * a net is between its start and the start of the next net, so there is
+     * one more start than nets.
+     */
+    ArrayRef<uint32_t> fanout_starts() const
+    {
+        return m_fanout_starts;
+    }
+
+    ArrayRef<GateId> fanout_gates() const
+    {
+        return m_fanout_gates;
+    }
+
+    /**
+     * Compute the output of a gate for all lanes from the given net values.
+     * Input gates and flip-flops keep their current output, because it only
+     * changes from the outside or at clock edges.
+     */
+    uint64_t evaluate_gate(GateId gate, ArrayRef<uint64_t> net_values) const;
+};
+
+}  // namespace gate_sim
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "bas/utildefines.h"
+
+namespace gate_sim {
+
+using bas::size_t;
+
+#ifdef _MSC_VER
+/* The positions are padded to separate cache lines on purpose, which MSVC
+ * warns about. */
+#    pragma warning(push)
+#    pragma warning(disable : 4324)
+#endif
+
+/**
+ * Queue with a fixed capacity that passes values from one writer thread to
+ * one reader thread without locks.
+ *
+ * Values are written and read in batches, so that the positions, which are
+ * shared between the threads, are only updated once per batch. Both
+ * positions only ever increase and wrap around implicitly, which is why the
+ * capacity has to be a power of two.
+ */
+template<typename T> class RingBuffer : bas::NonCopyable, bas::NonMovable {
+  private:
+    std::unique_ptr<T[]> m_values;
+    size_t m_mask;
+    /* Number of values that have been written and read in total. */
+    alignas(64) std::atomic<size_t> m_write_position{0};
+    alignas(64) std::atomic<size_t> m_read_position{0};
+
+  public:
+    RingBuffer(size_t capacity)
+        : m_values(new T[capacity]),
+          m_mask(capacity - 1)
+    {
+        assert(capacity > 0 && (capacity & m_mask) == 0);
+    }
+
+    /**
+     * Append as many of the values as there is space for and return their
+     * number. Must only be called by the writer.
+     */
+    size_t write(const T *values, size_t amount)
+    {
+        size_t write_position = m_write_position.load(
+            std::memory_order_relaxed);
+        size_t read_position = m_read_position.load(
+            std::memory_order_acquire);
+        size_t free_amount = m_mask + 1 - (write_position - read_position);
+        amount = std::min(amount, free_amount);
+        for (size_t i = 0; i < amount; i++) {
+            m_values[(write_position + i) & m_mask] = values[i];
+        }
+        m_write_position.store(write_position + amount,
+                               std::memory_order_release);
+        return amount;
+    }
+
+    /**
+     * Remove up to the given number of values from the front and return how
+     * many there were. Must only be called by the reader.
+     */
+    size_t read(T *r_values, size_t max_amount)
+    {
+        size_t read_position = m_read_position.load(
+            std::memory_order_relaxed);
+        size_t write_position = m_write_position.load(
+            std::memory_order_acquire);
+        size_t amount = std::min(max_amount, write_position - read_position);
+        for (size_t i = 0; i < amount; i++) {
+            r_values[i] = m_values[(read_position + i) & m_mask];
+        }
+        m_read_position.store(read_position + amount,
+                              std::memory_order_release);
+        return amount;
+    }
+};
+
+#ifdef _MSC_VER
+#    pragma warning(pop)
+#endif
+
+}  // namespace gate_sim
@@ -0,0 +1,157 @@
+#include "simulation_history.h"
+
+namespace gate_sim {
+
+template<typename T> static void remove_after(Vector<T> &vector, size_t size)
+{
+    while (vector.size() > size) {
+        vector.remove_last();
+    }
+}
+
+SimulationHistory::SimulationHistory(Simulator &simulator,
+                                     ArrayRef<NetId> input_nets,
+                                     uint32_t checkpoint_interval)
+    : m_simulator(simulator),
+      m_input_nets(input_nets),
+      m_checkpoint_interval(checkpoint_interval)
+{
+    assert(checkpoint_interval >= 1);
+    /* The first checkpoint is stored relative to a state that is all zero. */
+    m_latest_state = Vector<uint64_t>(simulator.state_word_amount(), 0);
+    m_temp_state = Vector<uint64_t>(simulator.state_word_amount());
+}
+
+void SimulationHistory::next_cycle(ArrayRef<uint64_t> input_lanes)
+{
+    assert(input_lanes.size() == m_input_nets.size());
+
+    uint64_t cycle = 0;
+    if (m_cycle_amount > 0) {
+        cycle = m_current_cycle + 1;
+        /* Forget the cycles that are overwritten by new inputs. */
+        this->remove_checkpoints_after(m_current_cycle);
+        remove_after(m_inputs, cycle * m_input_nets.size());
+    }
+    m_inputs.extend(input_lanes);
+    m_cycle_amount = cycle + 1;
+    m_current_cycle = cycle;
+
+    this->simulate_cycle(cycle);
+    if (cycle % m_checkpoint_interval == 0) {
+        this->add_checkpoint();
+    }
+}
+
+void SimulationHistory::go_to_cycle(uint64_t cycle)
+{
+    assert(cycle < m_cycle_amount);
+
+    /* Checkpoints exist for every multiple of the interval. */
+    size_t checkpoint_index = cycle / m_checkpoint_interval;
+    uint64_t checkpoint_cycle = m_checkpoints[checkpoint_index].cycle;
+    bool can_continue = m_current_cycle <= cycle &&
+                        m_current_cycle >= checkpoint_cycle;
+    if (!can_continue) {
+        this->reconstruct_checkpoint(checkpoint_index, m_temp_state);
+        m_simulator.write_state(m_temp_state);
+        m_current_cycle = checkpoint_cycle;
+    }
+    while (m_current_cycle < cycle) {
+        m_current_cycle++;
+        this->simulate_cycle(m_current_cycle);
+    }
+}
+
+size_t SimulationHistory::checkpoint_memory() const
+{
+    return m_checkpoints.size() * sizeof(Checkpoint) +
+           m_delta_blocks.size() * sizeof(DeltaBlock) +
+           m_delta_words.size() * sizeof(uint64_t) +
+           m_latest_state.size() * sizeof(uint64_t);
+}
+
+void SimulationHistory::simulate_cycle(uint64_t cycle)
+{
+    if (cycle > 0) {
+        m_simulator.clock();
+    }
+    ArrayRef<uint64_t> inputs = this->cycle_inputs(cycle);
+    for (size_t i : m_input_nets.index_range()) {
+        m_simulator.set_net_lanes(m_input_nets[i], inputs[i]);
+    }
+    m_simulator.simulate();
+}
+
+void SimulationHistory::add_checkpoint()
+{
+    m_simulator.read_state(m_temp_state);
+
+    Checkpoint checkpoint;
+    checkpoint.cycle = m_current_cycle;
+    checkpoint.block_start = (uint32_t)m_delta_blocks.size();
+    checkpoint.word_start = (uint32_t)m_delta_words.size();
+
+    size_t word_amount = m_temp_state.size();
+    for (size_t block_start = 0; block_start < word_amount;
+         block_start += 64) {
+        size_t block_size = std::min<size_t>(word_amount - block_start, 64);
+        uint64_t changed_words = 0;
+        for (size_t i = 0; i < block_size; i++) {
+            size_t index = block_start + i;
+            uint64_t delta = m_temp_state[index] ^ m_latest_state[index];
+            if (delta != 0) {
+                changed_words |= (uint64_t)1 << i;
+                m_delta_words.append(delta);
+            }
+        }
+        if (changed_words != 0) {
+            m_delta_blocks.append(
+                {(uint32_t)(block_start / 64), changed_words});
+        }
+    }
+    checkpoint.block_amount = (uint32_t)m_delta_blocks.size() -
+                              checkpoint.block_start;
+    m_checkpoints.append(checkpoint);
+    m_latest_state.as_mutable_ref().copy_from(m_temp_state);
+}
+
+void SimulationHistory::reconstruct_checkpoint(
+    size_t index, MutableArrayRef<uint64_t> r_state)
+{
+    r_state.copy_from(m_latest_state);
+    for (size_t i = m_checkpoints.size() - 1; i > index; i--) {
+        this->apply_delta(m_checkpoints[i], r_state);
+    }
+}
+
+/**
+ * Turns the state of the checkpoint into the state of the checkpoint before
+ * it and vice versa.
+ */
+void SimulationHistory::apply_delta(const Checkpoint &checkpoint,
+                                    MutableArrayRef<uint64_t> r_state) const
+{
+    const uint64_t *delta_words = m_delta_words.begin() +
+                                  checkpoint.word_start;
+    for (uint32_t b = 0; b < checkpoint.block_amount; b++) {
+        DeltaBlock block = m_delta_blocks[checkpoint.block_start + b];
+        for (uint32_t i = 0; i < 64; i++) {
+            if (block.changed_words & ((uint64_t)1 << i)) {
+                r_state[block.block * 64 + i] ^= *delta_words++;
+            }
+        }
+    }
+}
+
+void SimulationHistory::remove_checkpoints_after(uint64_t cycle)
+{
+    while (!m_checkpoints.is_empty() && m_checkpoints.last().cycle > cycle) {
+        Checkpoint checkpoint = m_checkpoints.pop_last();
+        this->apply_delta(checkpoint, m_latest_state);
+        remove_after(m_delta_blocks, checkpoint.block_start);
+        remove_after(m_delta_words, checkpoint.word_start);
+    }
+}
+
+}  // namespace gate_sim
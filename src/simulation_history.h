@@ -0,0 +1,113 @@
+#pragma once
+
+#include "simulator.h"
+
+namespace gate_sim {
+
+/**
+ * Runs a simulator cycle by cycle and allows going back to earlier cycles.
+ *
+ * The inputs of every cycle are recorded. Every few cycles the complete
+ * state of the simulator is checkpointed. A checkpoint only stores the words
+ * that differ from the previous checkpoint, as XOR with the previous value,
+ * so memory grows with the activity in the circuit rather than with its
+ * size. Changed words are grouped in blocks of 64 with a bit mask, which
+ * costs much less than an index per word when the activity is high.
+ *
+ * Only the state of the latest checkpoint is kept in full. Since XOR is its
+ * own inverse, older states are reconstructed by applying the deltas
+ * backwards from there.
+ *
+ * Going to an earlier cycle restores the nearest checkpoint before it and
+ * simulates forward with the recorded inputs.
+ */
+class SimulationHistory {
+  private:
+    struct Checkpoint {
+        uint64_t cycle;
+        uint32_t block_start;
+        uint32_t block_amount;
+        uint32_t word_start;
+    };
+
+    /* Words of the state that changed in a range of 64 words. */
+    struct DeltaBlock {
+        uint32_t block;
+        uint64_t changed_words;
+    };
+
+    Simulator &m_simulator;
+    Vector<NetId> m_input_nets;
+    uint32_t m_checkpoint_interval;
+
+    /* Input values of all recorded cycles, one word per input net. */
+    Vector<uint64_t> m_inputs;
+    uint64_t m_cycle_amount = 0;
+    uint64_t m_current_cycle = 0;
+
+    Vector<Checkpoint> m_checkpoints;
+    Vector<DeltaBlock> m_delta_blocks;
+    Vector<uint64_t> m_delta_words;
+    Vector<uint64_t> m_latest_state;
+    Vector<uint64_t> m_temp_state;
+
+  public:
+    /**
+     * The simulator must outlive the history and should only be changed
+     * through it.
+     */
+    SimulationHistory(Simulator &simulator,
+                      ArrayRef<NetId> input_nets,
+                      uint32_t checkpoint_interval = 64);
+
+    /**
+     * Number of cycles that have been recorded.
+     */
+    uint64_t cycle_amount() const
+    {
+        return m_cycle_amount;
+    }
+
+    /**
+     * Cycle whose state the simulator currently has. Only valid when at
+     * least one cycle has been recorded.
+     */
+    uint64_t current_cycle() const
+    {
+        return m_current_cycle;
+    }
+
+    ArrayRef<uint64_t> cycle_inputs(uint64_t cycle) const
+    {
+        size_t input_amount = m_input_nets.size();
+        return m_inputs.as_ref().slice(cycle * input_amount, input_amount);
+    }
+
+    /**
+     * Simulate the cycle after the current one with the given input values:
+     * clock edge, new inputs and simulate. The first cycle starts without a
+     * clock edge. Recorded cycles after the current one are discarded.
+     */
+    void next_cycle(ArrayRef<uint64_t> input_lanes);
+
+    /**
+     * Bring the simulator into the state of a recorded cycle.
+     */
+    void go_to_cycle(uint64_t cycle);
+
+    /**
+     * Memory used by the checkpoints in bytes.
+     */
+    size_t checkpoint_memory() const;
+
+  private:
+    void simulate_cycle(uint64_t cycle);
+    void add_checkpoint();
+    void apply_delta(const Checkpoint &checkpoint,
+                     MutableArrayRef<uint64_t> r_state) const;
+    void reconstruct_checkpoint(size_t index,
+                                MutableArrayRef<uint64_t> r_state);
+    void remove_checkpoints_after(uint64_t cycle);
+};
+
+}  // namespace gate_sim
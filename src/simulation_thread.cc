@@ -0,0 +1,149 @@
+#include <chrono>
+
+#include "simulation_thread.h"
+
+namespace gate_sim {
+
+using Clock = std::chrono::steady_clock;
+
+/* How long the thread sleeps when there is nothing to simulate. */
+static constexpr std::chrono::milliseconds IDLE_SLEEP_TIME{1};
+/* Number of never toggled nets that are listed in a snapshot. */
+static constexpr uint32_t MAX_NEVER_TOGGLED_NETS = 50;
+
+SimulationThread::SimulationThread(Simulator &simulator,
+                                   const Circuit &circuit,
+                                   uint64_t start_cycle,
+                                   ToggleCoverage *toggle_coverage,
+                                   VcdWriter *vcd_writer,
+                                   WaveformStore *waveform_store)
+    : m_simulator(simulator),
+      m_toggle_coverage(toggle_coverage),
+      m_vcd_writer(vcd_writer),
+      m_waveform_store(waveform_store),
+      m_input_nets(circuit.input_nets()),
+      m_net_amount(circuit.net_amount()),
+      m_cycle(start_cycle),
+      m_start_cycle(start_cycle),
+      m_inputs(Vector<uint64_t>(m_input_nets.size(), 0)),
+      m_snapshots(SimulationSnapshot())
+{
+    /* Make the current state visible before the thread starts. */
+    this->write_snapshot(m_snapshots.write_buffer(), 0.0);
+    m_snapshots.publish();
+    this->record_cycle();
+    m_thread = std::thread([this]() { this->run(); });
+}
+
+SimulationThread::~SimulationThread()
+{
+    this->stop();
+}
+
+void SimulationThread::set_input_lanes(ArrayRef<uint64_t> input_lanes)
+{
+    m_inputs.write_buffer().as_mutable_ref().copy_from(input_lanes);
+    m_inputs.publish();
+}
+
+void SimulationThread::stop()
+{
+    if (m_thread.joinable()) {
+        m_should_stop.store(true, std::memory_order_relaxed);
+        m_thread.join();
+    }
+}
+
+void SimulationThread::run()
+{
+    Clock::time_point measure_start_time = Clock::now();
+    uint64_t measure_start_cycle = m_cycle;
+    double cycles_per_second = 0.0;
+    bool needs_snapshot = false;
+
+    while (!m_should_stop.load(std::memory_order_relaxed)) {
+        bool has_changes = false;
+        if (m_inputs.read_latest()) {
+            ArrayRef<uint64_t> input_lanes = m_inputs.read_buffer();
+            for (size_t i : m_input_nets.index_range()) {
+                m_simulator.set_net_lanes(m_input_nets[i], input_lanes[i]);
+            }
+            has_changes = true;
+        }
+        bool is_running = m_is_running.load(std::memory_order_relaxed);
+        if (is_running) {
+            m_simulator.clock();
+            m_cycle++;
+            has_changes = true;
+        }
+        if (has_changes) {
+            m_simulator.simulate();
+            needs_snapshot = true;
+            this->record_cycle();
+        }
+        /* Input changes while stopped are counted with the next cycle. */
+        if (is_running && m_toggle_coverage != nullptr) {
+            m_toggle_coverage->count_cycle();
+        }
+
+        if (!is_running) {
+            measure_start_time = Clock::now();
+            measure_start_cycle = m_cycle;
+            cycles_per_second = 0.0;
+        }
+        /* While running, only take a snapshot when the last one was read.
+         * Otherwise the user interface would not see the final state after
+         * stopping. */
+        if (needs_snapshot &&
+            (!is_running || !m_snapshots.has_unread_value())) {
+            if (is_running) {
+                Clock::time_point now = Clock::now();
+                std::chrono::duration<double> duration = now -
+                                                         measure_start_time;
+                if (duration.count() >= 0.5) {
+                    cycles_per_second = (double)(m_cycle -
+                                                 measure_start_cycle) /
+                                        duration.count();
+                    measure_start_time = now;
+                    measure_start_cycle = m_cycle;
+                }
+            }
+            this->write_snapshot(m_snapshots.write_buffer(),
+                                 cycles_per_second);
+            m_snapshots.publish();
+            needs_snapshot = false;
+        }
+        if (!is_running && !has_changes) {
+            std::this_thread::sleep_for(IDLE_SLEEP_TIME);
+        }
+    }
+}
+
+void SimulationThread::record_cycle()
+{
+    if (m_vcd_writer != nullptr) {
+        m_vcd_writer->record_cycle(m_cycle, m_simulator);
+    }
+    if (m_waveform_store != nullptr) {
+        m_waveform_store->record_cycle(m_cycle, m_simulator);
+    }
+}
+
+void SimulationThread::write_snapshot(SimulationSnapshot &r_snapshot,
+                                      double cycles_per_second)
+{
+    r_snapshot.cycle = m_cycle;
+    r_snapshot.has_oscillation = m_simulator.has_oscillation();
+    r_snapshot.cycles_per_second = cycles_per_second;
+    r_snapshot.net_values.clear();
+    for (NetId net : IndexRange(m_net_amount)) {
+        r_snapshot.net_values.append(m_simulator.get_net_logic(net));
+    }
+    r_snapshot.has_toggle_summary = m_toggle_coverage != nullptr;
+    if (m_toggle_coverage != nullptr) {
+        r_snapshot.toggle_summary = m_toggle_coverage->summarize(
+            m_net_amount, MAX_NEVER_TOGGLED_NETS);
+    }
+}
+
+}  // namespace gate_sim
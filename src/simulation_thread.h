@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include "circuit.h"
+#include "simulator.h"
+#include "toggle_coverage.h"
+#include "triple_buffer.h"
+#include "vcd_writer.h"
+#include "waveform_store.h"
+
+namespace gate_sim {
+
+/**
+ * Values of all nets at the end of a cycle, as seen by the user interface.
+ */
+struct SimulationSnapshot {
+    uint64_t cycle = 0;
+    bool has_oscillation = false;
+    /* Measured over the last half second while running, otherwise zero. */
+    double cycles_per_second = 0.0;
+    /* Lane 0 of every net, indexed by NetId. */
+    Vector<Logic4> net_values;
+    /* Only set when toggles are counted. */
+    bool has_toggle_summary = false;
+    ToggleSummary toggle_summary;
+};
+
+/**
+ * Runs a simulator on a separate thread, so that the simulation rate is
+ * independent of the frame rate of the user interface.
+ *
+ * New input values and the latest snapshot are exchanged through triple
+ * buffers, so neither the user interface nor the simulation ever wait for
+ * each other. While running, a cycle (clock edge and simulate) is done as
+ * often as possible. Snapshots are only made when the previous one has been
+ * read, which keeps the cost of publishing independent of the cycle rate.
+ *
+ * The simulator, the toggle coverage and the VCD writer must not be used by
+ * anything else while the thread exists. The waveform store can be read at
+ * any time.
+ */
+class SimulationThread : bas::NonCopyable, bas::NonMovable {
+  private:
+    Simulator &m_simulator;
+    ToggleCoverage *m_toggle_coverage;
+    VcdWriter *m_vcd_writer;
+    WaveformStore *m_waveform_store;
+    Vector<NetId> m_input_nets;
+    uint32_t m_net_amount;
+    uint64_t m_cycle;
+    uint64_t m_start_cycle;
+
+    TripleBuffer<Vector<uint64_t>> m_inputs;
+    TripleBuffer<SimulationSnapshot> m_snapshots;
+
+    std::atomic<bool> m_is_running{false};
+    std::atomic<bool> m_should_stop{false};
+    std::thread m_thread;
+
+  public:
+    /**
+     * The simulator should already contain the state of the given cycle.
+     * When a toggle coverage of the simulator is given, every simulated
+     * cycle is counted in it. When a VCD writer or a waveform store is
+     * given, every change is recorded in them.
+     */
+    SimulationThread(Simulator &simulator,
+                     const Circuit &circuit,
+                     uint64_t start_cycle,
+                     ToggleCoverage *toggle_coverage = nullptr,
+                     VcdWriter *vcd_writer = nullptr,
+                     WaveformStore *waveform_store = nullptr);
+    ~SimulationThread();
+
+    /**
+     * Values of the input nets in the order of Circuit::input_nets. They are
+     * applied in the next cycle, or immediately when not running.
+     */
+    void set_input_lanes(ArrayRef<uint64_t> input_lanes);
+
+    /**
+     * Start or stop simulating cycles continuously.
+     */
+    void set_running(bool is_running)
+    {
+        m_is_running.store(is_running, std::memory_order_relaxed);
+    }
+
+    bool is_running() const
+    {
+        return m_is_running.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Latest snapshot. Only one thread may call this.
+     */
+    const SimulationSnapshot &read_snapshot()
+    {
+        m_snapshots.read_latest();
+        return m_snapshots.read_buffer();
+    }
+
+    /**
+     * Number of cycles that have been simulated by this thread. Only valid
+     * after the thread has been stopped.
+     */
+    uint64_t simulated_cycle_amount() const
+    {
+        return m_cycle - m_start_cycle;
+    }
+
+    /**
+     * Stop the thread. Afterwards the simulator can be used again.
+     */
+    void stop();
+
+  private:
+    void run();
+    void record_cycle();
+    void write_snapshot(SimulationSnapshot &r_snapshot,
+                        double cycles_per_second);
+};
+
+}  // namespace gate_sim
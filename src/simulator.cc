@@ -0,0 +1,54 @@
+#include "simulator.h"
+#include "aig_simulator.h"
+#include "event_simulator.h"
+#include "four_state_simulator.h"
+#include "levelized_simulator.h"
+#include "thread_pool.h"
+#include "timing_simulator.h"
+
+namespace gate_sim {
+
+const char *simulator_type_name(SimulatorType type)
+{
+    switch (type) {
+        case SimulatorType::EventDriven:
+            return "Event Driven";
+        case SimulatorType::Levelized:
+            return "Levelized";
+        case SimulatorType::ParallelLevelized:
+            return "Parallel Levelized";
+        case SimulatorType::FourState:
+            return "Four State";
+        case SimulatorType::Timing:
+            return "Timing";
+        case SimulatorType::AndInverterGraph:
+            return "And Inverter Graph";
+    }
+    assert(false);
+    return "";
+}
+
+std::unique_ptr<Simulator> create_simulator(SimulatorType type,
+                                            const Circuit &circuit,
+                                            const GateDelays &gate_delays)
+{
+    switch (type) {
+        case SimulatorType::EventDriven:
+            return std::make_unique<EventSimulator>(circuit);
+        case SimulatorType::Levelized:
+            return std::make_unique<LevelizedSimulator>(circuit);
+        case SimulatorType::ParallelLevelized:
+            return std::make_unique<LevelizedSimulator>(
+                circuit, best_instruction_set(), &get_thread_pool());
+        case SimulatorType::FourState:
+            return std::make_unique<FourStateSimulator>(circuit);
+        case SimulatorType::Timing:
+            return std::make_unique<TimingSimulator>(circuit, gate_delays);
+        case SimulatorType::AndInverterGraph:
+            return std::make_unique<AigSimulator>(circuit);
+    }
+    assert(false);
+    return {};
+}
+
+}  // namespace gate_sim
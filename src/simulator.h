@@ -0,0 +1,180 @@
+#pragma once
+
+#include <memory>
+
+#include "circuit.h"
+#include "gate_delays.h"
+#include "logic4.h"
+
+namespace gate_sim {
+
+using bas::MutableArrayRef;
+using bas::uint64_t;
+
+/**
+ * Simulators process 64 independent sets of input values at the same time.
+ * Every net stores one bit per lane in a 64 bit word, so that a single
+ * bitwise operation evaluates a gate for all lanes.
+ */
+constexpr uint32_t LANE_AMOUNT = 64;
+constexpr uint64_t ALL_LANES = ~(uint64_t)0;
+
+/**
+ * How often the gates of a combinational loop are evaluated at most during a
+ * single call to Simulator::simulate before the loop counts as oscillating.
+ * Loops that store a value, like latches, settle after a few iterations.
+ */
+constexpr uint32_t MAX_LOOP_ITERATIONS = 64;
+
+/**
+ * Meaning of the words that contain the values of a net, see
+ * Simulator::value_words.
+ */
+enum class NetValueLayout {
+    /* The first word contains the lanes. Further words are copies of it, so
+     * that vector instructions can process them. */
+    TwoState,
+    /* The value and unknown bit planes of a Logic4Word. */
+    FourState,
+};
+
+/**
+ * Common interface of all simulation engines. Every engine is created for a
+ * specific circuit and has to be recreated when the circuit changes, unless
+ * it supports adding gates.
+ */
+class Simulator {
+  public:
+    virtual ~Simulator() = default;
+
+    /**
+     * Set the values of a net that is not driven by a gate in all lanes. The
+     * change only becomes visible in other nets after the next call to
+     * simulate.
+     */
+    virtual void set_net_lanes(NetId net, uint64_t lanes) = 0;
+
+    virtual uint64_t get_net_lanes(NetId net) const = 0;
+
+    /**
+     * Set the same value in all lanes.
+     */
+    void set_net(NetId net, bool value)
+    {
+        this->set_net_lanes(net, value ? ALL_LANES : 0);
+    }
+
+    /**
+     * Get the value in the first lane.
+     */
+    bool get_net(NetId net) const
+    {
+        return this->get_net_lanes(net) & 1;
+    }
+
+    /**
+     * Get the value in the first lane including unknown and undriven states.
+     * Two-valued simulators only ever return zero or one.
+     */
+    virtual Logic4 get_net_logic(NetId net) const
+    {
+        return this->get_net(net) ? Logic4::One : Logic4::Zero;
+    }
+
+    /**
+     * Compute the values of all nets that are driven by gates.
+     */
+    virtual void simulate() = 0;
+
+    /**
+     * Rising edge of the global clock: every flip-flop stores the current
+     * value of its input. All flip-flops switch at the same time, so the new
+     * value of one flip-flop never affects what another one stores. Like
+     * changed inputs, the new values only become visible in the other nets
+     * after the next call to simulate.
+     */
+    virtual void clock() = 0;
+
+    /**
+     * True when a combinational loop did not settle during the last call to
+     * simulate, e.g. because it is a ring oscillator. Then the values of the
+     * nets in and behind the loop are arbitrary.
+     */
+    virtual bool has_oscillation() const = 0;
+
+    /**
+     * Number of 64 bit words that describe everything the simulator knows
+     * about the circuit between two calls to simulate.
+     */
+    virtual size_t state_word_amount() const = 0;
+
+    virtual void read_state(MutableArrayRef<uint64_t> r_words) const = 0;
+
+    /**
+     * Restore a state that has been read from a simulator for the same
+     * circuit. Changes that have not been simulated yet are discarded.
+     */
+    virtual void write_state(ArrayRef<uint64_t> words) = 0;
+
+    /**
+     * Words that contain the current values of all nets, possibly together
+     * with other values. The values of a net are in net_value_word_amount
+     * consecutive words starting at net_value_word_index. This allows
+     * observing all nets at once without copying them. The words become
+     * invalid when the simulator changes.
+     */
+    virtual ArrayRef<uint64_t> value_words() const = 0;
+    virtual size_t net_value_word_index(NetId net) const = 0;
+    virtual uint32_t net_value_word_amount() const = 0;
+
+    virtual NetValueLayout net_value_layout() const
+    {
+        return NetValueLayout::TwoState;
+    }
+
+    /**
+     * True when the words of the net contain its inverted values, because
+     * it shares them with another net.
+     */
+    virtual bool net_value_is_inverted(NetId net) const
+    {
+        BAS_UNUSED_VAR(net);
+        return false;
+    }
+
+    /**
+     * Update the simulator after a gate has been added to its circuit. The
+     * values of all other nets are kept, but the state layout changes.
+     * Returns false when the simulator has to be recreated instead.
+     */
+    virtual bool add_gate(const Circuit &circuit, GateId gate)
+    {
+        BAS_UNUSED_VAR(circuit);
+        BAS_UNUSED_VAR(gate);
+        return false;
+    }
+};
+
+enum class SimulatorType {
+    EventDriven,
+    Levelized,
+    ParallelLevelized,
+    FourState,
+    Timing,
+    AndInverterGraph,
+};
+
+constexpr uint32_t SIMULATOR_TYPE_AMOUNT =
+    (uint32_t)SimulatorType::AndInverterGraph + 1;
+
+const char *simulator_type_name(SimulatorType type);
+
+/**
+ * The gate delays are only used by simulators that model time.
+ */
+std::unique_ptr<Simulator> create_simulator(
+    SimulatorType type,
+    const Circuit &circuit,
+    const GateDelays &gate_delays = GateDelays());
+
+}  // namespace gate_sim
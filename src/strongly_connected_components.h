@@ -0,0 +1,144 @@
+#pragma once
+
+#include "bas/array_ref.h"
+#include "bas/stack.h"
+#include "bas/vector.h"
+
+namespace gate_sim {
+
+using bas::ArrayRef;
+using bas::size_t;
+using bas::Stack;
+using bas::uint32_t;
+using bas::Vector;
+
+/**
+ * The strongly connected components of a directed graph, found with Tarjan's
+ * algorithm. Two nodes are in the same component when there is a path from
+ * each of them to the other, so every cycle is within a single component.
+ *
+ * Components are stored in reverse topological order: all edges that leave a
+ * component point to components that come before it.
+ */
+class StronglyConnectedComponents {
+  private:
+    Vector<uint32_t> m_nodes;
+    Vector<uint32_t> m_component_starts;
+
+  public:
+    /**
+     * Find the components that contain the start nodes or are reachable from
+     * them. The successors function returns an ArrayRef<uint32_t> with the
+     * targets of all edges of a node.
+     *
+     * The depth first search uses an explicit stack, so that long chains of
+     * nodes do not overflow the call stack.
+     */
+    template<typename SuccessorsFn>
+    static StronglyConnectedComponents Find(uint32_t node_amount,
+                                            ArrayRef<uint32_t> start_nodes,
+                                            const SuccessorsFn &successors);
+
+    size_t component_amount() const
+    {
+        return m_component_starts.size() - 1;
+    }
+
+    ArrayRef<uint32_t> component(size_t index) const
+    {
+        uint32_t start = m_component_starts[index];
+        uint32_t end = m_component_starts[index + 1];
+        return ArrayRef<uint32_t>(m_nodes.begin() + start, end - start);
+    }
+
+    /**
+     * A component is a cycle when it has more than one node or its only node
+     * has an edge to itself.
+     */
+    template<typename SuccessorsFn>
+    bool is_cycle(size_t index, const SuccessorsFn &successors) const
+    {
+        ArrayRef<uint32_t> nodes = this->component(index);
+        return nodes.size() > 1 || successors(nodes[0]).contains(nodes[0]);
+    }
+};
+
+template<typename SuccessorsFn>
+StronglyConnectedComponents StronglyConnectedComponents::Find(
+    uint32_t node_amount,
+    ArrayRef<uint32_t> start_nodes,
+    const SuccessorsFn &successors)
+{
+    constexpr uint32_t NOT_VISITED = (uint32_t)-1;
+
+    struct Frame {
+        uint32_t node;
+        uint32_t next_successor;
+    };
+
+    StronglyConnectedComponents components;
+    components.m_component_starts.append(0);
+
+    /* Order in which the nodes have been visited and the lowest visit index
+     * that is reachable from every node through nodes on the stack. */
+    Vector<uint32_t> visit_indices(node_amount, NOT_VISITED);
+    Vector<uint32_t> low_links(node_amount, 0);
+    Vector<bool> is_on_stack(node_amount, false);
+    Stack<uint32_t> node_stack;
+    Stack<Frame> call_stack;
+    uint32_t visit_amount = 0;
+
+    auto visit = [&](uint32_t node) {
+        visit_indices[node] = visit_amount;
+        low_links[node] = visit_amount;
+        visit_amount++;
+        node_stack.push(node);
+        is_on_stack[node] = true;
+        call_stack.push({node, 0});
+    };
+
+    for (uint32_t start_node : start_nodes) {
+        if (visit_indices[start_node] != NOT_VISITED) {
+            continue;
+        }
+        visit(start_node);
+        while (!call_stack.is_empty()) {
+            Frame &frame = call_stack.peek();
+            uint32_t node = frame.node;
+            ArrayRef<uint32_t> targets = successors(node);
+            if (frame.next_successor < targets.size()) {
+                uint32_t target = targets[frame.next_successor++];
+                if (visit_indices[target] == NOT_VISITED) {
+                    /* The frame reference becomes invalid here. */
+                    visit(target);
+                }
+                else if (is_on_stack[target]) {
+                    low_links[node] = std::min(low_links[node],
+                                               visit_indices[target]);
+                }
+                continue;
+            }
+
+            call_stack.pop();
+            if (!call_stack.is_empty()) {
+                uint32_t parent = call_stack.peek().node;
+                low_links[parent] = std::min(low_links[parent],
+                                             low_links[node]);
+            }
+            if (low_links[node] == visit_indices[node]) {
+                /* The node is the root of a component. */
+                uint32_t member;
+                do {
+                    member = node_stack.pop();
+                    is_on_stack[member] = false;
+                    components.m_nodes.append(member);
+                } while (member != node);
+                components.m_component_starts.append(
+                    (uint32_t)components.m_nodes.size());
+            }
+        }
+    }
+    return components;
+}
+
+}  // namespace gate_sim
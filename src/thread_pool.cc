@@ -0,0 +1,193 @@
+#include "thread_pool.h"
+
+namespace gate_sim {
+
+/* Workers check for new work this many times before they go to sleep. This
+ * avoids the cost of waking up threads when loops are started in quick
+ * succession, e.g. for every level of a circuit. */
+static constexpr uint32_t SPIN_ITERATIONS = 1000;
+
+static uint64_t pack_chunks(uint32_t begin, uint32_t end)
+{
+    return (uint64_t)begin | ((uint64_t)end << 32);
+}
+
+ThreadPool::ThreadPool(uint32_t thread_amount)
+{
+    m_thread_amount = std::max<uint32_t>(thread_amount, 1);
+    m_queues = std::make_unique<ChunkQueue[]>(m_thread_amount);
+    for (uint32_t thread_index = 1; thread_index < m_thread_amount;
+         thread_index++) {
+        m_threads.append(std::thread(
+            [this, thread_index]() { this->worker_main(thread_index); }));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake_condition.notify_all();
+    for (std::thread &thread : m_threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallel_for_impl(IndexRange range,
+                                   size_t grain_size,
+                                   ChunkFn chunk_fn,
+                                   const void *chunk_fn_data)
+{
+    if (range.size() == 0) {
+        return;
+    }
+    grain_size = std::max<size_t>(grain_size, 1);
+    uint32_t chunk_amount = (uint32_t)((range.size() + grain_size - 1) /
+                                       grain_size);
+    if (chunk_amount == 1 || m_thread_amount == 1) {
+        for (uint32_t chunk = 0; chunk < chunk_amount; chunk++) {
+            size_t start = chunk * grain_size;
+            size_t size = std::min(grain_size, range.size() - start);
+            chunk_fn(chunk_fn_data, range.slice(start, size));
+        }
+        return;
+    }
+
+    m_chunk_fn = chunk_fn;
+    m_chunk_fn_data = chunk_fn_data;
+    m_range = range;
+    m_grain_size = grain_size;
+    m_chunk_amount = chunk_amount;
+    m_finished_chunks.store(0);
+    for (uint32_t thread_index = 0; thread_index < m_thread_amount;
+         thread_index++) {
+        uint32_t begin = (uint32_t)((uint64_t)chunk_amount * thread_index /
+                                    m_thread_amount);
+        uint32_t end = (uint32_t)((uint64_t)chunk_amount * (thread_index + 1) /
+                                  m_thread_amount);
+        m_queues[thread_index].chunks.store(pack_chunks(begin, end));
+    }
+
+    m_job_is_open.store(true);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_generation++;
+    }
+    m_wake_condition.notify_all();
+
+    this->process_chunks(0);
+
+    while (m_finished_chunks.load() < chunk_amount) {
+        std::this_thread::yield();
+    }
+
+    /* Make sure that no worker accesses the loop anymore before returning,
+     * because the function is owned by the caller. */
+    m_job_is_open.store(false);
+    while (m_active_workers.load() > 0) {
+        std::this_thread::yield();
+    }
+}
+
+void ThreadPool::worker_main(uint32_t thread_index)
+{
+    uint64_t seen_generation = 0;
+    while (true) {
+        bool has_new_job = false;
+        for (uint32_t i = 0; i < SPIN_ITERATIONS; i++) {
+            if (m_generation.load() != seen_generation) {
+                has_new_job = true;
+                break;
+            }
+            std::this_thread::yield();
+        }
+        if (!has_new_job) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake_condition.wait(lock, [&]() {
+                return m_stop || m_generation.load() != seen_generation;
+            });
+            if (m_stop) {
+                return;
+            }
+        }
+        seen_generation = m_generation.load();
+
+        /* The loop might already be finished when this worker arrives. The
+         * active counter is incremented before checking if the loop is still
+         * open, so that the loop cannot finish while it is being accessed. */
+        m_active_workers++;
+        if (m_job_is_open.load()) {
+            this->process_chunks(thread_index);
+        }
+        m_active_workers--;
+    }
+}
+
+void ThreadPool::process_chunks(uint32_t thread_index)
+{
+    uint32_t chunk;
+    while (this->pop_own_chunk(thread_index, chunk)) {
+        this->run_chunk(chunk);
+    }
+    while (this->steal_chunk(thread_index, chunk)) {
+        this->run_chunk(chunk);
+    }
+}
+
+bool ThreadPool::pop_own_chunk(uint32_t thread_index, uint32_t &r_chunk)
+{
+    std::atomic<uint64_t> &chunks = m_queues[thread_index].chunks;
+    uint64_t old_chunks = chunks.load();
+    while (true) {
+        uint32_t begin = (uint32_t)old_chunks;
+        uint32_t end = (uint32_t)(old_chunks >> 32);
+        if (begin >= end) {
+            return false;
+        }
+        if (chunks.compare_exchange_weak(old_chunks,
+                                         pack_chunks(begin + 1, end))) {
+            r_chunk = begin;
+            return true;
+        }
+    }
+}
+
+bool ThreadPool::steal_chunk(uint32_t thread_index, uint32_t &r_chunk)
+{
+    for (uint32_t i = 1; i < m_thread_amount; i++) {
+        uint32_t victim = (thread_index + i) % m_thread_amount;
+        std::atomic<uint64_t> &chunks = m_queues[victim].chunks;
+        uint64_t old_chunks = chunks.load();
+        while (true) {
+            uint32_t begin = (uint32_t)old_chunks;
+            uint32_t end = (uint32_t)(old_chunks >> 32);
+            if (begin >= end) {
+                break;
+            }
+            if (chunks.compare_exchange_weak(old_chunks,
+                                             pack_chunks(begin, end - 1))) {
+                r_chunk = end - 1;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run_chunk(uint32_t chunk)
+{
+    size_t start = chunk * m_grain_size;
+    size_t size = std::min(m_grain_size, m_range.size() - start);
+    m_chunk_fn(m_chunk_fn_data, m_range.slice(start, size));
+    m_finished_chunks++;
+}
+
+ThreadPool &get_thread_pool()
+{
+    static ThreadPool thread_pool;
+    return thread_pool;
+}
+
+}  // namespace gate_sim
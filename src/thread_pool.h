@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "bas/index_range.h"
+#include "bas/vector.h"
+
+namespace gate_sim {
+
+using bas::IndexRange;
+using bas::size_t;
+using bas::uint32_t;
+using bas::uint64_t;
+using bas::Vector;
+
+/**
+ * A fixed set of worker threads that process parallel loops.
+ *
+ * The range of a loop is split into chunks. Every thread starts with its own
+ * contiguous block of chunks and takes chunks from the front of it. Threads
+ * that run out of work steal chunks from the back of the blocks of other
+ * threads. The thread that starts the loop participates as well and only
+ * returns when all chunks are done, so consecutive loops are separated by a
+ * barrier.
+ *
+ * Only one thread at a time may start loops, and loops must not be nested.
+ */
+class ThreadPool : bas::NonCopyable, bas::NonMovable {
+  private:
+    using ChunkFn = void (*)(const void *data, IndexRange range);
+
+    /* Remaining chunks of one thread. The lower 32 bits contain the next
+     * chunk and the upper 32 bits the end of the block. Both are updated
+     * together, so that the owner and thieves never take the same chunk. */
+    struct alignas(64) ChunkQueue {
+        std::atomic<uint64_t> chunks;
+        /* Fills the cache line explicitly, because MSVC warns about padding
+         * that is added for the alignment. */
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    uint32_t m_thread_amount;
+    Vector<std::thread> m_threads;
+    std::unique_ptr<ChunkQueue[]> m_queues;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake_condition;
+    std::atomic<uint64_t> m_generation{0};
+    std::atomic<bool> m_job_is_open{false};
+    std::atomic<uint32_t> m_active_workers{0};
+    bool m_stop = false;
+
+    /* Description of the current loop. Only changed while no worker is
+     * active. */
+    ChunkFn m_chunk_fn = nullptr;
+    const void *m_chunk_fn_data = nullptr;
+    IndexRange m_range;
+    size_t m_grain_size = 1;
+    uint32_t m_chunk_amount = 0;
+    std::atomic<uint32_t> m_finished_chunks{0};
+
+  public:
+    /**
+     * Create a pool that uses the given total number of threads, including
+     * the thread that calls parallel_for.
+     */
+    ThreadPool(uint32_t thread_amount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    uint32_t thread_amount() const
+    {
+        return m_thread_amount;
+    }
+
+    /**
+     * Call the function for chunks of the range that have at most grain_size
+     * elements. The chunks are processed in parallel. Returns when all chunks
+     * are done.
+     */
+    template<typename FuncT>
+    void parallel_for(IndexRange range, size_t grain_size, const FuncT &func)
+    {
+        this->parallel_for_impl(
+            range,
+            grain_size,
+            [](const void *data, IndexRange chunk) {
+                (*(const FuncT *)data)(chunk);
+            },
+            (const void *)&func);
+    }
+
+  private:
+    void parallel_for_impl(IndexRange range,
+                           size_t grain_size,
+                           ChunkFn chunk_fn,
+                           const void *chunk_fn_data);
+
+    void worker_main(uint32_t thread_index);
+    void process_chunks(uint32_t thread_index);
+    bool pop_own_chunk(uint32_t thread_index, uint32_t &r_chunk);
+    bool steal_chunk(uint32_t thread_index, uint32_t &r_chunk);
+    void run_chunk(uint32_t chunk);
+};
+
+/**
+ * Get the pool that is shared by all simulators and importers, so that they
+ * do not start their own threads.
+ */
+ThreadPool &get_thread_pool();
+
+}  // namespace gate_sim
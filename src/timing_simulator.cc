@@ -0,0 +1,124 @@
+#include "timing_simulator.h"
+
+namespace gate_sim {
+
+TimingSimulator::TimingSimulator(const Circuit &circuit,
+                                 const GateDelays &gate_delays)
+    : m_netlist(Netlist::FromCircuit(circuit)),
+      m_gate_delays(gate_delays),
+      m_pending_changes(gate_delays.max_delay()),
+      m_loop_counter(CombinationalLoops::FromNetlist(m_netlist),
+                     circuit.gate_amount())
+{
+    m_net_values = Vector<uint64_t>(circuit.net_amount(), 0);
+    m_final_net_values = m_net_values;
+    m_flip_flops = circuit.flip_flops();
+    m_gate_is_scheduled = Vector<bool>(circuit.gate_amount(), false);
+
+    /* Evaluate every gate once, so that gates whose output is not zero when
+     * all inputs are zero get the correct initial value. */
+    for (GateId gate : circuit.gates()) {
+        m_gate_is_scheduled[gate] = true;
+        m_scheduled_gates.append(gate);
+    }
+    this->process_current_time();
+    this->simulate();
+}
+
+void TimingSimulator::set_net_lanes(NetId net, uint64_t lanes)
+{
+    this->schedule_change(0, net, lanes);
+}
+
+void TimingSimulator::simulate()
+{
+    m_loop_counter.reset();
+    while (!m_pending_changes.is_empty() && !m_loop_counter.is_exceeded()) {
+        m_pending_changes.advance(m_pending_changes.next_time());
+        this->process_current_time();
+    }
+}
+
+void TimingSimulator::simulate_until(Time end_time)
+{
+    m_loop_counter.reset();
+    while (!m_pending_changes.is_empty()) {
+        Time time = m_pending_changes.next_time();
+        if (time > end_time) {
+            break;
+        }
+        m_pending_changes.advance(time);
+        this->process_current_time();
+    }
+    m_pending_changes.advance(std::max(end_time, this->current_time()));
+}
+
+void TimingSimulator::clock()
+{
+    uint32_t delay = m_gate_delays.get(GateType::FlipFlop);
+    for (GateId gate : m_flip_flops) {
+        NetId input = m_netlist.gate_inputs(gate)[0];
+        this->schedule_change(
+            delay, m_netlist.gate_output(gate), m_net_values[input]);
+    }
+}
+
+void TimingSimulator::read_state(MutableArrayRef<uint64_t> r_words) const
+{
+    r_words.copy_from(m_net_values);
+}
+
+void TimingSimulator::write_state(ArrayRef<uint64_t> words)
+{
+    m_net_values.as_mutable_ref().copy_from(words);
+    m_final_net_values.as_mutable_ref().copy_from(words);
+    m_pending_changes.clear();
+    for (GateId gate : m_scheduled_gates) {
+        m_gate_is_scheduled[gate] = false;
+    }
+    m_scheduled_gates.clear();
+}
+
+void TimingSimulator::schedule_change(uint64_t delay,
+                                      NetId net,
+                                      uint64_t lanes)
+{
+    if (m_final_net_values[net] != lanes) {
+        m_final_net_values[net] = lanes;
+        m_pending_changes.insert(delay, {net, lanes});
+    }
+}
+
+void TimingSimulator::process_current_time()
+{
+    Time time = this->current_time();
+
+    m_pending_changes.pop_current(m_current_changes);
+    for (NetChange change : m_current_changes) {
+        if (m_net_values[change.net] == change.lanes) {
+            continue;
+        }
+        m_net_values[change.net] = change.lanes;
+        if (m_listener != nullptr) {
+            m_listener->net_changed(time, change.net, change.lanes);
+        }
+        for (GateId gate : m_netlist.net_fanout(change.net)) {
+            if (!m_gate_is_scheduled[gate]) {
+                m_gate_is_scheduled[gate] = true;
+                m_scheduled_gates.append(gate);
+            }
+        }
+    }
+
+    /* All gates see the values of the same point in time. */
+    for (GateId gate : m_scheduled_gates) {
+        m_gate_is_scheduled[gate] = false;
+        m_loop_counter.count(gate);
+        this->schedule_change(m_gate_delays.get(m_netlist.gate_type(gate)),
+                              m_netlist.gate_output(gate),
+                              m_netlist.evaluate_gate(gate, m_net_values));
+    }
+    m_scheduled_gates.clear();
+}
+
+}  // namespace gate_sim
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "combinational_loops.h"
+#include "gate_delays.h"
+#include "netlist.h"
+#include "simulator.h"
+#include "timing_wheel.h"
+
+namespace gate_sim {
+
+using Time = uint64_t;
+
+/**
+ * Receives every change of a net value in the order in which the changes
+ * happen.
+ */
+class ChangeListener {
+  public:
+    virtual ~ChangeListener() = default;
+
+    virtual void net_changed(Time time, NetId net, uint64_t lanes) = 0;
+};
+
+/**
+ * Event driven simulation in which every gate takes time to propagate a
+ * change, depending on its type. Unlike in zero-delay simulation, inputs of a
+ * gate can change at different times, so short pulses (glitches) and races
+ * between paths of different length become visible.
+ *
+ * The output of a gate is evaluated as soon as one of its inputs changes and
+ * the new value is applied after the delay of the gate (transport delay), so
+ * pulses that are shorter than the delay still propagate. Pending changes
+ * are stored in a timing wheel.
+ *
+ * A ring oscillator never becomes stable. Combinational loops are found when
+ * the simulator is created, and simulate returns early when the gates of a
+ * loop have been evaluated too often.
+ */
+class TimingSimulator : public Simulator {
+  private:
+    struct NetChange {
+        NetId net;
+        uint64_t lanes;
+    };
+
+    Netlist m_netlist;
+    GateDelays m_gate_delays;
+    Vector<uint64_t> m_net_values;
+    /* Value of every net after all pending changes have been applied. New
+     * changes are only scheduled when they differ from it. */
+    Vector<uint64_t> m_final_net_values;
+    Vector<GateId> m_flip_flops;
+
+    TimingWheel<NetChange> m_pending_changes;
+    Vector<NetChange> m_current_changes;
+    Vector<GateId> m_scheduled_gates;
+    Vector<bool> m_gate_is_scheduled;
+
+    LoopEvaluationCounter m_loop_counter;
+
+    ChangeListener *m_listener = nullptr;
+
+  public:
+    TimingSimulator(const Circuit &circuit,
+                    const GateDelays &gate_delays = GateDelays());
+
+    /**
+     * The change happens at the current time.
+     */
+    void set_net_lanes(NetId net, uint64_t lanes) override;
+
+    uint64_t get_net_lanes(NetId net) const override
+    {
+        return m_net_values[net];
+    }
+
+    /**
+     * Process changes until the circuit is stable or a loop oscillates.
+     */
+    void simulate() override;
+
+    /**
+     * Process all changes up to and including the given time and move the
+     * current time there. This is not limited by oscillating loops.
+     */
+    void simulate_until(Time end_time);
+
+    /**
+     * The flip-flop outputs change after the delay of flip-flops.
+     */
+    void clock() override;
+
+    bool has_oscillation() const override
+    {
+        return m_loop_counter.is_exceeded();
+    }
+
+    size_t state_word_amount() const override
+    {
+        return m_net_values.size();
+    }
+
+    void read_state(MutableArrayRef<uint64_t> r_words) const override;
+
+    /**
+     * The current time does not change.
+     */
+    void write_state(ArrayRef<uint64_t> words) override;
+
+    ArrayRef<uint64_t> value_words() const override
+    {
+        return m_net_values;
+    }
+
+    size_t net_value_word_index(NetId net) const override
+    {
+        return net;
+    }
+
+    uint32_t net_value_word_amount() const override
+    {
+        return 1;
+    }
+
+    Time current_time() const
+    {
+        return m_pending_changes.current_time();
+    }
+
+    void set_change_listener(ChangeListener *listener)
+    {
+        m_listener = listener;
+    }
+
+  private:
+    void schedule_change(uint64_t delay, NetId net, uint64_t lanes);
+    void process_current_time();
+};
+
+}  // namespace gate_sim
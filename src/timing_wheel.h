@@ -0,0 +1,115 @@
+#pragma once
+
+#include "bas/vector.h"
+
+namespace gate_sim {
+
+using bas::size_t;
+using bas::uint64_t;
+using bas::Vector;
+
+/**
+ * Priority queue for events that happen at most max_delay time units after
+ * the current time, also known as calendar queue.
+ *
+ * There is one bucket for every time in a window that is larger than the
+ * maximum delay. Since no event is further in the future than the window
+ * size, every bucket only contains events of a single time. Inserting an
+ * event appends it to its bucket and taking out the events of a time swaps
+ * out the entire bucket. Both are O(1), independent of the number of pending
+ * events. Finding the next time that has events is amortized O(1) per time
+ * unit.
+ */
+template<typename T> class TimingWheel {
+  private:
+    Vector<Vector<T>> m_buckets;
+    uint64_t m_mask;
+    uint64_t m_current_time = 0;
+    size_t m_size = 0;
+
+  public:
+    TimingWheel(uint64_t max_delay = 1)
+    {
+        uint64_t bucket_amount = 1;
+        while (bucket_amount <= max_delay) {
+            bucket_amount *= 2;
+        }
+        m_buckets = Vector<Vector<T>>(bucket_amount);
+        m_mask = bucket_amount - 1;
+    }
+
+    uint64_t current_time() const
+    {
+        return m_current_time;
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    bool is_empty() const
+    {
+        return m_size == 0;
+    }
+
+    /**
+     * Remove all events without changing the current time.
+     */
+    void clear()
+    {
+        for (Vector<T> &bucket : m_buckets) {
+            bucket.clear();
+        }
+        m_size = 0;
+    }
+
+    /**
+     * Add an event that happens delay time units after the current time. The
+     * delay can be zero.
+     */
+    void insert(uint64_t delay, const T &event)
+    {
+        assert(delay <= m_mask);
+        m_buckets[(m_current_time + delay) & m_mask].append(event);
+        m_size++;
+    }
+
+    /**
+     * Get the earliest time that has events. The queue must not be empty.
+     */
+    uint64_t next_time() const
+    {
+        assert(!this->is_empty());
+        uint64_t time = m_current_time;
+        while (m_buckets[time & m_mask].is_empty()) {
+            time++;
+        }
+        return time;
+    }
+
+    /**
+     * Move the current time forward. There must not be any events before the
+     * new time.
+     */
+    void advance(uint64_t time)
+    {
+        assert(time >= m_current_time);
+        assert(this->is_empty() || time <= this->next_time());
+        m_current_time = time;
+    }
+
+    /**
+     * Move all events of the current time into r_events, in the order they
+     * have been inserted. The previous content of r_events is discarded, but
+     * its memory is reused for later events.
+     */
+    void pop_current(Vector<T> &r_events)
+    {
+        r_events.clear();
+        std::swap(r_events, m_buckets[m_current_time & m_mask]);
+        m_size -= r_events.size();
+    }
+};
+
+}  // namespace gate_sim
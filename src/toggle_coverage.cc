@@ -0,0 +1,102 @@
+#include "toggle_coverage.h"
+
+namespace gate_sim {
+
+ToggleCoverage::ToggleCoverage(const Simulator &simulator,
+                               InstructionSet instruction_set)
+    : m_simulator(simulator),
+      m_words_per_item((uint32_t)simulator.net_value_word_amount()),
+      m_count_fn(simulator.net_value_layout() == NetValueLayout::FourState ?
+                     get_count_four_state_toggles_fn(instruction_set) :
+                     get_count_toggles_fn(instruction_set, m_words_per_item))
+{
+}
+
+void ToggleCoverage::count_cycle()
+{
+    ArrayRef<uint64_t> values = m_simulator.value_words();
+    size_t old_word_amount = m_last_values.size();
+    assert(values.size() >= old_word_amount);
+    if (m_cycle_amount > 0 || old_word_amount > 0) {
+        m_cycle_amount++;
+    }
+    assert(values.size() % m_words_per_item == 0);
+    m_count_fn(values.begin(),
+               m_last_values.begin(),
+               m_rise_counts.begin(),
+               m_fall_counts.begin(),
+               m_rise_counts.size(),
+               m_words_per_item);
+    for (size_t i = old_word_amount; i < values.size(); i++) {
+        m_last_values.append(values[i]);
+    }
+    while (m_rise_counts.size() < values.size() / m_words_per_item) {
+        m_rise_counts.append(0);
+        m_fall_counts.append(0);
+    }
+}
+
+uint64_t ToggleCoverage::item_count(NetId net,
+                                    const Vector<uint64_t> &counts) const
+{
+    size_t item = m_simulator.net_value_word_index(net) / m_words_per_item;
+    /* Nets that were added after the last counted cycle. */
+    if (item >= counts.size()) {
+        return 0;
+    }
+    return counts[item];
+}
+
+uint64_t ToggleCoverage::rise_amount(NetId net) const
+{
+    /* The values of an inverted net fall when the counted words rise. */
+    bool is_inverted = m_simulator.net_value_is_inverted(net);
+    return this->item_count(net, is_inverted ? m_fall_counts : m_rise_counts);
+}
+
+uint64_t ToggleCoverage::fall_amount(NetId net) const
+{
+    bool is_inverted = m_simulator.net_value_is_inverted(net);
+    return this->item_count(net, is_inverted ? m_rise_counts : m_fall_counts);
+}
+
+static uint32_t histogram_bucket(uint64_t toggle_amount)
+{
+    uint32_t bucket = 0;
+    while (toggle_amount > 0) {
+        toggle_amount >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+ToggleSummary ToggleCoverage::summarize(uint32_t net_amount,
+                                        uint32_t max_never_toggled_nets) const
+{
+    ToggleSummary summary;
+    summary.cycle_amount = m_cycle_amount;
+    summary.net_amount = net_amount;
+    for (NetId net = 0; net < net_amount; net++) {
+        uint64_t rise_amount = this->rise_amount(net);
+        uint64_t fall_amount = this->fall_amount(net);
+        uint64_t toggle_amount = rise_amount + fall_amount;
+        summary.toggle_amount += toggle_amount;
+        if (rise_amount > 0 && fall_amount > 0) {
+            summary.covered_net_amount++;
+        }
+        if (toggle_amount == 0) {
+            summary.never_toggled_net_amount++;
+            if (summary.never_toggled_nets.size() < max_never_toggled_nets) {
+                summary.never_toggled_nets.append(net);
+            }
+        }
+        uint32_t bucket = histogram_bucket(toggle_amount);
+        while (summary.histogram.size() <= bucket) {
+            summary.histogram.append(0);
+        }
+        summary.histogram[bucket]++;
+    }
+    return summary;
+}
+
+}  // namespace gate_sim
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "lane_kernels.h"
+#include "simulator.h"
+
+namespace gate_sim {
+
+/**
+ * Statistics about the toggles of all nets of a circuit.
+ */
+struct ToggleSummary {
+    uint64_t cycle_amount = 0;
+    uint64_t toggle_amount = 0;
+    uint32_t net_amount = 0;
+    /* Nets that rose and fell at least once in any lane. */
+    uint32_t covered_net_amount = 0;
+    /* Number of nets by toggle amount. The first bucket contains the nets
+     * that never toggled, bucket i > 0 the nets with [2^(i-1), 2^i)
+     * toggles. */
+    Vector<uint32_t> histogram;
+    /* At most the requested number of nets that never toggled. */
+    Vector<NetId> never_toggled_nets;
+    uint32_t never_toggled_net_amount = 0;
+};
+
+/**
+ * Counts how often the nets of a simulator rise and fall between cycles,
+ * summed over all lanes. This is used as a coverage metric and to find logic
+ * that never changes.
+ *
+ * Counting works directly on the value words of the simulator without
+ * knowing which words belong to which net. The words are processed in items
+ * of the words that hold the lanes of one net, so the update is a single
+ * vectorized pass of XOR, AND and popcount with one pair of counters per
+ * item. Items whose words did not change are skipped after the XOR.
+ *
+ * Four-state simulators only count changes between known zeros and ones,
+ * lanes that become or stop being unknown do not toggle.
+ */
+class ToggleCoverage {
+  private:
+    const Simulator &m_simulator;
+    uint32_t m_words_per_item;
+    CountTogglesFn m_count_fn;
+    uint64_t m_cycle_amount = 0;
+    Vector<uint64_t> m_last_values;
+    Vector<uint64_t> m_rise_counts;
+    Vector<uint64_t> m_fall_counts;
+
+  public:
+    ToggleCoverage(const Simulator &simulator,
+                   InstructionSet instruction_set = best_instruction_set());
+
+    /**
+     * Compare the current values of the simulator with the values of the
+     * last counted cycle. The first call only remembers the values. Values
+     * that the simulator got since the last call, e.g. because gates were
+     * added, start without toggles.
+     */
+    void count_cycle();
+
+    /**
+     * Number of cycles in which toggles were counted.
+     */
+    uint64_t cycle_amount() const
+    {
+        return m_cycle_amount;
+    }
+
+    uint64_t rise_amount(NetId net) const;
+    uint64_t fall_amount(NetId net) const;
+
+    uint64_t toggle_amount(NetId net) const
+    {
+        return this->rise_amount(net) + this->fall_amount(net);
+    }
+
+    bool is_covered(NetId net) const
+    {
+        return this->rise_amount(net) > 0 && this->fall_amount(net) > 0;
+    }
+
+    ToggleSummary summarize(uint32_t net_amount,
+                            uint32_t max_never_toggled_nets = 100) const;
+
+  private:
+    uint64_t item_count(NetId net, const Vector<uint64_t> &counts) const;
+};
+
+}  // namespace gate_sim
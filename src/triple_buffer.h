@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+
+#include "bas/utildefines.h"
+
+namespace gate_sim {
+
+using bas::uint8_t;
+
+#ifdef _MSC_VER
+/* MSVC warns that the indices below are padded to whole cache lines,
+ * which is their purpose. */
+#    pragma warning(push)
+#    pragma warning(disable : 4324)
+#endif
+
+/**
+ * Passes the latest version of a value from one writer thread to one reader
+ * thread without locks. Neither side ever waits for the other.
+ *
+ * There are three buffers: the writer owns one, the reader owns one and the
+ * third one is in the middle. Publishing swaps the writer's buffer with the
+ * middle one, reading swaps the middle buffer with the reader's one when it
+ * contains a value that has not been read yet. Versions that are published
+ * while the reader is busy are overwritten, so the reader always sees the
+ * newest complete value.
+ *
+ * After publishing, the write buffer contains an older value, so the writer
+ * has to fill it completely before publishing again.
+ */
+template<typename T> class TripleBuffer : bas::NonCopyable, bas::NonMovable {
+  private:
+    static constexpr uint8_t INDEX_MASK = 3;
+    static constexpr uint8_t FRESH_FLAG = 4;
+
+    T m_buffers[3];
+    /* Index of the middle buffer and whether it has not been read yet. */
+    alignas(64) std::atomic<uint8_t> m_middle{1};
+    alignas(64) uint8_t m_write_index = 0;
+    alignas(64) uint8_t m_read_index = 2;
+
+  public:
+    TripleBuffer(const T &initial_value)
+        : m_buffers{initial_value, initial_value, initial_value}
+    {
+    }
+
+    /**
+     * Buffer that the writer fills before it calls publish.
+     */
+    T &write_buffer()
+    {
+        return m_buffers[m_write_index];
+    }
+
+    void publish()
+    {
+        uint8_t old_middle = m_middle.exchange(m_write_index | FRESH_FLAG,
+                                               std::memory_order_acq_rel);
+        m_write_index = old_middle & INDEX_MASK;
+    }
+
+    /**
+     * True when the last published value has not been read yet. A writer
+     * that produces values faster than they are read can use this to skip
+     * work.
+     */
+    bool has_unread_value() const
+    {
+        return m_middle.load(std::memory_order_relaxed) & FRESH_FLAG;
+    }
+
+    /**
+     * Make the latest published value available in the read buffer. Returns
+     * false when nothing was published since the last call.
+     */
+    bool read_latest()
+    {
+        if (!this->has_unread_value()) {
+            return false;
+        }
+        uint8_t old_middle = m_middle.exchange(m_read_index,
+                                               std::memory_order_acq_rel);
+        m_read_index = old_middle & INDEX_MASK;
+        return true;
+    }
+
+    const T &read_buffer() const
+    {
+        return m_buffers[m_read_index];
+    }
+};
+
+#ifdef _MSC_VER
+#    pragma warning(pop)
+#endif
+
+}  // namespace gate_sim
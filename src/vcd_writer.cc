@@ -0,0 +1,158 @@
+#include <charconv>
+#include <chrono>
+
+#include "vcd_writer.h"
+
+namespace gate_sim {
+
+static constexpr size_t RING_BUFFER_CAPACITY = 1 << 20;
+/* Text is collected until it has this size before it is written. */
+static constexpr size_t WRITE_BLOCK_SIZE = 1 << 20;
+/* Number of records that the writer thread takes at once. */
+static constexpr size_t READ_BATCH_SIZE = 4096;
+/* How long the writer thread sleeps when there are no records. */
+static constexpr std::chrono::milliseconds IDLE_SLEEP_TIME{1};
+
+/**
+ * Short identifier of a variable, made of the printable characters that
+ * the format allows.
+ */
+static std::string vcd_identifier(uint32_t index)
+{
+    constexpr uint32_t first_char = '!';
+    constexpr uint32_t char_amount = '~' - '!' + 1;
+    std::string identifier;
+    do {
+        identifier.push_back((char)(first_char + index % char_amount));
+        index /= char_amount;
+    } while (index > 0);
+    return identifier;
+}
+
+VcdWriter::VcdWriter(std::FILE *file,
+                     const Circuit &circuit,
+                     ArrayRef<NetId> nets)
+    : m_file(file),
+      m_nets(nets),
+      m_ring_buffer(RING_BUFFER_CAPACITY)
+{
+    m_last_values = Vector<Logic4>(nets.size(), Logic4::X);
+
+    std::string header =
+        "$version gate_sim $end\n"
+        "$timescale 1ns $end\n"
+        "$scope module circuit $end\n";
+    for (size_t i : nets.index_range()) {
+        m_identifiers.append(vcd_identifier((uint32_t)i));
+        const std::string &name = circuit.net_name(nets[i]);
+        header += "$var wire 1 " + m_identifiers[i] + " " +
+                  (name.empty() ? "net" + std::to_string(nets[i]) : name) +
+                  " $end\n";
+    }
+    header += "$upscope $end\n$enddefinitions $end\n";
+    std::fwrite(header.data(), 1, header.size(), m_file);
+
+    m_thread = std::thread([this]() { this->run(); });
+}
+
+std::unique_ptr<VcdWriter> VcdWriter::Open(const char *path,
+                                           const Circuit &circuit,
+                                           ArrayRef<NetId> nets,
+                                           std::string &r_error)
+{
+    std::FILE *file = std::fopen(path, "wb");
+    if (file == nullptr) {
+        r_error = "cannot create file";
+        return {};
+    }
+    return std::unique_ptr<VcdWriter>(new VcdWriter(file, circuit, nets));
+}
+
+VcdWriter::~VcdWriter()
+{
+    m_should_stop.store(true, std::memory_order_release);
+    m_thread.join();
+    std::fclose(m_file);
+}
+
+void VcdWriter::record_cycle(uint64_t cycle, const Simulator &simulator)
+{
+    if (m_has_recorded_cycle && cycle < m_last_cycle) {
+        return;
+    }
+    /* The first cycle contains the initial values of all nets. */
+    bool is_first_cycle = !m_has_recorded_cycle;
+    bool needs_cycle_record = is_first_cycle || cycle != m_last_cycle;
+    m_has_recorded_cycle = true;
+
+    m_records.clear();
+    for (size_t i : m_nets.index_range()) {
+        Logic4 value = simulator.get_net_logic(m_nets[i]);
+        if (!is_first_cycle && value == m_last_values[i]) {
+            continue;
+        }
+        /* Cycles without changes are not written at all. */
+        if (needs_cycle_record) {
+            m_records.append(CYCLE_FLAG | cycle);
+            m_last_cycle = cycle;
+            needs_cycle_record = false;
+        }
+        m_last_values[i] = value;
+        m_records.append(((uint64_t)i << 2) | (uint64_t)value);
+    }
+
+    const uint64_t *records = m_records.begin();
+    size_t remaining_amount = m_records.size();
+    while (remaining_amount > 0) {
+        size_t amount = m_ring_buffer.write(records, remaining_amount);
+        records += amount;
+        remaining_amount -= amount;
+        if (amount == 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void VcdWriter::run()
+{
+    uint64_t records[READ_BATCH_SIZE];
+    while (true) {
+        /* Checked before reading, so that all records that were written
+         * before stopping are read. */
+        bool should_stop = m_should_stop.load(std::memory_order_acquire);
+        size_t amount = m_ring_buffer.read(records, READ_BATCH_SIZE);
+        for (size_t i = 0; i < amount; i++) {
+            this->format_record(records[i]);
+        }
+        /* Write everything when idle, so that the file is up to date. */
+        if (m_text.size() >= WRITE_BLOCK_SIZE || amount == 0) {
+            std::fwrite(m_text.data(), 1, m_text.size(), m_file);
+            m_text.clear();
+        }
+        if (amount == 0) {
+            if (should_stop) {
+                break;
+            }
+            std::fflush(m_file);
+            std::this_thread::sleep_for(IDLE_SLEEP_TIME);
+        }
+    }
+}
+
+void VcdWriter::format_record(uint64_t record)
+{
+    if (record & CYCLE_FLAG) {
+        char buffer[24];
+        std::to_chars_result result = std::to_chars(
+            buffer, buffer + sizeof(buffer), record & ~CYCLE_FLAG);
+        m_text.push_back('#');
+        m_text.append(buffer, result.ptr);
+    }
+    else {
+        m_text.push_back(logic4_char((Logic4)(record & 3)));
+        m_text += m_identifiers[record >> 2];
+    }
+    m_text.push_back('\n');
+}
+
+}  // namespace gate_sim
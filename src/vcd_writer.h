@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "circuit.h"
+#include "ring_buffer.h"
+#include "simulator.h"
+
+namespace gate_sim {
+
+/**
+ * Writes the values of selected nets in lane 0 to a file in the Value Change
+ * Dump format, with one time step per cycle.
+ *
+ * The simulation only compares the values with those of the last recorded
+ * cycle and appends one compact record per change to a ring buffer. A
+ * separate thread turns the records into text and writes it to the file in
+ * large blocks. So the cost for the simulation is independent of the
+ * formatting and of the speed of the disk, as long as the writer keeps up on
+ * average. Otherwise the simulation waits when the buffer is full, because
+ * changes must not be lost.
+ */
+class VcdWriter : bas::NonCopyable, bas::NonMovable {
+  private:
+    /* Records either contain the index of a net in the upper and its new
+     * value in the lower bits, or the start of a cycle. */
+    static constexpr uint64_t CYCLE_FLAG = (uint64_t)1 << 63;
+
+    std::FILE *m_file;
+    Vector<NetId> m_nets;
+
+    /* Used by the simulation. */
+    Vector<Logic4> m_last_values;
+    Vector<uint64_t> m_records;
+    bool m_has_recorded_cycle = false;
+    uint64_t m_last_cycle = 0;
+
+    RingBuffer<uint64_t> m_ring_buffer;
+    std::atomic<bool> m_should_stop{false};
+    std::thread m_thread;
+
+    /* Used by the writer thread. */
+    Vector<std::string> m_identifiers;
+    std::string m_text;
+
+  public:
+    /**
+     * Create the file and write the header, which declares the nets with
+     * their names in the circuit. Returns null and sets the error message
+     * when the file cannot be created.
+     */
+    static std::unique_ptr<VcdWriter> Open(const char *path,
+                                           const Circuit &circuit,
+                                           ArrayRef<NetId> nets,
+                                           std::string &r_error);
+
+    /**
+     * Write all remaining records and close the file.
+     */
+    ~VcdWriter();
+
+    /**
+     * Record the current values of the nets as the values at the end of the
+     * given cycle. Only changes are written. Recording the same cycle again,
+     * e.g. after inputs changed without a clock edge, adds the new changes
+     * to it. Cycles before the last written one are ignored, because times in
+     * the file must not decrease.
+     */
+    void record_cycle(uint64_t cycle, const Simulator &simulator);
+
+  private:
+    VcdWriter(std::FILE *file, const Circuit &circuit, ArrayRef<NetId> nets);
+
+    void run();
+    void format_record(uint64_t record);
+};
+
+}  // namespace gate_sim
@@ -0,0 +1,2244 @@
+#include <algorithm>
+
+#include "bas/string_map.h"
+
+#include "verilog_format.h"
+
+namespace gate_sim {
+
+using bas::ssize_t;
+using bas::StringMap;
+
+/* Used for optional nets that are not connected. */
+static constexpr NetId NO_NET = (NetId)-1;
+
+/* Limits the memory that a single declaration or constant can use. */
+static constexpr uint32_t MAX_SIGNAL_WIDTH = 1 << 20;
+
+/* Instances can be nested at most this deep, which also stops recursive
+ * instantiation. */
+static constexpr uint32_t MAX_HIERARCHY_DEPTH = 256;
+
+enum class TokenType : uint8_t {
+    End,
+    Identifier,
+    Number,
+    String,
+    Symbol,
+    /* Unterminated comment or attribute. */
+    Invalid,
+};
+
+struct Token {
+    TokenType type;
+    /* Escaped identifiers include the backslash. */
+    StringRef text;
+    uint32_t line;
+
+    bool is(const char *symbol) const
+    {
+        return type == TokenType::Symbol && text == symbol;
+    }
+
+    /**
+     * Escaped identifiers are never keywords.
+     */
+    bool is_keyword(const char *keyword) const
+    {
+        return type == TokenType::Identifier && text == keyword;
+    }
+
+    /**
+     * Name of an identifier without the backslash of escaped identifiers.
+     */
+    StringRef name() const
+    {
+        return text.startswith('\\') ? text.drop_prefix(1) : text;
+    }
+};
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static bool is_identifier_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || is_digit(c) ||
+           c == '_' || c == '$';
+}
+
+static bool is_whitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' ||
+           c == '\v';
+}
+
+static std::string quoted(StringRef text)
+{
+    return "'" + std::string(text) + "'";
+}
+
+/**
+ * Splits the text into tokens on demand. Tokens reference the text, so
+ * nothing is allocated per identifier. Comments, attributes and compiler
+ * directives are skipped.
+ */
+class VerilogLexer {
+  private:
+    StringRef m_text;
+    size_t m_position = 0;
+    uint32_t m_line;
+
+  public:
+    VerilogLexer(StringRef text, uint32_t first_line)
+        : m_text(text), m_line(first_line)
+    {
+    }
+
+    Token next()
+    {
+        if (!this->skip_whitespace_and_comments()) {
+            return {TokenType::Invalid, StringRef(), m_line};
+        }
+        uint32_t line = m_line;
+        size_t size = m_text.size();
+        size_t start = m_position;
+        if (start == size) {
+            return {TokenType::End, StringRef(), line};
+        }
+        char c = m_text[start];
+        TokenType type = TokenType::Symbol;
+        if (c == '\\') {
+            /* Escaped identifiers end at whitespace. */
+            do {
+                m_position++;
+            } while (m_position < size && !is_whitespace(m_text[m_position]));
+            type = TokenType::Identifier;
+        }
+        else if (is_identifier_char(c) && !is_digit(c)) {
+            while (m_position < size &&
+                   is_identifier_char(m_text[m_position])) {
+                m_position++;
+            }
+            type = TokenType::Identifier;
+        }
+        else if (is_digit(c) || c == '\'') {
+            this->skip_number();
+            type = TokenType::Number;
+        }
+        else if (c == '"') {
+            m_position++;
+            while (m_position < size && m_text[m_position] != '"') {
+                if (m_text[m_position] == '\\') {
+                    m_position++;
+                }
+                else if (m_text[m_position] == '\n') {
+                    m_line++;
+                }
+                m_position++;
+            }
+            m_position = std::min(m_position + 1, size);
+            type = TokenType::String;
+        }
+        else {
+            m_position++;
+            for (const char *symbol : {"~^", "^~", "~&", "~|", "&&", "||"}) {
+                if (m_position < size && c == symbol[0] &&
+                    m_text[m_position] == symbol[1]) {
+                    m_position++;
+                    break;
+                }
+            }
+        }
+        return {type, m_text.substr(start, m_position - start), line};
+    }
+
+  private:
+    /**
+     * Skip decimal numbers and constants like 4'b10x1, 8'hff or 'd3.
+     */
+    void skip_number()
+    {
+        size_t size = m_text.size();
+        auto skip_digits = [&]() {
+            while (m_position < size && (is_digit(m_text[m_position]) ||
+                                         m_text[m_position] == '_')) {
+                m_position++;
+            }
+        };
+        skip_digits();
+        /* Fractions only appear in delays. */
+        if (m_position + 1 < size && m_text[m_position] == '.' &&
+            is_digit(m_text[m_position + 1])) {
+            m_position++;
+            skip_digits();
+        }
+        if (m_position < size && m_text[m_position] == '\'') {
+            m_position++;
+            /* The signedness, base and digits, which can be x, z or ?. */
+            while (m_position < size &&
+                   (is_identifier_char(m_text[m_position]) ||
+                    m_text[m_position] == '?')) {
+                m_position++;
+            }
+        }
+    }
+
+    /**
+     * Returns false when a comment or attribute is not terminated.
+     */
+    bool skip_whitespace_and_comments()
+    {
+        size_t size = m_text.size();
+        while (m_position < size) {
+            char c = m_text[m_position];
+            char next = m_position + 1 < size ? m_text[m_position + 1] : '\0';
+            if (c == '\n') {
+                m_line++;
+                m_position++;
+            }
+            else if (is_whitespace(c)) {
+                m_position++;
+            }
+            else if ((c == '/' && next == '/') || c == '`') {
+                /* Line comments and compiler directives. */
+                while (m_position < size && m_text[m_position] != '\n') {
+                    m_position++;
+                }
+            }
+            else if (c == '/' && next == '*') {
+                if (!this->skip_block("*/")) {
+                    return false;
+                }
+            }
+            else if (c == '(' && next == '*' &&
+                     (m_position + 2 == size ||
+                      m_text[m_position + 2] != ')')) {
+                /* Attributes like (* keep *). */
+                if (!this->skip_block("*)")) {
+                    return false;
+                }
+            }
+            else {
+                break;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Skip a block that starts with two characters at the current position
+     * and ends with the given two characters.
+     */
+    bool skip_block(const char *end)
+    {
+        for (size_t i = m_position + 2; i + 1 < m_text.size(); i++) {
+            if (m_text[i] == end[0] && m_text[i + 1] == end[1]) {
+                m_position = i + 2;
+                return true;
+            }
+            if (m_text[i] == '\n') {
+                m_line++;
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * Range of the text that contains an expression. It is only split into
+ * tokens again when the module is elaborated.
+ */
+struct VerilogExpression {
+    StringRef text;
+    uint32_t line = 0;
+};
+
+enum class SignalKind : uint8_t {
+    Input,
+    Output,
+    Inout,
+    Wire,
+    Supply0,
+    Supply1,
+};
+
+struct SignalDeclaration {
+    SignalKind kind;
+    StringRef name;
+    int32_t msb = 0;
+    int32_t lsb = 0;
+    /* Scalars have no range, their net has no index in the name. */
+    bool is_vector = false;
+    uint32_t line = 0;
+};
+
+struct Assignment {
+    VerilogExpression lhs;
+    VerilogExpression rhs;
+};
+
+struct PortConnection {
+    /* Empty for connections by position. */
+    StringRef port;
+    /* Empty for unconnected ports. */
+    VerilogExpression expression;
+};
+
+/**
+ * Instance of a primitive, a cell or a module.
+ */
+struct ModuleInstance {
+    StringRef type;
+    StringRef name;
+    uint32_t line;
+    /* Range in the connections of the module. */
+    uint32_t connection_start;
+    uint32_t connection_amount;
+};
+
+struct VerilogModule {
+    StringRef name;
+    uint32_t line;
+    Vector<StringRef> ports;
+    Vector<SignalDeclaration> signals;
+    Vector<Assignment> assignments;
+    Vector<ModuleInstance> instances;
+    Vector<PortConnection> connections;
+};
+
+static bool is_opening_bracket(const Token &token)
+{
+    return token.is("(") || token.is("[") || token.is("{");
+}
+
+static bool is_closing_bracket(const Token &token)
+{
+    return token.is(")") || token.is("]") || token.is("}");
+}
+
+static bool is_port_kind(SignalKind kind)
+{
+    return kind == SignalKind::Input || kind == SignalKind::Output ||
+           kind == SignalKind::Inout;
+}
+
+static bool get_direction(const Token &token, SignalKind &r_kind)
+{
+    if (token.is_keyword("input")) {
+        r_kind = SignalKind::Input;
+    }
+    else if (token.is_keyword("output")) {
+        r_kind = SignalKind::Output;
+    }
+    else if (token.is_keyword("inout")) {
+        r_kind = SignalKind::Inout;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Net types that are all treated like wires, and the data types that can
+ * follow them.
+ */
+static bool is_net_type(const Token &token)
+{
+    for (const char *keyword : {"wire",
+                                "tri",
+                                "reg",
+                                "logic",
+                                "wand",
+                                "wor",
+                                "tri0",
+                                "tri1",
+                                "triand",
+                                "trior",
+                                "uwire",
+                                "signed",
+                                "unsigned"}) {
+        if (token.is_keyword(keyword)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool token_to_integer(const Token &token, int32_t &r_value)
+{
+    if (token.type != TokenType::Number) {
+        return false;
+    }
+    int64_t value = 0;
+    for (char c : token.text) {
+        if (c == '_') {
+            continue;
+        }
+        if (!is_digit(c)) {
+            return false;
+        }
+        value = value * 10 + (c - '0');
+        if (value > INT32_MAX) {
+            return false;
+        }
+    }
+    r_value = (int32_t)value;
+    return true;
+}
+
+/**
+ * Get the bits of a constant, least significant first. Unknown and high
+ * impedance digits become zero. Numbers without a size have 32 bits.
+ */
+static bool parse_number_bits(StringRef text, Vector<bool> &r_bits)
+{
+    r_bits.clear();
+    ssize_t quote = text.try_first_index_of('\'');
+    uint32_t width = 32;
+    StringRef digits = text;
+    /* Bits per digit, zero for decimal numbers. */
+    uint32_t digit_bits = 0;
+    if (quote >= 0) {
+        if (quote > 0) {
+            width = 0;
+            for (char c : text.substr(0, (size_t)quote)) {
+                if (c == '_') {
+                    continue;
+                }
+                if (!is_digit(c)) {
+                    return false;
+                }
+                width = width * 10 + (uint32_t)(c - '0');
+                if (width > MAX_SIGNAL_WIDTH) {
+                    return false;
+                }
+            }
+            if (width == 0) {
+                return false;
+            }
+        }
+        size_t base_index = (size_t)quote + 1;
+        if (base_index < text.size() &&
+            (text[base_index] == 's' || text[base_index] == 'S')) {
+            base_index++;
+        }
+        if (base_index >= text.size()) {
+            return false;
+        }
+        switch (text[base_index] | 0x20) {
+            case 'b':
+                digit_bits = 1;
+                break;
+            case 'o':
+                digit_bits = 3;
+                break;
+            case 'h':
+                digit_bits = 4;
+                break;
+            case 'd':
+                break;
+            default:
+                return false;
+        }
+        digits = text.drop_prefix(base_index + 1);
+    }
+    if (digits.size() == 0) {
+        return false;
+    }
+
+    if (digit_bits == 0) {
+        uint64_t value = 0;
+        for (char c : digits) {
+            char lower = c | 0x20;
+            if (c == '_' || lower == 'x' || lower == 'z' || c == '?') {
+                continue;
+            }
+            if (!is_digit(c)) {
+                return false;
+            }
+            value = value * 10 + (uint64_t)(c - '0');
+        }
+        for (uint32_t i = 0; i < width; i++) {
+            r_bits.append(i < 64 && ((value >> i) & 1) != 0);
+        }
+        return true;
+    }
+    for (size_t i = digits.size(); i-- > 0;) {
+        char c = digits[i];
+        char lower = c | 0x20;
+        uint32_t value;
+        if (c == '_') {
+            continue;
+        }
+        if (is_digit(c)) {
+            value = (uint32_t)(c - '0');
+        }
+        else if (lower >= 'a' && lower <= 'f') {
+            value = (uint32_t)(lower - 'a' + 10);
+        }
+        else if (lower == 'x' || lower == 'z' || c == '?') {
+            value = 0;
+        }
+        else {
+            return false;
+        }
+        if ((value >> digit_bits) != 0) {
+            return false;
+        }
+        for (uint32_t bit = 0; bit < digit_bits; bit++) {
+            r_bits.append(((value >> bit) & 1) != 0);
+        }
+        if (r_bits.size() > MAX_SIGNAL_WIDTH) {
+            return false;
+        }
+    }
+    while (r_bits.size() > width) {
+        r_bits.remove_last();
+    }
+    while (r_bits.size() < width) {
+        r_bits.append(false);
+    }
+    return true;
+}
+
+/**
+ * Parses the modules of the text. Expressions are only captured as ranges
+ * of the text here, because their meaning depends on the declarations of
+ * the module instance they are evaluated in.
+ */
+class VerilogParser {
+  private:
+    VerilogLexer m_lexer;
+    Token m_token;
+    /* End of the last consumed token, to capture expressions. */
+    const char *m_previous_end = nullptr;
+    Vector<VerilogModule> &m_modules;
+    std::string m_error;
+
+  public:
+    VerilogParser(StringRef text, Vector<VerilogModule> &r_modules)
+        : m_lexer(text, 1), m_token(m_lexer.next()), m_modules(r_modules)
+    {
+    }
+
+    bool parse()
+    {
+        while (m_token.type != TokenType::End) {
+            if (m_token.is_keyword("module") ||
+                m_token.is_keyword("macromodule")) {
+                this->advance();
+                if (!this->parse_module()) {
+                    return false;
+                }
+            }
+            else if (m_token.is_keyword("primitive")) {
+                return this->error(
+                    "user defined primitives are not supported");
+            }
+            else {
+                return this->error_unexpected();
+            }
+        }
+        return true;
+    }
+
+    const std::string &error() const
+    {
+        return m_error;
+    }
+
+  private:
+    bool error(const std::string &message)
+    {
+        m_error = "line " + std::to_string(m_token.line) + ": " + message;
+        return false;
+    }
+
+    std::string describe_token() const
+    {
+        switch (m_token.type) {
+            case TokenType::End:
+                return "end of file";
+            case TokenType::Invalid:
+                return "unterminated comment";
+            default:
+                return quoted(m_token.text);
+        }
+    }
+
+    bool error_unexpected()
+    {
+        return this->error("unexpected " + this->describe_token());
+    }
+
+    void advance()
+    {
+        m_previous_end = m_token.text.end();
+        m_token = m_lexer.next();
+    }
+
+    bool accept(const char *symbol)
+    {
+        if (m_token.is(symbol)) {
+            this->advance();
+            return true;
+        }
+        return false;
+    }
+
+    bool expect(const char *symbol)
+    {
+        if (this->accept(symbol)) {
+            return true;
+        }
+        return this->error("expected " + quoted(symbol) + " instead of " +
+                           this->describe_token());
+    }
+
+    bool expect_identifier(StringRef &r_name)
+    {
+        if (m_token.type != TokenType::Identifier ||
+            m_token.name().size() == 0) {
+            return this->error("expected an identifier instead of " +
+                               this->describe_token());
+        }
+        r_name = m_token.name();
+        this->advance();
+        return true;
+    }
+
+    bool expect_integer(int32_t &r_value)
+    {
+        if (!token_to_integer(m_token, r_value)) {
+            return this->error("expected a constant number instead of " +
+                               this->describe_token());
+        }
+        this->advance();
+        return true;
+    }
+
+    /**
+     * Skip from an opening bracket to after the bracket that closes it.
+     */
+    bool skip_brackets()
+    {
+        int depth = 0;
+        do {
+            if (m_token.type == TokenType::End ||
+                m_token.type == TokenType::Invalid) {
+                return this->error_unexpected();
+            }
+            if (is_opening_bracket(m_token)) {
+                depth++;
+            }
+            else if (is_closing_bracket(m_token)) {
+                depth--;
+            }
+            this->advance();
+        } while (depth > 0);
+        return true;
+    }
+
+    bool skip_statement()
+    {
+        while (!m_token.is(";")) {
+            if (m_token.type == TokenType::End ||
+                m_token.type == TokenType::Invalid) {
+                return this->error_unexpected();
+            }
+            this->advance();
+        }
+        this->advance();
+        return true;
+    }
+
+    /**
+     * Delays and parameter values are ignored.
+     */
+    bool skip_delay()
+    {
+        if (!this->accept("#")) {
+            return true;
+        }
+        if (m_token.is("(")) {
+            return this->skip_brackets();
+        }
+        this->advance();
+        return true;
+    }
+
+    bool parse_range(int32_t &r_msb, int32_t &r_lsb)
+    {
+        return this->expect("[") && this->expect_integer(r_msb) &&
+               this->expect(":") && this->expect_integer(r_lsb) &&
+               this->expect("]");
+    }
+
+    /**
+     * Capture the tokens up to the next comma, semicolon, equal sign or
+     * closing parenthesis that is not nested in brackets. The expression is
+     * empty when there are no tokens.
+     */
+    bool capture_expression(VerilogExpression &r_expression)
+    {
+        const char *start = m_token.text.begin();
+        r_expression.line = m_token.line;
+        bool is_empty = true;
+        int depth = 0;
+        while (true) {
+            if (m_token.type == TokenType::End ||
+                m_token.type == TokenType::Invalid) {
+                return this->error_unexpected();
+            }
+            if (depth == 0 && (m_token.is(",") || m_token.is(";") ||
+                               m_token.is("=") || m_token.is(")"))) {
+                break;
+            }
+            if (is_opening_bracket(m_token)) {
+                depth++;
+            }
+            else if (is_closing_bracket(m_token)) {
+                if (depth == 0) {
+                    return this->error_unexpected();
+                }
+                depth--;
+            }
+            this->advance();
+            is_empty = false;
+        }
+        r_expression.text = is_empty ?
+                                StringRef() :
+                                StringRef(start, (size_t)(m_previous_end -
+                                                          start));
+        return true;
+    }
+
+    bool expect_expression(VerilogExpression &r_expression)
+    {
+        if (!this->capture_expression(r_expression)) {
+            return false;
+        }
+        if (r_expression.text.size() == 0) {
+            return this->error("expected an expression instead of " +
+                               this->describe_token());
+        }
+        return true;
+    }
+
+    bool parse_module()
+    {
+        VerilogModule module;
+        module.line = m_token.line;
+        if (!this->expect_identifier(module.name) || !this->skip_delay()) {
+            return false;
+        }
+        if (this->accept("(") && !this->parse_port_list(module)) {
+            return false;
+        }
+        if (!this->expect(";")) {
+            return false;
+        }
+        while (!m_token.is_keyword("endmodule")) {
+            if (!this->parse_module_item(module)) {
+                return false;
+            }
+        }
+        this->advance();
+        m_modules.append(std::move(module));
+        return true;
+    }
+
+    /**
+     * Parse a list of port names or of port declarations in the header.
+     */
+    bool parse_port_list(VerilogModule &module)
+    {
+        if (this->accept(")")) {
+            return true;
+        }
+        bool has_declarations = false;
+        SignalDeclaration declaration;
+        while (true) {
+            SignalKind kind;
+            if (get_direction(m_token, kind)) {
+                /* Following names without a direction share it. */
+                has_declarations = true;
+                declaration = SignalDeclaration();
+                declaration.kind = kind;
+                this->advance();
+                while (is_net_type(m_token)) {
+                    this->advance();
+                }
+                if (m_token.is("[")) {
+                    if (!this->parse_range(declaration.msb, declaration.lsb)) {
+                        return false;
+                    }
+                    declaration.is_vector = true;
+                }
+            }
+            declaration.line = m_token.line;
+            if (!this->expect_identifier(declaration.name)) {
+                return false;
+            }
+            module.ports.append(declaration.name);
+            if (has_declarations) {
+                module.signals.append(declaration);
+            }
+            if (!this->accept(",")) {
+                break;
+            }
+        }
+        return this->expect(")");
+    }
+
+    bool parse_module_item(VerilogModule &module)
+    {
+        SignalKind kind;
+        if (get_direction(m_token, kind)) {
+            this->advance();
+            return this->parse_declaration(module, kind);
+        }
+        if (is_net_type(m_token)) {
+            return this->parse_declaration(module, SignalKind::Wire);
+        }
+        if (m_token.is_keyword("supply0") || m_token.is_keyword("supply1")) {
+            kind = m_token.is_keyword("supply0") ? SignalKind::Supply0 :
+                                                   SignalKind::Supply1;
+            this->advance();
+            return this->parse_declaration(module, kind);
+        }
+        if (m_token.is_keyword("assign")) {
+            return this->parse_assign(module);
+        }
+        if (m_token.is_keyword("parameter") ||
+            m_token.is_keyword("localparam") ||
+            m_token.is_keyword("defparam") || m_token.is_keyword("genvar")) {
+            return this->skip_statement();
+        }
+        if (m_token.is_keyword("specify")) {
+            /* Timing checks are ignored. */
+            while (!m_token.is_keyword("endspecify")) {
+                if (m_token.type == TokenType::End ||
+                    m_token.type == TokenType::Invalid) {
+                    return this->error_unexpected();
+                }
+                this->advance();
+            }
+            this->advance();
+            return true;
+        }
+        if (this->accept(";")) {
+            return true;
+        }
+        for (const char *keyword : {"always",
+                                    "always_comb",
+                                    "always_ff",
+                                    "always_latch",
+                                    "initial",
+                                    "function",
+                                    "task",
+                                    "generate",
+                                    "integer",
+                                    "real",
+                                    "time",
+                                    "event"}) {
+            if (m_token.is_keyword(keyword)) {
+                return this->error(quoted(keyword) + " is not supported");
+            }
+        }
+        if (m_token.type == TokenType::Identifier) {
+            return this->parse_instances(module);
+        }
+        return this->error_unexpected();
+    }
+
+    bool parse_declaration(VerilogModule &module, SignalKind kind)
+    {
+        while (is_net_type(m_token)) {
+            this->advance();
+        }
+        if (!this->skip_delay()) {
+            return false;
+        }
+        SignalDeclaration declaration;
+        declaration.kind = kind;
+        if (m_token.is("[")) {
+            if (!this->parse_range(declaration.msb, declaration.lsb)) {
+                return false;
+            }
+            declaration.is_vector = true;
+        }
+        while (true) {
+            Token name_token = m_token;
+            declaration.line = m_token.line;
+            if (!this->expect_identifier(declaration.name)) {
+                return false;
+            }
+            if (m_token.is("[")) {
+                return this->error("arrays are not supported");
+            }
+            module.signals.append(declaration);
+            if (this->accept("=")) {
+                /* Net declaration assignment. */
+                Assignment assignment;
+                assignment.lhs = {name_token.text, name_token.line};
+                if (!this->expect_expression(assignment.rhs)) {
+                    return false;
+                }
+                module.assignments.append(assignment);
+            }
+            if (!this->accept(",")) {
+                break;
+            }
+        }
+        return this->expect(";");
+    }
+
+    bool parse_assign(VerilogModule &module)
+    {
+        this->advance();
+        if (!this->skip_delay()) {
+            return false;
+        }
+        while (true) {
+            Assignment assignment;
+            if (!this->expect_expression(assignment.lhs) ||
+                !this->expect("=") ||
+                !this->expect_expression(assignment.rhs)) {
+                return false;
+            }
+            module.assignments.append(assignment);
+            if (!this->accept(",")) {
+                break;
+            }
+        }
+        return this->expect(";");
+    }
+
+    /**
+     * Parse one or more instances of the same type, like
+     *   and g1 (y1, a, b), g2 (y2, c, d);
+     *   my_module #(.W(4)) u1 (.a(x), .y(y[3:0]));
+     */
+    bool parse_instances(VerilogModule &module)
+    {
+        StringRef type = m_token.name();
+        this->advance();
+        if (!this->skip_delay()) {
+            return false;
+        }
+        while (true) {
+            ModuleInstance instance;
+            instance.type = type;
+            instance.line = m_token.line;
+            /* The names of primitive instances are optional. */
+            if (m_token.type == TokenType::Identifier) {
+                instance.name = m_token.name();
+                this->advance();
+            }
+            if (m_token.is("[")) {
+                return this->error("instance arrays are not supported");
+            }
+            if (!this->expect("(")) {
+                return false;
+            }
+            instance.connection_start = (uint32_t)module.connections.size();
+            if (!m_token.is(")")) {
+                while (true) {
+                    PortConnection connection;
+                    if (this->accept(".")) {
+                        if (!this->expect_identifier(connection.port) ||
+                            !this->expect("(") ||
+                            !this->capture_expression(connection.expression) ||
+                            !this->expect(")")) {
+                            return false;
+                        }
+                    }
+                    else if (!this->capture_expression(
+                                 connection.expression)) {
+                        return false;
+                    }
+                    module.connections.append(connection);
+                    if (!this->accept(",")) {
+                        break;
+                    }
+                }
+            }
+            if (!this->expect(")")) {
+                return false;
+            }
+            instance.connection_amount = (uint32_t)module.connections.size() -
+                                         instance.connection_start;
+            module.instances.append(instance);
+            if (!this->accept(",")) {
+                break;
+            }
+        }
+        return this->expect(";");
+    }
+};
+
+/**
+ * Gate primitives of Verilog. Gates have their output first, buffers have
+ * their input last and tristate buffers have an output, a data input and an
+ * enable input.
+ */
+struct PrimitiveType {
+    const char *name;
+    GateType type;
+    bool invert_data;
+    bool invert_enable;
+};
+
+static const PrimitiveType PRIMITIVE_TYPES[] = {
+    {"and", GateType::And, false, false},
+    {"nand", GateType::Nand, false, false},
+    {"or", GateType::Or, false, false},
+    {"nor", GateType::Nor, false, false},
+    {"xor", GateType::Xor, false, false},
+    {"xnor", GateType::Xnor, false, false},
+    {"buf", GateType::Buffer, false, false},
+    {"not", GateType::Not, false, false},
+    {"bufif0", GateType::Tristate, false, true},
+    {"bufif1", GateType::Tristate, false, false},
+    {"notif0", GateType::Tristate, true, true},
+    {"notif1", GateType::Tristate, true, false},
+};
+
+/**
+ * Simple cells of Yosys, which netlists contain when they are not mapped to
+ * a technology library. Their ports are connected by name.
+ */
+struct CellType {
+    const char *name;
+    GateType type;
+    const char *inputs[3];
+    const char *output;
+    /* For cells like $_ANDNOT_, which compute A & ~B. */
+    bool invert_second;
+};
+
+static const CellType CELL_TYPES[] = {
+    {"$_BUF_", GateType::Buffer, {"A"}, "Y", false},
+    {"$_NOT_", GateType::Not, {"A"}, "Y", false},
+    {"$_AND_", GateType::And, {"A", "B"}, "Y", false},
+    {"$_NAND_", GateType::Nand, {"A", "B"}, "Y", false},
+    {"$_OR_", GateType::Or, {"A", "B"}, "Y", false},
+    {"$_NOR_", GateType::Nor, {"A", "B"}, "Y", false},
+    {"$_XOR_", GateType::Xor, {"A", "B"}, "Y", false},
+    {"$_XNOR_", GateType::Xnor, {"A", "B"}, "Y", false},
+    {"$_ANDNOT_", GateType::And, {"A", "B"}, "Y", true},
+    {"$_ORNOT_", GateType::Or, {"A", "B"}, "Y", true},
+    /* Y = S ? B : A */
+    {"$_MUX_", GateType::Or, {"A", "B", "S"}, "Y", false},
+    {"$_TBUF_", GateType::Tristate, {"A", "E"}, "Y", false},
+    /* The clock is ignored, all flip-flops belong to the global clock. */
+    {"$_DFF_P_", GateType::FlipFlop, {"D", "C"}, "Q", false},
+    {"$_DFF_N_", GateType::FlipFlop, {"D", "C"}, "Q", false},
+};
+
+/**
+ * Bits of a declared signal in a scope, least significant first.
+ */
+struct Signal {
+    uint32_t bit_start;
+    uint32_t width;
+    int32_t msb;
+    int32_t lsb;
+    SignalKind kind;
+};
+
+/**
+ * Signals of one module instance.
+ */
+struct Scope {
+    /* Prepended to the names of all nets that belong to the instance. */
+    std::string prefix;
+    StringMap<Signal> signals;
+    Vector<NetId> bits;
+};
+
+static int32_t signal_bit_index(const Signal &signal, uint32_t position)
+{
+    return signal.msb >= signal.lsb ? signal.lsb + (int32_t)position :
+                                      signal.lsb - (int32_t)position;
+}
+
+static bool signal_bit_position(const Signal &signal,
+                                int32_t index,
+                                uint32_t &r_position)
+{
+    int64_t position = signal.msb >= signal.lsb ?
+                           (int64_t)index - signal.lsb :
+                           (int64_t)signal.lsb - index;
+    if (position < 0 || position >= signal.width) {
+        return false;
+    }
+    r_position = (uint32_t)position;
+    return true;
+}
+
+/**
+ * Index of the bracket that closes the one at the start or the size when it
+ * is not closed.
+ */
+static size_t find_closing_bracket(ArrayRef<Token> tokens, size_t start)
+{
+    int depth = 0;
+    for (size_t i = start; i < tokens.size(); i++) {
+        if (is_opening_bracket(tokens[i])) {
+            depth++;
+        }
+        else if (is_closing_bracket(tokens[i]) && --depth == 0) {
+            return i;
+        }
+    }
+    return tokens.size();
+}
+
+static void find_separators(ArrayRef<Token> tokens,
+                            const char *symbol,
+                            Vector<size_t> &r_indices)
+{
+    r_indices.clear();
+    int depth = 0;
+    for (size_t i : tokens.index_range()) {
+        if (is_opening_bracket(tokens[i])) {
+            depth++;
+        }
+        else if (is_closing_bracket(tokens[i])) {
+            depth--;
+        }
+        else if (depth == 0 && tokens[i].is(symbol)) {
+            r_indices.append(i);
+        }
+    }
+}
+
+/* Binary operators from the lowest to the highest precedence. */
+static const Vector<const char *> BINARY_OPERATOR_LEVELS[] = {
+    {"||"}, {"&&"}, {"|"}, {"^", "~^", "^~"}, {"&"}};
+
+static bool is_operand_end(const Token &token)
+{
+    return token.type == TokenType::Identifier ||
+           token.type == TokenType::Number || is_closing_bracket(token);
+}
+
+/**
+ * Find the binary operators of one precedence level that are not nested in
+ * brackets. Operators that do not follow an operand are unary.
+ */
+static void find_binary_operators(ArrayRef<Token> tokens,
+                                  ArrayRef<const char *> symbols,
+                                  Vector<size_t> &r_indices)
+{
+    r_indices.clear();
+    int depth = 0;
+    for (size_t i : tokens.index_range()) {
+        const Token &token = tokens[i];
+        if (is_opening_bracket(token)) {
+            depth++;
+        }
+        else if (is_closing_bracket(token)) {
+            depth--;
+        }
+        else if (depth == 0 && i > 0 && is_operand_end(tokens[i - 1])) {
+            for (const char *symbol : symbols) {
+                if (token.is(symbol)) {
+                    r_indices.append(i);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Find the question mark and the colon of the outermost conditional
+ * operator. Returns false when there is none.
+ */
+static bool find_conditional(ArrayRef<Token> tokens,
+                             size_t &r_question,
+                             size_t &r_colon)
+{
+    r_colon = tokens.size();
+    bool has_question = false;
+    uint32_t nesting = 0;
+    int depth = 0;
+    for (size_t i : tokens.index_range()) {
+        const Token &token = tokens[i];
+        if (is_opening_bracket(token)) {
+            depth++;
+        }
+        else if (is_closing_bracket(token)) {
+            depth--;
+        }
+        else if (depth > 0) {
+            continue;
+        }
+        else if (token.is("?")) {
+            if (has_question) {
+                nesting++;
+            }
+            else {
+                has_question = true;
+                r_question = i;
+            }
+        }
+        else if (token.is(":") && has_question) {
+            if (nesting == 0) {
+                r_colon = i;
+                return true;
+            }
+            nesting--;
+        }
+    }
+    return has_question;
+}
+
+static bool get_unary_gate_type(const Token &token, GateType &r_type)
+{
+    if (token.is("~")) {
+        r_type = GateType::Not;
+    }
+    else if (token.is("!") || token.is("~|")) {
+        r_type = GateType::Nor;
+    }
+    else if (token.is("&")) {
+        r_type = GateType::And;
+    }
+    else if (token.is("|")) {
+        r_type = GateType::Or;
+    }
+    else if (token.is("^")) {
+        r_type = GateType::Xor;
+    }
+    else if (token.is("~&")) {
+        r_type = GateType::Nand;
+    }
+    else if (token.is("~^") || token.is("^~")) {
+        r_type = GateType::Xnor;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Builds the circuit by flattening the hierarchy below the top module.
+ */
+class VerilogElaborator {
+  private:
+    ArrayRef<VerilogModule> m_modules;
+    StringMap<uint32_t> m_module_by_name;
+    /* Index of every port in the port list of its module. */
+    Vector<StringMap<uint32_t>> m_port_indices;
+    Circuit m_circuit;
+    /* Shared by all constant bits, created when they are used. */
+    NetId m_constant_nets[2] = {NO_NET, NO_NET};
+    /* Tokens of the expression that is evaluated. */
+    Vector<Token> m_tokens;
+    uint32_t m_line = 0;
+    std::string m_error;
+
+  public:
+    VerilogElaborator(ArrayRef<VerilogModule> modules)
+        : m_modules(modules), m_port_indices(modules.size())
+    {
+    }
+
+    bool elaborate()
+    {
+        for (uint32_t i : m_modules.index_range()) {
+            const VerilogModule &module = m_modules[i];
+            m_line = module.line;
+            if (m_module_by_name.contains(module.name)) {
+                return this->error("module " + quoted(module.name) +
+                                   " is defined twice");
+            }
+            m_module_by_name.add_new(module.name, i);
+            for (uint32_t port : module.ports.index_range()) {
+                if (m_port_indices[i].contains(module.ports[port])) {
+                    return this->error("port " + quoted(module.ports[port]) +
+                                       " is listed twice");
+                }
+                m_port_indices[i].add_new(module.ports[port], port);
+            }
+        }
+        if (m_modules.size() == 0) {
+            return this->error("no module is defined");
+        }
+
+        Vector<bool> is_instantiated(m_modules.size(), false);
+        for (const VerilogModule &module : m_modules) {
+            for (const ModuleInstance &instance : module.instances) {
+                const uint32_t *index = m_module_by_name.lookup_ptr(
+                    instance.type);
+                if (index != nullptr) {
+                    is_instantiated[*index] = true;
+                }
+            }
+        }
+        for (size_t i = m_modules.size(); i-- > 0;) {
+            if (!is_instantiated[i]) {
+                return this->elaborate_module(m_modules[i], "", nullptr, 0);
+            }
+        }
+        return this->error("modules are instantiated recursively");
+    }
+
+    Circuit &circuit()
+    {
+        return m_circuit;
+    }
+
+    const std::string &error() const
+    {
+        return m_error;
+    }
+
+  private:
+    bool error(const std::string &message)
+    {
+        m_error = "line " + std::to_string(m_line) + ": " + message;
+        return false;
+    }
+
+    NetId constant_net(bool value)
+    {
+        NetId &net = m_constant_nets[value];
+        if (net == NO_NET) {
+            net = this->add_gate(value ? GateType::Constant1 :
+                                         GateType::Constant0,
+                                 {});
+        }
+        return net;
+    }
+
+    NetId add_gate(GateType type, ArrayRef<NetId> inputs)
+    {
+        NetId net = m_circuit.add_net();
+        m_circuit.add_gate(type, inputs, net);
+        return net;
+    }
+
+    /**
+     * Add a gate that drives an existing net, which must not have a driver
+     * yet.
+     */
+    bool drive(NetId net, GateType type, ArrayRef<NetId> inputs)
+    {
+        if (m_circuit.net_driver(net) != NO_GATE) {
+            const std::string &name = m_circuit.net_name(net);
+            return this->error(name.empty() ?
+                                   "a net has more than one driver" :
+                                   "net " + quoted(name) +
+                                       " has more than one driver");
+        }
+        m_circuit.add_gate(type, inputs, net);
+        return true;
+    }
+
+    /**
+     * Elaborate one instance of a module. Its ports use the nets that are
+     * connected to them in the parent instance. The top module has no
+     * parent, its inputs and outputs become those of the circuit.
+     */
+    bool elaborate_module(const VerilogModule &module,
+                          std::string prefix,
+                          const StringMap<Vector<NetId>> *port_bits,
+                          uint32_t depth)
+    {
+        if (depth > MAX_HIERARCHY_DEPTH) {
+            return this->error("modules are instantiated recursively");
+        }
+        Scope scope;
+        scope.prefix = std::move(prefix);
+        /* Ports first, because their nets may be declared again as wires. */
+        for (bool is_port_pass : {true, false}) {
+            for (const SignalDeclaration &declaration : module.signals) {
+                if (is_port_kind(declaration.kind) == is_port_pass &&
+                    !this->declare_signal(scope, declaration, port_bits)) {
+                    return false;
+                }
+            }
+        }
+        for (StringRef port : module.ports) {
+            const Signal *signal = scope.signals.lookup_ptr(port);
+            if (signal == nullptr || !is_port_kind(signal->kind)) {
+                m_line = module.line;
+                return this->error("port " + quoted(port) +
+                                   " has no direction");
+            }
+        }
+        if (port_bits == nullptr && !this->add_top_ports(module, scope)) {
+            return false;
+        }
+
+        Vector<NetId> lhs_bits;
+        Vector<NetId> rhs_bits;
+        for (const Assignment &assignment : module.assignments) {
+            if (!this->evaluate(scope, assignment.lhs, {}, lhs_bits) ||
+                !this->evaluate(scope, assignment.rhs, lhs_bits, rhs_bits)) {
+                return false;
+            }
+        }
+        for (const ModuleInstance &instance : module.instances) {
+            m_line = instance.line;
+            ArrayRef<PortConnection> connections =
+                module.connections.as_ref().slice(instance.connection_start,
+                                                  instance.connection_amount);
+            const uint32_t *module_index = m_module_by_name.lookup_ptr(
+                instance.type);
+            bool success;
+            if (module_index != nullptr) {
+                success = this->add_module_instance(
+                    scope, instance, connections, *module_index, depth);
+            }
+            else {
+                success = this->add_primitive_or_cell(
+                    scope, instance, connections);
+            }
+            if (!success) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool declare_signal(Scope &scope,
+                        const SignalDeclaration &declaration,
+                        const StringMap<Vector<NetId>> *port_bits)
+    {
+        m_line = declaration.line;
+        int64_t range = (int64_t)declaration.msb - declaration.lsb;
+        if (std::abs(range) >= MAX_SIGNAL_WIDTH) {
+            return this->error("range of " + quoted(declaration.name) +
+                               " is too large");
+        }
+        uint32_t width = (uint32_t)std::abs(range) + 1;
+        const Signal *existing = scope.signals.lookup_ptr(declaration.name);
+        if (existing != nullptr) {
+            if (existing->width != width) {
+                return this->error(quoted(declaration.name) +
+                                   " is declared with different widths");
+            }
+            return true;
+        }
+
+        Signal signal = {(uint32_t)scope.bits.size(),
+                         width,
+                         declaration.msb,
+                         declaration.lsb,
+                         declaration.kind};
+        const Vector<NetId> *bound_bits =
+            port_bits == nullptr ? nullptr :
+                                   port_bits->lookup_ptr(declaration.name);
+        for (uint32_t position = 0; position < width; position++) {
+            if (declaration.kind == SignalKind::Supply0 ||
+                declaration.kind == SignalKind::Supply1) {
+                scope.bits.append(this->constant_net(declaration.kind ==
+                                                     SignalKind::Supply1));
+            }
+            else if (bound_bits != nullptr && position < bound_bits->size()) {
+                scope.bits.append((*bound_bits)[position]);
+            }
+            else if (bound_bits != nullptr &&
+                     declaration.kind == SignalKind::Input) {
+                /* Inputs are extended with zeros, like in assignments. */
+                scope.bits.append(this->constant_net(false));
+            }
+            else {
+                std::string name = scope.prefix;
+                name.append(declaration.name.data(), declaration.name.size());
+                if (declaration.is_vector) {
+                    int32_t index = signal_bit_index(signal, position);
+                    name += "[" + std::to_string(index) + "]";
+                }
+                scope.bits.append(m_circuit.add_net(std::move(name)));
+            }
+        }
+        scope.signals.add_new(declaration.name, signal);
+        return true;
+    }
+
+    /**
+     * Identifiers that are not declared are one bit wires.
+     */
+    const Signal &declare_implicit_net(Scope &scope, StringRef name)
+    {
+        Signal signal = {
+            (uint32_t)scope.bits.size(), 1, 0, 0, SignalKind::Wire};
+        std::string net_name = scope.prefix;
+        net_name.append(name.data(), name.size());
+        scope.bits.append(m_circuit.add_net(std::move(net_name)));
+        scope.signals.add_new(name, signal);
+        return *scope.signals.lookup_ptr(name);
+    }
+
+    /**
+     * Inputs and outputs of the circuit are ordered like the ports, the bits
+     * of vectors in the order of their declared range.
+     */
+    bool add_top_ports(const VerilogModule &module, Scope &scope)
+    {
+        for (StringRef port : module.ports) {
+            const Signal &signal = *scope.signals.lookup_ptr(port);
+            for (uint32_t position = signal.width; position-- > 0;) {
+                NetId net = scope.bits[signal.bit_start + position];
+                if (signal.kind == SignalKind::Input) {
+                    if (!this->drive(net, GateType::Input, {})) {
+                        return false;
+                    }
+                }
+                else {
+                    m_circuit.add_output(net);
+                }
+            }
+        }
+        return true;
+    }
+
+    bool add_module_instance(Scope &scope,
+                             const ModuleInstance &instance,
+                             ArrayRef<PortConnection> connections,
+                             uint32_t module_index,
+                             uint32_t depth)
+    {
+        const VerilogModule &module = m_modules[module_index];
+        if (instance.name.size() == 0) {
+            return this->error("instance of " + quoted(instance.type) +
+                               " has no name");
+        }
+        StringMap<Vector<NetId>> port_bits;
+        for (size_t i : connections.index_range()) {
+            StringRef port = connections[i].port;
+            if (port.size() == 0) {
+                if (i >= module.ports.size()) {
+                    return this->error("too many ports connected to " +
+                                       quoted(instance.name));
+                }
+                port = module.ports[i];
+            }
+            else if (!m_port_indices[module_index].contains(port)) {
+                return this->error("module " + quoted(module.name) +
+                                   " has no port " + quoted(port));
+            }
+            if (port_bits.contains(port)) {
+                return this->error("port " + quoted(port) + " of " +
+                                   quoted(instance.name) +
+                                   " is connected twice");
+            }
+            if (connections[i].expression.text.size() == 0) {
+                continue;
+            }
+            Vector<NetId> bits;
+            if (!this->evaluate(scope, connections[i].expression, {}, bits)) {
+                return false;
+            }
+            port_bits.add_new(port, std::move(bits));
+        }
+        std::string prefix = scope.prefix;
+        prefix.append(instance.name.data(), instance.name.size());
+        prefix += ".";
+        return this->elaborate_module(
+            module, std::move(prefix), &port_bits, depth + 1);
+    }
+
+    bool add_primitive_or_cell(Scope &scope,
+                               const ModuleInstance &instance,
+                               ArrayRef<PortConnection> connections)
+    {
+        for (const PrimitiveType &primitive : PRIMITIVE_TYPES) {
+            if (instance.type == primitive.name) {
+                return this->add_primitive(scope, primitive, connections);
+            }
+        }
+        for (const CellType &cell : CELL_TYPES) {
+            if (instance.type == cell.name) {
+                return this->add_cell(scope, instance, cell, connections);
+            }
+        }
+        return this->error("unknown module " + quoted(instance.type));
+    }
+
+    /**
+     * Terminals of primitives and cells use the least significant bit, like
+     * constants that are assigned to a single bit.
+     */
+    bool evaluate_single_bit(Scope &scope,
+                             const VerilogExpression &expression,
+                             NetId &r_net)
+    {
+        Vector<NetId> bits;
+        if (!this->evaluate(scope, expression, {}, bits)) {
+            return false;
+        }
+        r_net = bits[0];
+        return true;
+    }
+
+    bool add_primitive(Scope &scope,
+                       const PrimitiveType &primitive,
+                       ArrayRef<PortConnection> connections)
+    {
+        Vector<NetId> terminals;
+        for (const PortConnection &connection : connections) {
+            if (connection.port.size() > 0 ||
+                connection.expression.text.size() == 0) {
+                return this->error("terminals of " + quoted(primitive.name) +
+                                   " have to be connected by position");
+            }
+            NetId net;
+            if (!this->evaluate_single_bit(
+                    scope, connection.expression, net)) {
+                return false;
+            }
+            terminals.append(net);
+        }
+        bool is_tristate = primitive.type == GateType::Tristate;
+        if (terminals.size() < 2 || (is_tristate && terminals.size() != 3)) {
+            return this->error("wrong number of terminals for " +
+                               quoted(primitive.name));
+        }
+        switch (primitive.type) {
+            case GateType::Buffer:
+            case GateType::Not:
+                for (NetId output : terminals.as_ref().drop_back(1)) {
+                    if (!this->drive(
+                            output, primitive.type, {terminals.last()})) {
+                        return false;
+                    }
+                }
+                return true;
+            case GateType::Tristate: {
+                NetId data = terminals[1];
+                NetId enable = terminals[2];
+                if (primitive.invert_data) {
+                    data = this->add_gate(GateType::Not, {data});
+                }
+                if (primitive.invert_enable) {
+                    enable = this->add_gate(GateType::Not, {enable});
+                }
+                return this->drive(
+                    terminals[0], GateType::Tristate, {data, enable});
+            }
+            default:
+                return this->drive(terminals[0],
+                                   primitive.type,
+                                   terminals.as_ref().drop_front(1));
+        }
+    }
+
+    bool add_cell(Scope &scope,
+                  const ModuleInstance &instance,
+                  const CellType &cell,
+                  ArrayRef<PortConnection> connections)
+    {
+        NetId inputs[3] = {NO_NET, NO_NET, NO_NET};
+        uint32_t input_amount = 0;
+        while (input_amount < 3 && cell.inputs[input_amount] != nullptr) {
+            input_amount++;
+        }
+        NetId output = NO_NET;
+        for (const PortConnection &connection : connections) {
+            NetId *net = nullptr;
+            if (connection.port == cell.output) {
+                net = &output;
+            }
+            for (uint32_t i = 0; i < input_amount; i++) {
+                if (connection.port == cell.inputs[i]) {
+                    net = &inputs[i];
+                }
+            }
+            if (net == nullptr) {
+                return this->error(
+                    connection.port.size() == 0 ?
+                        "ports of " + quoted(cell.name) +
+                            " have to be connected by name" :
+                        quoted(cell.name) + " has no port " +
+                            quoted(connection.port));
+            }
+            if (connection.expression.text.size() > 0 &&
+                !this->evaluate_single_bit(
+                    scope, connection.expression, *net)) {
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < input_amount; i++) {
+            if (inputs[i] == NO_NET) {
+                return this->error("port " + quoted(cell.inputs[i]) + " of " +
+                                   quoted(instance.name) +
+                                   " is not connected");
+            }
+        }
+        if (output == NO_NET) {
+            return true;
+        }
+        if (StringRef(cell.name) == "$_MUX_") {
+            NetId not_select = this->add_gate(GateType::Not, {inputs[2]});
+            NetId when_false = this->add_gate(GateType::And,
+                                              {not_select, inputs[0]});
+            NetId when_true = this->add_gate(GateType::And,
+                                             {inputs[2], inputs[1]});
+            return this->drive(output, GateType::Or, {when_false, when_true});
+        }
+        if (cell.invert_second) {
+            inputs[1] = this->add_gate(GateType::Not, {inputs[1]});
+        }
+        if (cell.type == GateType::FlipFlop) {
+            input_amount = 1;
+        }
+        return this->drive(
+            output, cell.type, ArrayRef<NetId>(inputs, input_amount));
+    }
+
+    /**
+     * Evaluate an expression to its bits, least significant first. When
+     * target nets are given, the expression drives them and they become the
+     * result. Its outermost operator drives them directly, so that
+     * assignments do not need extra buffers. Operands of bitwise operators
+     * are extended to the width of the targets, like in Verilog.
+     */
+    bool evaluate(Scope &scope,
+                  const VerilogExpression &expression,
+                  ArrayRef<NetId> targets,
+                  Vector<NetId> &r_bits)
+    {
+        m_line = expression.line;
+        m_tokens.clear();
+        VerilogLexer lexer(expression.text, expression.line);
+        for (Token token = lexer.next(); token.type != TokenType::End;
+             token = lexer.next()) {
+            m_tokens.append(token);
+        }
+        bool drives_targets = false;
+        if (!this->evaluate_tokens(scope,
+                                   m_tokens,
+                                   targets.size(),
+                                   targets,
+                                   drives_targets,
+                                   r_bits)) {
+            return false;
+        }
+        if (targets.size() == 0 || drives_targets) {
+            return true;
+        }
+        for (size_t i : targets.index_range()) {
+            if (!this->drive(targets[i],
+                             GateType::Buffer,
+                             {this->bit_or_zero(r_bits, i)})) {
+                return false;
+            }
+        }
+        r_bits.clear();
+        r_bits.extend(targets);
+        return true;
+    }
+
+    /**
+     * The width applies to bitwise operators that are not nested in other
+     * operators. When it is zero, it is determined by the expression itself.
+     */
+    bool evaluate_tokens(Scope &scope,
+                         ArrayRef<Token> tokens,
+                         size_t width,
+                         ArrayRef<NetId> targets,
+                         bool &r_drives_targets,
+                         Vector<NetId> &r_bits)
+    {
+        r_bits.clear();
+        r_drives_targets = false;
+        if (tokens.size() == 0) {
+            return this->error("missing operand");
+        }
+        if (width == 0) {
+            width = this->self_width(scope, tokens);
+        }
+        size_t question;
+        size_t colon;
+        if (find_conditional(tokens, question, colon)) {
+            if (colon == tokens.size()) {
+                return this->error("missing ':' of conditional operator");
+            }
+            return this->evaluate_conditional(
+                scope, tokens, question, colon, width, targets, r_bits) &&
+                   this->finish_targets(targets, r_drives_targets, r_bits);
+        }
+
+        Vector<size_t> operators;
+        for (const Vector<const char *> &level : BINARY_OPERATOR_LEVELS) {
+            find_binary_operators(tokens, level, operators);
+            if (!operators.is_empty()) {
+                return this->evaluate_binary(
+                    scope, tokens, operators, width, targets, r_bits) &&
+                       this->finish_targets(targets, r_drives_targets, r_bits);
+            }
+        }
+
+        GateType unary_type;
+        if (get_unary_gate_type(tokens[0], unary_type)) {
+            return this->evaluate_unary(
+                scope, tokens, unary_type, width, targets, r_bits) &&
+                   this->finish_targets(targets, r_drives_targets, r_bits);
+        }
+        return this->evaluate_primary(
+            scope, tokens, width, targets, r_drives_targets, r_bits);
+    }
+
+    /**
+     * Width of an expression without the extension by its context. Invalid
+     * expressions have any width, because their evaluation fails anyway.
+     */
+    size_t self_width(Scope &scope, ArrayRef<Token> tokens)
+    {
+        if (tokens.size() == 0) {
+            return 1;
+        }
+        size_t question;
+        size_t colon;
+        if (find_conditional(tokens, question, colon)) {
+            if (colon == tokens.size()) {
+                return 1;
+            }
+            return std::max(
+                this->self_width(
+                    scope, tokens.slice(question + 1, colon - question - 1)),
+                this->self_width(scope, tokens.drop_front(colon + 1)));
+        }
+
+        Vector<size_t> operators;
+        for (const Vector<const char *> &level : BINARY_OPERATOR_LEVELS) {
+            find_binary_operators(tokens, level, operators);
+            if (operators.is_empty()) {
+                continue;
+            }
+            const Token &first_operator = tokens[operators[0]];
+            if (first_operator.is("||") || first_operator.is("&&")) {
+                return 1;
+            }
+            size_t width = 0;
+            size_t start = 0;
+            operators.append(tokens.size());
+            for (size_t end : operators) {
+                width = std::max(
+                    width,
+                    this->self_width(scope, tokens.slice(start, end - start)));
+                start = end + 1;
+            }
+            return width;
+        }
+
+        GateType unary_type;
+        if (get_unary_gate_type(tokens[0], unary_type)) {
+            return unary_type == GateType::Not ?
+                       this->self_width(scope, tokens.drop_front(1)) :
+                       1;
+        }
+        const Token &first = tokens[0];
+        size_t last = tokens.size() - 1;
+        if (first.is("(") && find_closing_bracket(tokens, 0) == last) {
+            return this->self_width(scope, tokens.slice(1, last - 1));
+        }
+        if (first.is("{") && find_closing_bracket(tokens, 0) == last) {
+            return this->concatenation_width(scope, tokens.slice(1, last - 1));
+        }
+        if (first.type == TokenType::Number) {
+            Vector<bool> values;
+            return parse_number_bits(first.text, values) ? values.size() : 1;
+        }
+        if (first.type == TokenType::Identifier && tokens.size() == 1) {
+            const Signal *signal = scope.signals.lookup_ptr(first.name());
+            return signal == nullptr ? 1 : signal->width;
+        }
+        int32_t first_index;
+        int32_t last_index;
+        if (tokens.size() == 6 && token_to_integer(tokens[2], first_index) &&
+            token_to_integer(tokens[4], last_index)) {
+            return (size_t)std::abs((int64_t)first_index - last_index) + 1;
+        }
+        return 1;
+    }
+
+    size_t concatenation_width(Scope &scope, ArrayRef<Token> tokens)
+    {
+        int32_t count;
+        if (tokens.size() >= 2 && token_to_integer(tokens[0], count) &&
+            tokens[1].is("{") &&
+            find_closing_bracket(tokens, 1) == tokens.size() - 1) {
+            return (size_t)count * this->concatenation_width(
+                                       scope,
+                                       tokens.slice(2, tokens.size() - 3));
+        }
+        Vector<size_t> separators;
+        find_separators(tokens, ",", separators);
+        separators.append(tokens.size());
+        size_t width = 0;
+        size_t start = 0;
+        for (size_t end : separators) {
+            width += this->self_width(scope, tokens.slice(start, end - start));
+            start = end + 1;
+        }
+        return width;
+    }
+
+    /**
+     * Add a gate for the next bit of the result of an operator. It drives
+     * the target of the bit if there is one.
+     */
+    bool add_result_gate(GateType type,
+                         ArrayRef<NetId> inputs,
+                         ArrayRef<NetId> targets,
+                         Vector<NetId> &r_bits)
+    {
+        size_t bit = r_bits.size();
+        if (bit < targets.size()) {
+            r_bits.append(targets[bit]);
+            return this->drive(targets[bit], type, inputs);
+        }
+        r_bits.append(this->add_gate(type, inputs));
+        return true;
+    }
+
+    /**
+     * Targets that are wider than the result of an operator are zero.
+     */
+    bool finish_targets(ArrayRef<NetId> targets,
+                        bool &r_drives_targets,
+                        Vector<NetId> &r_bits)
+    {
+        if (targets.size() == 0) {
+            return true;
+        }
+        while (r_bits.size() < targets.size()) {
+            if (!this->add_result_gate(GateType::Buffer,
+                                       {this->constant_net(false)},
+                                       targets,
+                                       r_bits)) {
+                return false;
+            }
+        }
+        r_drives_targets = true;
+        return true;
+    }
+
+    /**
+     * Combine all bits with an or gate.
+     */
+    NetId reduce_or(ArrayRef<NetId> bits)
+    {
+        return bits.size() == 1 ? bits[0] : this->add_gate(GateType::Or, bits);
+    }
+
+    NetId bit_or_zero(ArrayRef<NetId> bits, size_t index)
+    {
+        return index < bits.size() ? bits[index] : this->constant_net(false);
+    }
+
+    bool evaluate_conditional(Scope &scope,
+                              ArrayRef<Token> tokens,
+                              size_t question,
+                              size_t colon,
+                              size_t width,
+                              ArrayRef<NetId> targets,
+                              Vector<NetId> &r_bits)
+    {
+        Vector<NetId> condition;
+        Vector<NetId> when_true;
+        Vector<NetId> when_false;
+        bool unused;
+        if (!this->evaluate_tokens(scope,
+                                   tokens.take_front(question),
+                                   0,
+                                   {},
+                                   unused,
+                                   condition) ||
+            !this->evaluate_tokens(scope,
+                                   tokens.slice(question + 1,
+                                                colon - question - 1),
+                                   width,
+                                   {},
+                                   unused,
+                                   when_true) ||
+            !this->evaluate_tokens(scope,
+                                   tokens.drop_front(colon + 1),
+                                   width,
+                                   {},
+                                   unused,
+                                   when_false)) {
+            return false;
+        }
+        NetId select = this->reduce_or(condition);
+        NetId not_select = this->add_gate(GateType::Not, {select});
+        for (size_t bit = 0; bit < width; bit++) {
+            NetId true_bit = this->add_gate(
+                GateType::And, {select, this->bit_or_zero(when_true, bit)});
+            NetId false_bit = this->add_gate(
+                GateType::And,
+                {not_select, this->bit_or_zero(when_false, bit)});
+            if (!this->add_result_gate(
+                    GateType::Or, {true_bit, false_bit}, targets, r_bits)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Operators of one precedence level become one gate per bit with all
+     * operands as inputs. Chains of xor and xnor are an xnor when the
+     * amount of xnor operators is odd.
+     */
+    bool evaluate_binary(Scope &scope,
+                         ArrayRef<Token> tokens,
+                         ArrayRef<size_t> operators,
+                         size_t width,
+                         ArrayRef<NetId> targets,
+                         Vector<NetId> &r_bits)
+    {
+        const Token &first_operator = tokens[operators[0]];
+        bool is_logical = first_operator.is("||") || first_operator.is("&&");
+        Vector<Vector<NetId>> operands(operators.size() + 1);
+        size_t start = 0;
+        for (size_t i : operands.index_range()) {
+            size_t end = i < operators.size() ? operators[i] : tokens.size();
+            bool unused;
+            if (!this->evaluate_tokens(scope,
+                                       tokens.slice(start, end - start),
+                                       is_logical ? 0 : width,
+                                       {},
+                                       unused,
+                                       operands[i])) {
+                return false;
+            }
+            start = end + 1;
+        }
+
+        GateType type;
+        if (first_operator.is("||") || first_operator.is("|")) {
+            type = GateType::Or;
+        }
+        else if (first_operator.is("&&") || first_operator.is("&")) {
+            type = GateType::And;
+        }
+        else {
+            size_t xnor_amount = 0;
+            for (size_t index : operators) {
+                xnor_amount += tokens[index].is("^") ? 0 : 1;
+            }
+            type = xnor_amount % 2 == 0 ? GateType::Xor : GateType::Xnor;
+        }
+
+        if (is_logical) {
+            width = 1;
+            for (Vector<NetId> &operand : operands) {
+                NetId bit = this->reduce_or(operand);
+                operand.clear();
+                operand.append(bit);
+            }
+        }
+        Vector<NetId> inputs;
+        for (size_t bit = 0; bit < width; bit++) {
+            inputs.clear();
+            for (const Vector<NetId> &operand : operands) {
+                inputs.append(this->bit_or_zero(operand, bit));
+            }
+            if (!this->add_result_gate(type, inputs, targets, r_bits)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Bitwise negation keeps the width, all other unary operators reduce
+     * the bits of their operand to one.
+     */
+    bool evaluate_unary(Scope &scope,
+                        ArrayRef<Token> tokens,
+                        GateType type,
+                        size_t width,
+                        ArrayRef<NetId> targets,
+                        Vector<NetId> &r_bits)
+    {
+        Vector<NetId> operand;
+        bool unused;
+        if (!this->evaluate_tokens(scope,
+                                   tokens.drop_front(1),
+                                   type == GateType::Not ? width : 0,
+                                   {},
+                                   unused,
+                                   operand)) {
+            return false;
+        }
+        if (type != GateType::Not) {
+            return this->add_result_gate(type, operand, targets, r_bits);
+        }
+        for (size_t bit = 0; bit < width; bit++) {
+            if (!this->add_result_gate(GateType::Not,
+                                       {this->bit_or_zero(operand, bit)},
+                                       targets,
+                                       r_bits)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool evaluate_primary(Scope &scope,
+                          ArrayRef<Token> tokens,
+                          size_t width,
+                          ArrayRef<NetId> targets,
+                          bool &r_drives_targets,
+                          Vector<NetId> &r_bits)
+    {
+        const Token &first = tokens[0];
+        size_t last = tokens.size() - 1;
+        if (first.is("(") && find_closing_bracket(tokens, 0) == last) {
+            return this->evaluate_tokens(scope,
+                                         tokens.slice(1, last - 1),
+                                         width,
+                                         targets,
+                                         r_drives_targets,
+                                         r_bits);
+        }
+        if (first.is("{") && find_closing_bracket(tokens, 0) == last) {
+            return this->evaluate_concatenation(
+                scope, tokens.slice(1, last - 1), r_bits);
+        }
+        if (first.type == TokenType::Number && tokens.size() == 1) {
+            Vector<bool> values;
+            if (!parse_number_bits(first.text, values)) {
+                return this->error("invalid number " + quoted(first.text));
+            }
+            for (bool value : values) {
+                r_bits.append(this->constant_net(value));
+            }
+            return true;
+        }
+        if (first.type == TokenType::Identifier) {
+            return this->evaluate_signal(scope, tokens, r_bits);
+        }
+        return this->error("unsupported expression at " +
+                           quoted(first.text));
+    }
+
+    /**
+     * The items are listed from the most significant one, replications like
+     * {4{a}} repeat their items.
+     */
+    bool evaluate_concatenation(Scope &scope,
+                                ArrayRef<Token> tokens,
+                                Vector<NetId> &r_bits)
+    {
+        int32_t count;
+        if (tokens.size() >= 2 && token_to_integer(tokens[0], count) &&
+            tokens[1].is("{") &&
+            find_closing_bracket(tokens, 1) == tokens.size() - 1) {
+            Vector<NetId> bits;
+            if (!this->evaluate_concatenation(
+                    scope, tokens.slice(2, tokens.size() - 3), bits)) {
+                return false;
+            }
+            if (count == 0 ||
+                (uint64_t)count * bits.size() > MAX_SIGNAL_WIDTH) {
+                return this->error("invalid replication");
+            }
+            for (int32_t i = 0; i < count; i++) {
+                r_bits.extend(bits);
+            }
+            return true;
+        }
+
+        Vector<size_t> separators;
+        find_separators(tokens, ",", separators);
+        separators.append(tokens.size());
+        Vector<NetId> bits;
+        for (size_t i = separators.size(); i-- > 0;) {
+            size_t start = i == 0 ? 0 : separators[i - 1] + 1;
+            bool unused;
+            size_t end = separators[i];
+            if (!this->evaluate_tokens(scope,
+                                       tokens.slice(start, end - start),
+                                       0,
+                                       {},
+                                       unused,
+                                       bits)) {
+                return false;
+            }
+            r_bits.extend(bits);
+        }
+        return true;
+    }
+
+    /**
+     * Signals with an optional constant bit or part select, like a, a[3] or
+     * a[7:4].
+     */
+    bool evaluate_signal(Scope &scope,
+                         ArrayRef<Token> tokens,
+                         Vector<NetId> &r_bits)
+    {
+        StringRef name = tokens[0].name();
+        const Signal *signal = scope.signals.lookup_ptr(name);
+        if (signal == nullptr) {
+            signal = &this->declare_implicit_net(scope, name);
+        }
+        ArrayRef<NetId> bits = scope.bits.as_ref().slice(signal->bit_start,
+                                                         signal->width);
+        if (tokens.size() == 1) {
+            r_bits.extend(bits);
+            return true;
+        }
+
+        int32_t first_index;
+        int32_t last_index;
+        if (tokens.size() == 4 && tokens[1].is("[") &&
+            token_to_integer(tokens[2], first_index) && tokens[3].is("]")) {
+            last_index = first_index;
+        }
+        else if (tokens.size() != 6 || !tokens[1].is("[") ||
+                 !token_to_integer(tokens[2], first_index) ||
+                 !tokens[3].is(":") ||
+                 !token_to_integer(tokens[4], last_index) ||
+                 !tokens[5].is("]")) {
+            return this->error("unsupported select of " + quoted(name));
+        }
+        uint32_t first_position;
+        uint32_t last_position;
+        if (!signal_bit_position(*signal, first_index, first_position) ||
+            !signal_bit_position(*signal, last_index, last_position)) {
+            return this->error("index out of range of " + quoted(name));
+        }
+        if (first_position < last_position) {
+            return this->error("part select of " + quoted(name) +
+                               " is reversed");
+        }
+        r_bits.extend(
+            bits.slice(last_position, first_position - last_position + 1));
+        return true;
+    }
+};
+
+std::optional<Circuit> parse_verilog(StringRef text, std::string &r_error)
+{
+    Vector<VerilogModule> modules;
+    VerilogParser parser(text, modules);
+    if (!parser.parse()) {
+        r_error = parser.error();
+        return std::nullopt;
+    }
+    VerilogElaborator elaborator(modules);
+    if (!elaborator.elaborate()) {
+        r_error = elaborator.error();
+        return std::nullopt;
+    }
+    return std::move(elaborator.circuit());
+}
+
+}  // namespace gate_sim
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include "bas/string_ref.h"
+
+#include "circuit.h"
+
+namespace gate_sim {
+
+using bas::StringRef;
+
+/**
+ * Parse a gate-level netlist in structural Verilog, as written by synthesis
+ * tools:
+ *
+ *   module half_adder (input a, input b, output sum, output carry);
+ *     xor g1 (sum, a, b);
+ *     assign carry = a & b;
+ *   endmodule
+ *
+ * Supported are input, output, inout and wire declarations with constant
+ * ranges, continuous assignments with bitwise, reduction, logical and
+ * conditional operators, the gate primitives (and, nand, or, nor, xor, xnor,
+ * buf, not, bufif0/1, notif0/1) and the simple cells of Yosys ($_AND_,
+ * $_MUX_, $_DFF_P_, ...). Flip-flops belong to the global clock, their clock
+ * input is ignored. Vector signals get one net per bit, named like "a[3]".
+ *
+ * Instances of modules that are defined in the text are flattened into the
+ * top module, which is the last module that is not instantiated by another
+ * one. Their internal nets are named by the instance path, like "u1.n5".
+ * Behavioral code, parameters and unknown cells are not supported.
+ *
+ * Identifiers are only referenced in the text while parsing, so the text
+ * can be a memory-mapped file.
+ *
+ * Returns nothing and sets the error message when the text is invalid.
+ */
+std::optional<Circuit> parse_verilog(StringRef text, std::string &r_error);
+
+}  // namespace gate_sim
@@ -0,0 +1,499 @@
+#include <algorithm>
+
+#include "waveform_store.h"
+
+namespace gate_sim {
+
+static constexpr size_t NO_BLOCK = SIZE_MAX;
+
+/*
+ * Tokens are variable length integers with 7 bits per byte. The lowest bit
+ * distinguishes the two kinds of tokens:
+ *
+ *   change: distance << 3 | value << 1 | 0
+ *   run:    amount << 1 | 1, followed by the distance
+ *
+ * Every change of a run has the given distance to the one before and
+ * switches back to the value before the previous change.
+ */
+
+static void write_varint(Vector<uint8_t> &bytes, uint64_t value)
+{
+    while (value >= 0x80) {
+        bytes.append((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    bytes.append((uint8_t)value);
+}
+
+static uint64_t read_varint(const uint8_t *&r_data)
+{
+    uint64_t value = 0;
+    uint32_t shift = 0;
+    while (*r_data & 0x80) {
+        value |= (uint64_t)(*r_data++ & 0x7f) << shift;
+        shift += 7;
+    }
+    value |= (uint64_t)*r_data++ << shift;
+    return value;
+}
+
+template<typename T> static void remove_after(Vector<T> &vector, size_t size)
+{
+    while (vector.size() > size) {
+        vector.remove_last();
+    }
+}
+
+void WaveformStore::SummaryLevel::truncate(size_t new_size)
+{
+    if (new_size >= size) {
+        return;
+    }
+    remove_after(bytes, (new_size + 1) / 2);
+    /* Clear the unused half of the last byte, because masks are only ever
+     * combined with it. */
+    if (new_size % 2 == 1) {
+        bytes.last() &= 0xf;
+    }
+    size = new_size;
+}
+
+WaveformStore::WaveformStore(ArrayRef<NetId> nets) : m_nets(nets)
+{
+    for (size_t i = 0; i < nets.size(); i++) {
+        m_signals.append(Signal());
+    }
+}
+
+uint64_t WaveformStore::start_cycle() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_start_cycle;
+}
+
+uint64_t WaveformStore::end_cycle() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_end_cycle;
+}
+
+void WaveformStore::record_cycle(uint64_t cycle, const Simulator &simulator)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (cycle < m_end_cycle) {
+        this->remove_cycles_from__no_lock(cycle);
+    }
+    if (m_start_cycle == m_end_cycle) {
+        m_start_cycle = cycle;
+        m_first_bucket = cycle / SUMMARY_BUCKET_SIZE;
+    }
+    for (size_t i : m_signals.index_range()) {
+        Signal &signal = m_signals[i];
+        Logic4 value = simulator.get_net_logic(m_nets[i]);
+        this->update_summary(signal, cycle, value);
+        if (!signal.blocks.is_empty() && value == signal.last_value) {
+            continue;
+        }
+        append_change(signal, cycle, value);
+    }
+    m_end_cycle = cycle + 1;
+}
+
+void WaveformStore::remove_cycles_from(uint64_t cycle)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    this->remove_cycles_from__no_lock(cycle);
+}
+
+void WaveformStore::remove_cycles_from__no_lock(uint64_t cycle)
+{
+    if (cycle <= m_start_cycle) {
+        for (Signal &signal : m_signals) {
+            signal = Signal();
+        }
+        m_start_cycle = 0;
+        m_end_cycle = 0;
+        return;
+    }
+    Vector<WaveformChange> kept_changes;
+    for (Signal &signal : m_signals) {
+        size_t block_index = find_block(signal, cycle - 1);
+        if (block_index == NO_BLOCK) {
+            signal = Signal();
+            continue;
+        }
+        /* Encode the remaining changes of the last block again, because
+         * runs cannot be shortened in place. */
+        kept_changes.clear();
+        decode_block(signal, block_index, cycle, kept_changes);
+        const Block &block = signal.blocks[block_index];
+        signal.last_value = block.previous_value;
+        remove_after(signal.bytes, block.byte_start);
+        remove_after(signal.blocks, block_index);
+        signal.block_change_amount = CHANGES_PER_BLOCK;
+        signal.run_length = 0;
+        for (WaveformChange change : kept_changes) {
+            append_change(signal, change.cycle, change.value);
+        }
+    }
+    m_end_cycle = std::min(m_end_cycle, cycle);
+    for (Signal &signal : m_signals) {
+        this->truncate_summary(signal, cycle);
+    }
+}
+
+Logic4 WaveformStore::value_at(uint32_t signal_index, uint64_t cycle) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const Signal &signal = m_signals[signal_index];
+    size_t block_index = find_block(signal, cycle);
+    if (block_index == NO_BLOCK) {
+        return Logic4::X;
+    }
+    Vector<WaveformChange> changes;
+    decode_block(signal, block_index, cycle + 1, changes);
+    return changes.last().value;
+}
+
+void WaveformStore::read_changes(uint32_t signal_index,
+                                 uint64_t start_cycle,
+                                 uint64_t end_cycle,
+                                 Vector<WaveformChange> &r_changes) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    read_changes__no_lock(
+        m_signals[signal_index], start_cycle, end_cycle, r_changes);
+}
+
+void WaveformStore::read_changes__no_lock(const Signal &signal,
+                                          uint64_t start_cycle,
+                                          uint64_t end_cycle,
+                                          Vector<WaveformChange> &r_changes)
+{
+    r_changes.clear();
+    r_changes.append({start_cycle, Logic4::X});
+
+    size_t first_block = find_block(signal, start_cycle);
+    if (first_block == NO_BLOCK) {
+        first_block = 0;
+    }
+    for (size_t block_index = first_block;
+         block_index < signal.blocks.size() &&
+         signal.blocks[block_index].first_cycle < end_cycle;
+         block_index++) {
+        decode_block(signal, block_index, end_cycle, r_changes);
+    }
+
+    /* Changes up to the start only determine the value at the start. */
+    size_t first_after_start = 1;
+    while (first_after_start < r_changes.size() &&
+           r_changes[first_after_start].cycle <= start_cycle) {
+        first_after_start++;
+    }
+    r_changes[0].value = r_changes[first_after_start - 1].value;
+    size_t new_size = r_changes.size() - (first_after_start - 1);
+    for (size_t i = 1; i < new_size; i++) {
+        r_changes[i] = r_changes[i + first_after_start - 1];
+    }
+    remove_after(r_changes, new_size);
+}
+
+void WaveformStore::summarize_ranges(uint32_t signal_index,
+                                     uint64_t start_cycle,
+                                     uint64_t cycles_per_range,
+                                     uint32_t range_amount,
+                                     Vector<uint8_t> &r_masks) const
+{
+    assert(cycles_per_range > 0);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const Signal &signal = m_signals[signal_index];
+    r_masks.clear();
+    uint64_t end_cycle = start_cycle + cycles_per_range * range_amount;
+    /* Every signal has a value in all recorded cycles, so the ranges are
+     * limited to them. */
+    uint64_t recorded_start = std::max(start_cycle, m_start_cycle);
+    uint64_t recorded_end = std::min(end_cycle, m_end_cycle);
+    if (recorded_start >= recorded_end) {
+        r_masks.append_n_times(0, range_amount);
+        return;
+    }
+
+    if (cycles_per_range < SUMMARY_BUCKET_SIZE) {
+        /* Short ranges only contain few changes. */
+        Vector<WaveformChange> changes;
+        read_changes__no_lock(signal, recorded_start, recorded_end, changes);
+        size_t change_index = 0;
+        for (uint32_t i = 0; i < range_amount; i++) {
+            uint64_t range_start = std::max(
+                start_cycle + i * cycles_per_range, recorded_start);
+            uint64_t range_end = std::min(
+                start_cycle + (i + 1) * cycles_per_range, recorded_end);
+            if (range_start >= range_end) {
+                r_masks.append(0);
+                continue;
+            }
+            while (change_index + 1 < changes.size() &&
+                   changes[change_index + 1].cycle <= range_start) {
+                change_index++;
+            }
+            uint8_t mask = value_mask(changes[change_index].value);
+            while (change_index + 1 < changes.size() &&
+                   changes[change_index + 1].cycle < range_end) {
+                change_index++;
+                mask |= value_mask(changes[change_index].value);
+            }
+            r_masks.append(mask);
+        }
+        return;
+    }
+
+    /* Use the coarsest level whose buckets are not longer than a range. */
+    uint32_t level_index = 0;
+    while (level_index + 1 < SUMMARY_LEVEL_AMOUNT &&
+           (uint64_t)SUMMARY_BUCKET_SIZE << (2 * (level_index + 1)) <=
+               cycles_per_range) {
+        level_index++;
+    }
+    const SummaryLevel &level = signal.summary[level_index];
+    auto bucket_index = [&](uint64_t cycle) {
+        return (cycle / SUMMARY_BUCKET_SIZE - m_first_bucket) >>
+               (2 * level_index);
+    };
+    for (uint32_t i = 0; i < range_amount; i++) {
+        uint64_t range_start = std::max(start_cycle + i * cycles_per_range,
+                                        recorded_start);
+        uint64_t range_end = std::min(
+            start_cycle + (i + 1) * cycles_per_range, recorded_end);
+        uint8_t mask = 0;
+        if (range_start < range_end) {
+            uint64_t last_bucket = std::min<uint64_t>(
+                bucket_index(range_end - 1), level.size - 1);
+            for (uint64_t bucket = bucket_index(range_start);
+                 bucket <= last_bucket;
+                 bucket++) {
+                mask |= level.get(bucket);
+            }
+        }
+        r_masks.append(mask);
+    }
+}
+
+size_t WaveformStore::memory_size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t size = m_signals.size() * sizeof(Signal);
+    for (const Signal &signal : m_signals) {
+        size += signal.bytes.size() + signal.blocks.size() * sizeof(Block);
+        for (const SummaryLevel &level : signal.summary) {
+            size += level.bytes.size();
+        }
+    }
+    return size;
+}
+
+/**
+ * Add the value of the signal in the cycle to the summary. Must be called
+ * before the change is appended.
+ */
+void WaveformStore::update_summary(Signal &signal,
+                                   uint64_t cycle,
+                                   Logic4 value) const
+{
+    size_t bucket = cycle / SUMMARY_BUCKET_SIZE - m_first_bucket;
+    SummaryLevel &level = signal.summary[0];
+    /* Cycles that have not been recorded keep the last value. Only a bucket
+     * that starts with the new cycle does not contain it. */
+    uint8_t last_mask = signal.blocks.is_empty() ?
+                            0 :
+                            value_mask(signal.last_value);
+    while (level.size <= bucket) {
+        bool starts_bucket = level.size == bucket &&
+                             cycle % SUMMARY_BUCKET_SIZE == 0;
+        add_summary_bits(signal, level.size, starts_bucket ? 0 : last_mask);
+    }
+    add_summary_bits(signal, bucket, value_mask(value));
+}
+
+/**
+ * Remove the values from the cycle on from the summary. The changes before
+ * the cycle must be up to date already.
+ */
+void WaveformStore::truncate_summary(Signal &signal, uint64_t cycle) const
+{
+    size_t bucket = cycle / SUMMARY_BUCKET_SIZE - m_first_bucket;
+    signal.summary[0].truncate(bucket);
+    /* The last bucket of every level can contain removed buckets of the
+     * level below, so it is combined again. */
+    for (uint32_t i = 1; i < SUMMARY_LEVEL_AMOUNT; i++) {
+        const SummaryLevel &children = signal.summary[i - 1];
+        SummaryLevel &level = signal.summary[i];
+        size_t size = (children.size + 3) / 4;
+        level.truncate(size == 0 ? 0 : size - 1);
+        if (size > 0 && level.size < size) {
+            uint8_t mask = 0;
+            for (size_t child = (size - 1) * 4; child < children.size;
+                 child++) {
+                mask |= children.get(child);
+            }
+            level.append(mask);
+        }
+    }
+
+    /* The cycles of the bucket before the given one are still valid. */
+    uint64_t bucket_start = std::max(
+        cycle / SUMMARY_BUCKET_SIZE * SUMMARY_BUCKET_SIZE, m_start_cycle);
+    if (bucket_start < cycle && !signal.blocks.is_empty()) {
+        Vector<WaveformChange> changes;
+        read_changes__no_lock(signal, bucket_start, cycle, changes);
+        uint8_t mask = 0;
+        for (WaveformChange change : changes) {
+            mask |= value_mask(change.value);
+        }
+        add_summary_bits(signal, bucket, mask);
+    }
+}
+
+/**
+ * Combine the mask with a bucket of the finest level and all buckets that
+ * contain it. Buckets that do not exist yet are appended.
+ */
+void WaveformStore::add_summary_bits(Signal &signal,
+                                     size_t bucket,
+                                     uint8_t mask)
+{
+    for (uint32_t i = 0; i < SUMMARY_LEVEL_AMOUNT; i++) {
+        SummaryLevel &level = signal.summary[i];
+        size_t index = bucket >> (2 * i);
+        if (index >= level.size) {
+            assert(index == level.size);
+            level.append(mask);
+            continue;
+        }
+        /* Buckets always contain the values of the buckets below. */
+        if ((level.get(index) & mask) == mask) {
+            break;
+        }
+        level.add_bits(index, mask);
+    }
+}
+
+void WaveformStore::append_change(Signal &signal,
+                                  uint64_t cycle,
+                                  Logic4 value)
+{
+    if (signal.block_change_amount >= CHANGES_PER_BLOCK) {
+        Block block;
+        block.first_cycle = cycle;
+        block.byte_start = (uint32_t)signal.bytes.size();
+        block.first_value = value;
+        block.previous_value = signal.blocks.is_empty() ? value :
+                                                          signal.last_value;
+        signal.blocks.append(block);
+        signal.block_change_amount = 1;
+        signal.last_cycle = cycle;
+        signal.last_value = value;
+        signal.previous_value = block.previous_value;
+        /* No change has a distance of zero, so the next one is never part
+         * of a run. */
+        signal.last_distance = 0;
+        signal.run_length = 0;
+        return;
+    }
+
+    assert(cycle > signal.last_cycle);
+    uint64_t distance = cycle - signal.last_cycle;
+    bool continues_run = distance == signal.last_distance &&
+                         value == signal.previous_value;
+    if (continues_run && signal.run_length > 0) {
+        /* Replace the run token with a longer one. */
+        signal.run_length++;
+        remove_after(signal.bytes, signal.run_token_start);
+        write_varint(signal.bytes, ((uint64_t)signal.run_length << 1) | 1);
+        write_varint(signal.bytes, distance);
+    }
+    else if (continues_run) {
+        signal.run_length = 1;
+        signal.run_token_start = (uint32_t)signal.bytes.size();
+        write_varint(signal.bytes, ((uint64_t)1 << 1) | 1);
+        write_varint(signal.bytes, distance);
+    }
+    else {
+        signal.run_length = 0;
+        write_varint(signal.bytes, (distance << 3) | ((uint64_t)value << 1));
+    }
+    signal.block_change_amount++;
+    signal.last_cycle = cycle;
+    signal.previous_value = signal.last_value;
+    signal.last_value = value;
+    signal.last_distance = distance;
+}
+
+/**
+ * Append the changes of the block before the end cycle.
+ */
+void WaveformStore::decode_block(const Signal &signal,
+                                 size_t block_index,
+                                 uint64_t end_cycle,
+                                 Vector<WaveformChange> &r_changes)
+{
+    const Block &block = signal.blocks[block_index];
+    uint64_t cycle = block.first_cycle;
+    Logic4 value = block.first_value;
+    Logic4 previous_value = block.previous_value;
+    if (cycle >= end_cycle) {
+        return;
+    }
+    r_changes.append({cycle, value});
+
+    const uint8_t *data = signal.bytes.begin() + block.byte_start;
+    const uint8_t *data_end = block_index + 1 < signal.blocks.size() ?
+                                  signal.bytes.begin() +
+                                      signal.blocks[block_index + 1]
+                                          .byte_start :
+                                  signal.bytes.end();
+    while (data < data_end) {
+        uint64_t token = read_varint(data);
+        if (token & 1) {
+            uint64_t amount = token >> 1;
+            uint64_t distance = read_varint(data);
+            for (uint64_t i = 0; i < amount; i++) {
+                cycle += distance;
+                if (cycle >= end_cycle) {
+                    return;
+                }
+                std::swap(value, previous_value);
+                r_changes.append({cycle, value});
+            }
+        }
+        else {
+            cycle += token >> 3;
+            if (cycle >= end_cycle) {
+                return;
+            }
+            previous_value = value;
+            value = (Logic4)((token >> 1) & 3);
+            r_changes.append({cycle, value});
+        }
+    }
+}
+
+/**
+ * Index of the last block that starts at or before the cycle.
+ */
+size_t WaveformStore::find_block(const Signal &signal, uint64_t cycle)
+{
+    const Block *block = std::upper_bound(
+        signal.blocks.begin(),
+        signal.blocks.end(),
+        cycle,
+        [](uint64_t cycle, const Block &block) {
+            return cycle < block.first_cycle;
+        });
+    if (block == signal.blocks.begin()) {
+        return NO_BLOCK;
+    }
+    return (size_t)(block - signal.blocks.begin()) - 1;
+}
+
+}  // namespace gate_sim
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <mutex>
+
+#include "simulator.h"
+
+namespace gate_sim {
+
+using bas::uint8_t;
+
+struct WaveformChange {
+    uint64_t cycle;
+    Logic4 value;
+};
+
+/**
+ * Compact history of the values of some nets in lane 0, for showing
+ * waveforms over many cycles.
+ *
+ * Every signal only stores the cycles in which its value changed. The
+ * changes are encoded in blocks of at most CHANGES_PER_BLOCK changes. A
+ * block starts with the absolute cycle and value of its first change in a
+ * separate index. All further changes store the distance to the previous
+ * change as variable length integer together with the new value, which
+ * usually takes a single byte. Runs of changes that have the same distance
+ * and alternate between two values, like clocks and counters, are merged
+ * into a single run token.
+ *
+ * The value of a signal in a range of cycles is found with a binary search
+ * over the block index and decoding at most one block in front of the
+ * range.
+ *
+ * For drawing long ranges, every signal also has a summary pyramid. The
+ * finest level stores which values the signal took in every bucket of
+ * SUMMARY_BUCKET_SIZE cycles, every further level combines four buckets of
+ * the level below. Values are stored as masks of 4 bits, so a bucket with
+ * more than one value contains a transition. A range of cycles of any
+ * length is summarized by combining a few buckets of the matching level,
+ * without looking at individual changes.
+ *
+ * All methods can be called from different threads.
+ */
+class WaveformStore : bas::NonCopyable, bas::NonMovable {
+  private:
+    static constexpr uint32_t CHANGES_PER_BLOCK = 256;
+    static constexpr uint32_t SUMMARY_BUCKET_SIZE = 128;
+    static constexpr uint32_t SUMMARY_LEVEL_AMOUNT = 12;
+
+    /* Value masks of 4 bits, two per byte. */
+    struct SummaryLevel {
+        Vector<uint8_t> bytes;
+        size_t size = 0;
+
+        uint8_t get(size_t index) const
+        {
+            return (bytes[index / 2] >> (index % 2 * 4)) & 0xf;
+        }
+
+        void add_bits(size_t index, uint8_t mask)
+        {
+            bytes[index / 2] |= (uint8_t)(mask << (index % 2 * 4));
+        }
+
+        void append(uint8_t mask)
+        {
+            if (size % 2 == 0) {
+                bytes.append(0);
+            }
+            this->add_bits(size, mask);
+            size++;
+        }
+
+        void truncate(size_t new_size);
+    };
+
+    struct Block {
+        uint64_t first_cycle;
+        uint32_t byte_start;
+        Logic4 first_value;
+        /* Value before the first change, for continuing runs. */
+        Logic4 previous_value;
+    };
+
+    struct Signal {
+        Vector<uint8_t> bytes;
+        Vector<Block> blocks;
+
+        /* State of the encoder after the last change. */
+        uint32_t block_change_amount = CHANGES_PER_BLOCK;
+        uint64_t last_cycle = 0;
+        Logic4 last_value = Logic4::X;
+        Logic4 previous_value = Logic4::X;
+        uint64_t last_distance = 0;
+        /* Number of changes in the run token at the end, if any. */
+        uint32_t run_length = 0;
+        uint32_t run_token_start = 0;
+
+        SummaryLevel summary[SUMMARY_LEVEL_AMOUNT];
+    };
+
+    Vector<NetId> m_nets;
+    Vector<Signal> m_signals;
+    uint64_t m_start_cycle = 0;
+    uint64_t m_end_cycle = 0;
+    /* Summary bucket that contains the start cycle. */
+    uint64_t m_first_bucket = 0;
+    mutable std::mutex m_mutex;
+
+  public:
+    WaveformStore(ArrayRef<NetId> nets);
+
+    ArrayRef<NetId> nets() const
+    {
+        return m_nets;
+    }
+
+    /**
+     * Range of cycles that have been recorded.
+     */
+    uint64_t start_cycle() const;
+    uint64_t end_cycle() const;
+
+    /**
+     * Record the values of all signals at the end of the given cycle. When
+     * cycles from this one on have been recorded already, e.g. after going
+     * back in the history, they are replaced.
+     */
+    void record_cycle(uint64_t cycle, const Simulator &simulator);
+
+    /**
+     * Forget all cycles from the given one on.
+     */
+    void remove_cycles_from(uint64_t cycle);
+
+    Logic4 value_at(uint32_t signal, uint64_t cycle) const;
+
+    /**
+     * Get the changes of a signal in the range of cycles. The first change
+     * is at the start of the range and contains the value at that time,
+     * which is X for cycles that have not been recorded.
+     */
+    void read_changes(uint32_t signal,
+                      uint64_t start_cycle,
+                      uint64_t end_cycle,
+                      Vector<WaveformChange> &r_changes) const;
+
+    static uint8_t value_mask(Logic4 value)
+    {
+        return (uint8_t)(1 << (uint8_t)value);
+    }
+
+    /**
+     * Get the values that a signal takes in consecutive ranges of cycles,
+     * as combinations of value masks. A mask with more than one bit means
+     * that the value changes within the range. The mask is zero for ranges
+     * that have not been recorded. Ranges of at least SUMMARY_BUCKET_SIZE
+     * cycles are only approximated at bucket boundaries.
+     */
+    void summarize_ranges(uint32_t signal,
+                          uint64_t start_cycle,
+                          uint64_t cycles_per_range,
+                          uint32_t range_amount,
+                          Vector<uint8_t> &r_masks) const;
+
+    /**
+     * Memory used by the encoded changes and summaries in bytes.
+     */
+    size_t memory_size() const;
+
+  private:
+    void remove_cycles_from__no_lock(uint64_t cycle);
+    static void read_changes__no_lock(const Signal &signal,
+                                      uint64_t start_cycle,
+                                      uint64_t end_cycle,
+                                      Vector<WaveformChange> &r_changes);
+    void update_summary(Signal &signal, uint64_t cycle, Logic4 value) const;
+    void truncate_summary(Signal &signal, uint64_t cycle) const;
+    static void add_summary_bits(Signal &signal, size_t bucket, uint8_t mask);
+    static void append_change(Signal &signal, uint64_t cycle, Logic4 value);
+    static void decode_block(const Signal &signal,
+                             size_t block_index,
+                             uint64_t end_cycle,
+                             Vector<WaveformChange> &r_changes);
+    static size_t find_block(const Signal &signal, uint64_t cycle);
+};
+
+}  // namespace gate_sim